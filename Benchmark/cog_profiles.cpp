@@ -0,0 +1,175 @@
+//
+//  cog_profiles.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+//  Converts one raster with every COG creation profile and measures
+//  file size, conversion time and tile read (decode) throughput.
+//
+//  cog_profiles <input raster> <output dir> [--tiles N] [--json <file>]
+//
+
+#include "GDAL2Mercator.hpp"
+#include "SeedOrder.hpp"
+
+#include "cpl_vsi.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+struct NamedProfile {
+    const char *name;
+    COGProfile profile;
+};
+
+struct ReadResult {
+    int tz;
+    int tiles;
+    double tilesPerSecond;
+};
+
+struct ProfileResult {
+    string name;
+    int status;
+    double convertSeconds;
+    long long fileBytes;
+    vector<ReadResult> reads;
+};
+
+static NamedProfile makeProfile(const char *name, const char *compress, int level, const char *predictor, int quality, const char *tilingScheme = "") {
+    NamedProfile named;
+    named.name = name;
+    named.profile = DefaultCOGProfile();
+    named.profile.compress = compress;
+    named.profile.level = level;
+    named.profile.predictor = predictor;
+    named.profile.quality = quality;
+    named.profile.tilingScheme = tilingScheme;
+    return named;
+}
+
+/// Up to maxTiles tiles of level tz in Hilbert order, read through one dataset handle like a pipeline reader
+static ReadResult readTiles(GDAL2Mercator &mercator, const char *cogFile, int tz, int maxTiles) {
+    ReadResult result = {tz, 0, 0.0};
+    int range[4];
+    if (!mercator.tileRange(tz, range)) {
+        return result;
+    }
+    GDALDatasetH hSrcDS = GDALOpen(cogFile, GA_ReadOnly);
+    if (hSrcDS == NULL) {
+        return result;
+    }
+    TileBuffer tile;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    SeedOrderTiles(SEED_ORDER_HILBERT, tz, range, 1, [&](int tx, int ty) {
+        if (mercator.readTileData(hSrcDS, tx, ty, tz, tile) == 0) {
+            result.tiles++;
+        }
+        return result.tiles < maxTiles;
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    GDALClose(hSrcDS);
+    result.tilesPerSecond = seconds > 0.0 ? result.tiles / seconds : 0.0;
+    return result;
+}
+
+static void writeJSON(const char *jsonFile, const char *inputFile, const vector<ProfileResult> &results) {
+    FILE *fp = fopen(jsonFile, "w");
+    if (fp == NULL) {
+        printf("Open %s error\n", jsonFile);
+        return;
+    }
+    fprintf(fp, "{\n  \"input\": \"%s\",\n  \"profiles\": [\n", inputFile);
+    for (size_t i = 0;i < results.size();i++) {
+        const ProfileResult &result = results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"status\": %d, \"convert_seconds\": %.3f, \"file_bytes\": %lld, \"reads\": [",
+                result.name.c_str(), result.status, result.convertSeconds, result.fileBytes);
+        for (size_t j = 0;j < result.reads.size();j++) {
+            fprintf(fp, "%s{\"zoom\": %d, \"tiles\": %d, \"tiles_per_second\": %.1f}", j == 0 ? "" : ", ",
+                    result.reads[j].tz, result.reads[j].tiles, result.reads[j].tilesPerSecond);
+        }
+        fprintf(fp, "]}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("Usage: cog_profiles <input raster> <output dir> [--tiles N] [--json <file>]\n");
+        return 1;
+    }
+    const char *inputFile = argv[1];
+    const char *outputDir = argv[2];
+    int maxTiles = 500;
+    const char *jsonFile = NULL;
+    for (int i = 3;i < argc;i++) {
+        if (strcmp(argv[i], "--tiles") == 0 && i + 1 < argc) {
+            maxTiles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonFile = argv[++i];
+        }
+    }
+    VSIMkdir(outputDir, 0755);
+
+    vector<NamedProfile> profiles = {
+        makeProfile("default", "", 0, "", 0),
+        makeProfile("none", "NONE", 0, "", 0),
+        makeProfile("lzw-pred", "LZW", 0, "YES", 0),
+        makeProfile("deflate6-pred", "DEFLATE", 6, "YES", 0),
+        makeProfile("deflate9-pred", "DEFLATE", 9, "YES", 0),
+        makeProfile("zstd1-pred", "ZSTD", 1, "YES", 0),
+        makeProfile("zstd9-pred", "ZSTD", 9, "YES", 0),
+        makeProfile("lerc", "LERC", 0, "", 0),
+        makeProfile("jpeg85", "JPEG", 0, "", 85),
+        makeProfile("webp85", "WEBP", 0, "", 85),
+        makeProfile("deflate6-gmaps", "DEFLATE", 6, "YES", 0, "GoogleMapsCompatible"),
+    };
+    /// Reprojection by the COG driver itself, against the chunked GDALWarpOperation ingest of the others
+    NamedProfile driverWarp = makeProfile("deflate6-cogwarp", "DEFLATE", 6, "YES", 0);
+    driverWarp.profile.chunkedWarp = false;
+    profiles.push_back(driverWarp);
+
+    vector<ProfileResult> results;
+    printf("%-16s %6s %10s %12s %s\n", "profile", "status", "convert s", "size MB", "tiles/s per zoom");
+    for (NamedProfile &named : profiles) {
+        ProfileResult result;
+        result.name = named.name;
+        result.fileBytes = 0;
+        string cogFile = string(outputDir) + "/" + named.name + ".tif";
+
+        /// A new mercator for every file, zoom levels are computed once per instance
+        GDAL2Mercator mercator(NULL, NULL);
+        mercator.progressFunc = GDALDummyProgress;
+        /// No preflight, an input which already is a 3857 COG would be used as is
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        result.status = mercator.toCOGFile(inputFile, cogFile.c_str(), &named.profile, false);
+        result.convertSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+        if (result.status == 0) {
+            VSIStatBufL stat;
+            if (VSIStatL(cogFile.c_str(), &stat) == 0) {
+                result.fileBytes = (long long)stat.st_size;
+            }
+            mercator.openCOGFileWithTile(cogFile.c_str());
+            /// Full resolution and two overview levels
+            for (int tz = mercator.maxZoom();tz >= max(mercator.minZoom(), mercator.maxZoom() - 2);tz--) {
+                result.reads.push_back(readTiles(mercator, cogFile.c_str(), tz, maxTiles));
+            }
+        }
+
+        printf("%-16s %6d %10.2f %12.2f", result.name.c_str(), result.status, result.convertSeconds, result.fileBytes / 1048576.0);
+        for (const ReadResult &read : result.reads) {
+            printf("  z%d: %.1f", read.tz, read.tilesPerSecond);
+        }
+        printf("\n");
+        results.push_back(result);
+    }
+
+    if (jsonFile != NULL) {
+        writeJSON(jsonFile, inputFile, results);
+    }
+    return 0;
+}
@@ -0,0 +1,394 @@
+//
+//  tile_bench.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+//  Generates synthetic EPSG:3857 COGs (data types, band counts, compressions, sizes,
+//  sparse and nodata heavy variants) and measures readTile throughput: tiles/s, p50 / p99
+//  latency per tile and bytes read, per zoom level, thread count and output format.
+//  Block cache hit ratios of the seed orders are reported per variant.
+//
+//  tile_bench <work dir> [--tiles N] [--threads 1,2,4] [--formats pixels,png,directory,mbtiles]
+//             [--variant <name part>] [--quick] [--json <file>]
+//
+//  bytes read is the rchar delta of /proc/self/io (read / pread of the process, the OS page
+//  cache included). Mapped reads (uncompressed Byte COGs) do not show up there.
+//
+
+#include "GDAL2Mercator.hpp"
+#include "MBTilesTileStore.hpp"
+#include "SeedOrder.hpp"
+#include "TileStore.hpp"
+
+#include "cpl_vsi.h"
+#include "ogr_srs_api.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+struct Variant {
+    const char *name;
+    GDALDataType dataType;
+    int bands;
+    const char *compress;
+    int size;
+    /// 3 of 4 blocks never written (SPARSE_OK)
+    bool sparse;
+    /// About 80% of the pixels are nodata, in stripes crossing the blocks
+    bool nodataHeavy;
+};
+
+struct RunResult {
+    int tz;
+    int threads;
+    string format;
+    int tiles;
+    int failed;
+    double tilesPerSecond;
+    double p50;
+    double p99;
+    long long bytesRead;
+};
+
+struct VariantResult {
+    Variant variant;
+    int status;
+    double createSeconds;
+    long long fileBytes;
+    vector<RunResult> runs;
+    int seedZoom;
+    /// SEED_ORDER_MORTON ~ SEED_ORDER_BLOCK_ROW
+    double hitRatios[4];
+};
+
+static const char *seedOrderNames[4] = {"morton", "hilbert", "row", "block_row"};
+
+static vector<string> splitList(const char *list) {
+    vector<string> items;
+    char **tokens = CSLTokenizeString2(list, ",", 0);
+    for (int i = 0;tokens != NULL && tokens[i] != NULL;i++) {
+        items.push_back(tokens[i]);
+    }
+    CSLDestroy(tokens);
+    return items;
+}
+
+/// rchar of /proc/self/io, -1 when not available
+static long long processBytesRead(void) {
+    FILE *fp = fopen("/proc/self/io", "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    long long bytes = -1;
+    char line[128];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "rchar: %lld", &bytes) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    return bytes;
+}
+
+/// Smooth gradients with some noise per band, values in the range of the data type
+static double sampleValue(const Variant &variant, int band, int x, int y) {
+    unsigned int noise = (unsigned int)(x * 73856093) ^ (unsigned int)(y * 19349663) ^ (unsigned int)(band * 83492791);
+    double value = 0.5 + 0.25 * sin(x * 0.004 + band) + 0.2 * cos(y * 0.003 - band) + (noise % 1000) / 20000.0;
+    if (variant.dataType == GDT_Byte) {
+        return 1.0 + floor(value * 254.0);
+    } else if (variant.dataType == GDT_UInt16) {
+        return 1.0 + floor(value * 4094.0);
+    }
+    return value * 1000.0 - 200.0;
+}
+
+static int createVariant(const Variant &variant, const char *cogFile) {
+    GDALDatasetH hMemDS = GDALCreate(GDALGetDriverByName("MEM"), "", variant.size, variant.size, variant.bands, variant.dataType, NULL);
+    if (hMemDS == NULL) {
+        return 2;
+    }
+    /// 10 m pixels around the origin of EPSG:3857
+    double half = variant.size * 10.0 / 2.0;
+    double geoTransform[6] = {-half, 10.0, 0.0, half, 0.0, -10.0};
+    GDALSetGeoTransform(hMemDS, geoTransform);
+    OGRSpatialReferenceH hSRS = OSRNewSpatialReference(NULL);
+    OSRImportFromEPSG(hSRS, 3857);
+    GDALSetSpatialRef(hMemDS, hSRS);
+    OSRDestroySpatialReference(hSRS);
+
+    bool hasNoData = variant.sparse || variant.nodataHeavy;
+    vector<double> row(variant.size);
+    for (int b = 1;b <= variant.bands;b++) {
+        GDALRasterBandH hBand = GDALGetRasterBand(hMemDS, b);
+        if (variant.bands == 4 && b == 4) {
+            GDALSetRasterColorInterpretation(hBand, GCI_AlphaBand);
+        } else if (hasNoData) {
+            GDALSetRasterNoDataValue(hBand, 0.0);
+        }
+        for (int y = 0;y < variant.size;y++) {
+            for (int x = 0;x < variant.size;x++) {
+                bool empty = (variant.sparse && ((x / 512) + (y / 512)) % 4 != 0) ||
+                             (variant.nodataHeavy && ((x / 37) + (y / 53)) % 5 != 0);
+                if (variant.bands == 4 && b == 4) {
+                    row[x] = empty ? 0.0 : 255.0;
+                } else {
+                    row[x] = empty ? 0.0 : sampleValue(variant, b, x, y);
+                }
+            }
+            GDALRasterIO(hBand, GF_Write, 0, y, variant.size, 1, row.data(), variant.size, 1, GDT_Float64, 0, 0);
+        }
+    }
+
+    char **options = NULL;
+    options = CSLSetNameValue(options, "COMPRESS", variant.compress);
+    options = CSLSetNameValue(options, "BLOCKSIZE", "512");
+    options = CSLSetNameValue(options, "NUM_THREADS", "ALL_CPUS");
+    if (variant.sparse) {
+        options = CSLSetNameValue(options, "SPARSE_OK", "TRUE");
+    }
+    if (EQUAL(variant.compress, "DEFLATE") || EQUAL(variant.compress, "ZSTD") || EQUAL(variant.compress, "LZW")) {
+        options = CSLSetNameValue(options, "PREDICTOR", "YES");
+    }
+    GDALDatasetH hCOGDS = GDALCreateCopy(GDALGetDriverByName("COG"), cogFile, hMemDS, FALSE, options, NULL, NULL);
+    CSLDestroy(options);
+    GDALClose(hMemDS);
+    if (hCOGDS == NULL) {
+        printf("Create %s error\n", cogFile);
+        return 2;
+    }
+    GDALClose(hCOGDS);
+    return 0;
+}
+
+/// tiles read by threads readers, each with its own dataset handle like the pipeline readers
+static RunResult runTiles(GDAL2Mercator &mercator, const char *cogFile, int tz, const vector<pair<int, int>> &tiles,
+                          int threads, const string &format, const char *workDir) {
+    RunResult result = {tz, threads, format, 0, 0, 0.0, 0.0, 0.0, -1};
+    TileStore *store = NULL;
+    if (format == "directory") {
+        DirectoryTileStore *directory = new DirectoryTileStore(CPLFormFilename(workDir, "tiles", NULL));
+        directory->clear();
+        store = directory;
+    } else if (format == "mbtiles") {
+        string mbtilesFile = CPLFormFilename(workDir, "tiles", "mbtiles");
+        VSIUnlink(mbtilesFile.c_str());
+        MBTilesTileStore *mbtiles = new MBTilesTileStore(mbtilesFile.c_str());
+        if (mbtiles->open() != 0) {
+            delete mbtiles;
+            return result;
+        }
+        store = mbtiles;
+    }
+    bool encode = format != "pixels";
+
+    vector<vector<double>> latencies(threads);
+    atomic<size_t> next(0);
+    atomic<int> failed(0);
+    long long bytesBefore = processBytesRead();
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0;t < threads;t++) {
+        workers.push_back(thread([&, t]() {
+            GDALDatasetH hSrcDS = GDALOpen(cogFile, GA_ReadOnly);
+            if (hSrcDS == NULL) {
+                return;
+            }
+            TileBuffer tile;
+            vector<unsigned char> data;
+            size_t i;
+            while ((i = next++) < tiles.size()) {
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                int tx = tiles[i].first;
+                int ty = tiles[i].second;
+                int status = mercator.readTileData(hSrcDS, tx, ty, tz, tile);
+                if (status == 0) {
+                    mercator.transformTile(tile);
+                    if (encode) {
+                        status = mercator.encodeTile(tile, data);
+                    }
+                }
+                if (status == 0 && store != NULL) {
+                    status = store->writeTile(tx, ty, tz, data);
+                }
+                if (status != 0) {
+                    failed++;
+                }
+                latencies[t].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+            }
+            GDALClose(hSrcDS);
+        }));
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    long long bytesAfter = processBytesRead();
+    delete store;
+
+    vector<double> all;
+    for (const vector<double> &values : latencies) {
+        all.insert(all.end(), values.begin(), values.end());
+    }
+    sort(all.begin(), all.end());
+    result.tiles = int(all.size());
+    result.failed = failed;
+    result.tilesPerSecond = seconds > 0.0 ? all.size() / seconds : 0.0;
+    if (!all.empty()) {
+        result.p50 = all[all.size() / 2];
+        result.p99 = all[min(all.size() - 1, size_t(all.size() * 0.99))];
+    }
+    if (bytesBefore >= 0 && bytesAfter >= 0) {
+        result.bytesRead = bytesAfter - bytesBefore;
+    }
+    return result;
+}
+
+static void writeJSON(const char *jsonFile, const vector<VariantResult> &results) {
+    FILE *fp = fopen(jsonFile, "w");
+    if (fp == NULL) {
+        printf("Open %s error\n", jsonFile);
+        return;
+    }
+    fprintf(fp, "{\n  \"gdal\": \"%s\",\n  \"cpus\": %u,\n  \"variants\": [\n", GDALVersionInfo("RELEASE_NAME"), thread::hardware_concurrency());
+    for (size_t i = 0;i < results.size();i++) {
+        const VariantResult &result = results[i];
+        const Variant &variant = result.variant;
+        fprintf(fp, "    {\"name\": \"%s\", \"data_type\": \"%s\", \"bands\": %d, \"compress\": \"%s\", \"size\": %d, \"sparse\": %s, \"nodata_heavy\": %s,\n",
+                variant.name, GDALGetDataTypeName(variant.dataType), variant.bands, variant.compress, variant.size,
+                variant.sparse ? "true" : "false", variant.nodataHeavy ? "true" : "false");
+        fprintf(fp, "     \"status\": %d, \"create_seconds\": %.3f, \"file_bytes\": %lld,\n", result.status, result.createSeconds, result.fileBytes);
+        fprintf(fp, "     \"block_cache_hit_ratio\": {\"zoom\": %d", result.seedZoom);
+        for (int order = 0;order < 4;order++) {
+            fprintf(fp, ", \"%s\": %.4f", seedOrderNames[order], result.hitRatios[order]);
+        }
+        fprintf(fp, "},\n     \"runs\": [\n");
+        for (size_t j = 0;j < result.runs.size();j++) {
+            const RunResult &run = result.runs[j];
+            fprintf(fp, "       {\"zoom\": %d, \"threads\": %d, \"format\": \"%s\", \"tiles\": %d, \"failed\": %d, \"tiles_per_second\": %.1f, \"p50_ms\": %.3f, \"p99_ms\": %.3f, \"bytes_read\": %lld}%s\n",
+                    run.tz, run.threads, run.format.c_str(), run.tiles, run.failed, run.tilesPerSecond, run.p50, run.p99, run.bytesRead,
+                    j + 1 < result.runs.size() ? "," : "");
+        }
+        fprintf(fp, "     ]}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: tile_bench <work dir> [--tiles N] [--threads 1,2,4] [--formats pixels,png,directory,mbtiles] [--variant <name part>] [--quick] [--json <file>]\n");
+        return 1;
+    }
+    const char *workDir = argv[1];
+    int maxTiles = 400;
+    vector<string> threadList = {"1", "2", "4", "8"};
+    vector<string> formats = {"pixels", "png", "directory", "mbtiles"};
+    const char *filter = NULL;
+    bool quick = false;
+    const char *jsonFile = NULL;
+    for (int i = 2;i < argc;i++) {
+        if (strcmp(argv[i], "--tiles") == 0 && i + 1 < argc) {
+            maxTiles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadList = splitList(argv[++i]);
+        } else if (strcmp(argv[i], "--formats") == 0 && i + 1 < argc) {
+            formats = splitList(argv[++i]);
+        } else if (strcmp(argv[i], "--variant") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonFile = argv[++i];
+        }
+    }
+    VSIMkdir(workDir, 0755);
+
+    vector<Variant> variants = {
+        {"byte-gray-none", GDT_Byte, 1, "NONE", 4096, false, false},
+        {"byte-rgba-none", GDT_Byte, 4, "NONE", 4096, false, false},
+        {"byte-rgb-deflate", GDT_Byte, 3, "DEFLATE", 4096, false, false},
+        {"byte-rgba-zstd", GDT_Byte, 4, "ZSTD", 4096, false, false},
+        {"byte-rgb-jpeg", GDT_Byte, 3, "JPEG", 4096, false, false},
+        {"byte-rgb-deflate-small", GDT_Byte, 3, "DEFLATE", 1024, false, false},
+        {"byte-rgb-deflate-large", GDT_Byte, 3, "DEFLATE", 8192, false, false},
+        {"uint16-gray-deflate", GDT_UInt16, 1, "DEFLATE", 4096, false, false},
+        {"uint16-rgb-lzw", GDT_UInt16, 3, "LZW", 2048, false, false},
+        {"float32-gray-zstd", GDT_Float32, 1, "ZSTD", 2048, false, false},
+        {"byte-gray-sparse", GDT_Byte, 1, "DEFLATE", 4096, true, false},
+        {"byte-rgb-nodata", GDT_Byte, 3, "DEFLATE", 4096, false, true},
+        {"float32-gray-nodata", GDT_Float32, 1, "ZSTD", 2048, false, true},
+    };
+
+    vector<VariantResult> results;
+    printf("%-24s %6s %8s %8s %7s %-10s %8s %10s %9s %9s %12s\n", "variant", "status", "size MB", "zoom", "threads", "format", "tiles", "tiles/s", "p50 ms", "p99 ms", "read MB");
+    for (Variant &variant : variants) {
+        if (filter != NULL && strstr(variant.name, filter) == NULL) {
+            continue;
+        }
+        if (quick) {
+            variant.size = max(512, variant.size / 4);
+        }
+        VariantResult result;
+        result.variant = variant;
+        result.fileBytes = 0;
+        result.seedZoom = -1;
+        for (int order = 0;order < 4;order++) {
+            result.hitRatios[order] = 0.0;
+        }
+        string cogFile = CPLFormFilename(workDir, variant.name, "tif");
+
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        result.status = createVariant(variant, cogFile.c_str());
+        result.createSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        if (result.status == 0) {
+            VSIStatBufL stat;
+            if (VSIStatL(cogFile.c_str(), &stat) == 0) {
+                result.fileBytes = (long long)stat.st_size;
+            }
+
+            /// A new mercator for every file, zoom levels are computed once per instance
+            GDAL2Mercator mercator(NULL, NULL);
+            mercator.openCOGFileWithTile(cogFile.c_str());
+            result.seedZoom = mercator.maxZoom();
+            for (int order = 0;order < 4;order++) {
+                result.hitRatios[order] = mercator.blockCacheHitRatio(order, result.seedZoom);
+            }
+
+            /// Full resolution and two overview levels
+            for (int tz = mercator.maxZoom();tz >= max(mercator.minZoom(), mercator.maxZoom() - 2);tz--) {
+                int range[4];
+                if (!mercator.tileRange(tz, range)) {
+                    continue;
+                }
+                vector<pair<int, int>> tiles;
+                SeedOrderTiles(SEED_ORDER_HILBERT, tz, range, 1, [&](int tx, int ty) {
+                    tiles.push_back(make_pair(tx, ty));
+                    return int(tiles.size()) < maxTiles;
+                });
+                for (const string &threads : threadList) {
+                    for (const string &format : formats) {
+                        RunResult run = runTiles(mercator, cogFile.c_str(), tz, tiles, max(1, atoi(threads.c_str())), format, workDir);
+                        printf("%-24s %6d %8.2f %8d %7d %-10s %8d %10.1f %9.3f %9.3f %12.2f\n", variant.name, result.status, result.fileBytes / 1048576.0,
+                               run.tz, run.threads, run.format.c_str(), run.tiles, run.tilesPerSecond, run.p50, run.p99, run.bytesRead / 1048576.0);
+                        result.runs.push_back(run);
+                    }
+                }
+            }
+        } else {
+            printf("%-24s %6d\n", variant.name, result.status);
+        }
+        results.push_back(result);
+        VSIUnlink(cogFile.c_str());
+    }
+
+    if (jsonFile != NULL) {
+        writeJSON(jsonFile, results);
+    }
+    return 0;
+}
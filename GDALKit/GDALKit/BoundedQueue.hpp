@@ -0,0 +1,120 @@
+//
+//  BoundedQueue.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef BoundedQueue_hpp
+#define BoundedQueue_hpp
+
+#include <stdio.h>
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/// Blocking multi-producer / multi-consumer queue with a capacity (backpressure)
+/// and optional priority levels, level 0 is popped first.
+template <typename T>
+class BoundedQueue {
+private:
+    vector<deque<T>> _items;
+    size_t _capacity;
+    size_t _count;
+    bool _closed;
+
+    mutex _mutex;
+    condition_variable _notEmpty;
+    condition_variable _notFull;
+
+    bool takeLocked(T &item) {
+        for (deque<T> &items : _items) {
+            if (!items.empty()) {
+                item = std::move(items.front());
+                items.pop_front();
+                _count--;
+                return true;
+            }
+        }
+        return false;
+    }
+public:
+    BoundedQueue(size_t capacity, int priorities = 1) : _items(max(1, priorities)) {
+        _capacity = max((size_t)1, capacity);
+        _count = 0;
+        _closed = false;
+    }
+
+    /// Blocks while the queue is full, returns false once the queue is closed
+    bool push(T item, int priority = 0) {
+        unique_lock<mutex> lock(_mutex);
+        _notFull.wait(lock, [this] { return _closed || _count < _capacity; });
+        if (_closed) {
+            return false;
+        }
+        priority = max(0, min(int(_items.size()) - 1, priority));
+        _items[priority].push_back(std::move(item));
+        _count++;
+        lock.unlock();
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    /// Never blocks, the queue may go over its capacity. For a consumer of a later stage feeding back
+    /// into this one, where waiting for room could deadlock. Returns false once the queue is closed
+    bool pushNow(T item, int priority = 0) {
+        unique_lock<mutex> lock(_mutex);
+        if (_closed) {
+            return false;
+        }
+        priority = max(0, min(int(_items.size()) - 1, priority));
+        _items[priority].push_back(std::move(item));
+        _count++;
+        lock.unlock();
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    /// Blocks while the queue is empty, returns false once the queue is closed and drained
+    bool pop(T &item) {
+        unique_lock<mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this] { return _closed || _count > 0; });
+        if (!takeLocked(item)) {
+            return false;
+        }
+        lock.unlock();
+        _notFull.notify_one();
+        return true;
+    }
+
+    /// Non blocking pop
+    bool tryPop(T &item) {
+        unique_lock<mutex> lock(_mutex);
+        if (!takeLocked(item)) {
+            return false;
+        }
+        lock.unlock();
+        _notFull.notify_one();
+        return true;
+    }
+
+    /// Wakes up all waiting producers and consumers, items already queued can still be popped
+    void close(void) {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _closed = true;
+        }
+        _notEmpty.notify_all();
+        _notFull.notify_all();
+    }
+
+    size_t size(void) {
+        lock_guard<mutex> lock(_mutex);
+        return _count;
+    }
+};
+#endif /* BoundedQueue_hpp */
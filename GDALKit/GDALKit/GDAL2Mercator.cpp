@@ -6,13 +6,30 @@
 //
 
 #include "GDAL2Mercator.hpp"
+#include "TileStore.hpp"
+#include "TilePipeline.hpp"
+#include "TileComposer.hpp"
+#include "PMTiles.hpp"
+#include "SeedJournal.hpp"
+#include "TileCover.hpp"
+#include "MosaicSource.hpp"
+#include "MappedTiff.hpp"
+#include "RemoteCache.hpp"
+#include "SeedOrder.hpp"
+#include "TileHash.hpp"
 
+#include "cpl_json.h"
 #include "ogr_api.h"
 #include "ogr_srs_api.h"
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <png.h>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <thread>
 
 #define PNG_BYTES_TO_CHECK 8
 
@@ -28,6 +45,23 @@ GDAL2Mercator::GDAL2Mercator(const char *gdal_data_path, const char *proj_lib_pa
     _tminz = -1;
     _tmaxz = -1;
     _isFileOpened = FALSE;
+    _cogFile = NULL;
+    _fileInfo = NULL;
+    statsFromOverview = true;
+    composeOverviews = false;
+    overviewResampling = TILE_RESAMPLING_AVERAGE;
+    seedArea = NULL;
+    seedOrder = SEED_ORDER_HILBERT;
+    warpOnTheFly = true;
+    warpErrorThreshold = 0.125;
+    mosaicHandles = 64;
+    _mosaic = NULL;
+    _mapped = NULL;
+    mappedReads = true;
+    _blockXSize = 256;
+    _blockYSize = 256;
+    _overviewCount = 0;
+    bandCount = 0;
     
     _bandRange[0][0] = 0;
     _bandRange[0][1] = 255;
@@ -51,29 +85,167 @@ GDAL2Mercator::GDAL2Mercator(const char *gdal_data_path, const char *proj_lib_pa
 
 GDAL2Mercator::~GDAL2Mercator(void) {
     printf("GDAL2Mercator release\n");
+    closeSource();
+    CPLFree(_fileInfo);
 }
 
 void GDAL2Mercator::readFileInfo(GDALDatasetH hSrcDS) {
     _rasterXSize = GDALGetRasterXSize(hSrcDS);
     _rasterYSize = GDALGetRasterYSize(hSrcDS);
     
-    char **papszOptions = NULL;
-    papszOptions = CSLAddString(papszOptions, "-json");
-    GDALInfoOptions *psOptions = GDALInfoOptionsNew(papszOptions, NULL);
-    fileInfo = GDALInfo(hSrcDS, psOptions);
+    {
+        lock_guard<mutex> lock(_fileInfoMutex);
+        CPLFree(_fileInfo);
+        _fileInfo = NULL;
+    }
     
     bandCount = GDALGetRasterCount(hSrcDS);
     
-    for (int t = 1;t <= bandCount;t++) {
+    uint64_t source = sourceFingerprint();
+    if (readStatistics(source)) {
+        return;
+    }
+    
+    for (int t = 1;t <= min(bandCount, 4);t++) {
         int             bGotMin, bGotMax;
         double          adfMinMax[2];
         adfMinMax[0] = GDALGetRasterMinimum( GDALGetRasterBand( hSrcDS, t), &bGotMin );
         adfMinMax[1] = GDALGetRasterMaximum( GDALGetRasterBand( hSrcDS, t), &bGotMax );
         if( ! (bGotMin && bGotMax) )
-            GDALComputeRasterMinMax( GDALGetRasterBand( hSrcDS, t), TRUE, adfMinMax );
+            computeBandMinMax( GDALGetRasterBand( hSrcDS, t), adfMinMax );
         bandsMinMax[t - 1][0] = adfMinMax[0];
         bandsMinMax[t - 1][1] = adfMinMax[1];
     }
+    writeStatistics(source);
+}
+
+void GDAL2Mercator::readMosaicInfo(void) {
+    {
+        lock_guard<mutex> lock(_fileInfoMutex);
+        CPLFree(_fileInfo);
+        _fileInfo = NULL;
+    }
+    
+    /// Gray / RGB + alpha, like a single file the tiles are read from
+    bandCount = _mosaic->dataBands() + 1;
+    
+    uint64_t source = sourceFingerprint();
+    if (readStatistics(source)) {
+        return;
+    }
+    
+    for (int t = 0;t < 4;t++) {
+        bandsMinMax[t][0] = 255;
+        bandsMinMax[t][1] = 0;
+    }
+    for (int i = 0;i < _mosaic->fileCount();i++) {
+        GDALDatasetH hSrcDS = GDALOpen(_mosaic->filePath(i), GA_ReadOnly);
+        if (hSrcDS == NULL) {
+            continue;
+        }
+        for (int t = 1;t <= min(GDALGetRasterCount(hSrcDS), min(bandCount, 4));t++) {
+            int             bGotMin, bGotMax;
+            double          adfMinMax[2];
+            adfMinMax[0] = GDALGetRasterMinimum( GDALGetRasterBand( hSrcDS, t), &bGotMin );
+            adfMinMax[1] = GDALGetRasterMaximum( GDALGetRasterBand( hSrcDS, t), &bGotMax );
+            if( ! (bGotMin && bGotMax) )
+                computeBandMinMax( GDALGetRasterBand( hSrcDS, t), adfMinMax );
+            bandsMinMax[t - 1][0] = min(bandsMinMax[t - 1][0], int(adfMinMax[0]));
+            bandsMinMax[t - 1][1] = max(bandsMinMax[t - 1][1], int(adfMinMax[1]));
+        }
+        GDALClose(hSrcDS);
+    }
+    for (int t = 0;t < 4;t++) {
+        if (bandsMinMax[t][0] > bandsMinMax[t][1]) {
+            bandsMinMax[t][0] = 0;
+            bandsMinMax[t][1] = 255;
+        }
+    }
+    writeStatistics(source);
+}
+
+void GDAL2Mercator::computeBandMinMax(GDALRasterBandH hBand, double *minmax) {
+    int overviews = GDALGetOverviewCount(hBand);
+    if (statsFromOverview && overviews > 0) {
+        /// Smallest overview, exact min/max of a few blocks instead of a scan of the full raster
+        GDALRasterBandH hOverview = GDALGetOverview(hBand, overviews - 1);
+        if (hOverview != NULL && GDALComputeRasterMinMax(hOverview, FALSE, minmax) == CE_None) {
+            return;
+        }
+    }
+    GDALComputeRasterMinMax(hBand, TRUE, minmax);
+}
+
+bool GDAL2Mercator::readStatistics(uint64_t source) {
+    VSILFILE *fp = VSIFOpenL(CPLSPrintf("%s.stats.json", _sourceFileName.c_str()), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    char buffer[1024] = {0};
+    VSIFReadL(buffer, 1, sizeof(buffer) - 1, fp);
+    VSIFCloseL(fp);
+    
+    uint64_t stored = 0;
+    int count = 0;
+    const char *p = strstr(buffer, "\"source\"");
+    if (p == NULL || sscanf(p, "\"source\" : \"%" SCNx64 "\"", &stored) != 1 || stored != source) {
+        return false;
+    }
+    p = strstr(buffer, "\"bands\"");
+    if (p == NULL || sscanf(p, "\"bands\" : %d", &count) != 1 || count != min(bandCount, 4)) {
+        return false;
+    }
+    p = strstr(p, "\"minmax\"");
+    p = p == NULL ? NULL : strchr(p, '[');
+    for (int t = 0;t < count && p != NULL;t++) {
+        p = strchr(p + 1, '[');
+        if (p == NULL || sscanf(p, "[%d, %d]", &bandsMinMax[t][0], &bandsMinMax[t][1]) != 2) {
+            return false;
+        }
+    }
+    return p != NULL || count == 0;
+}
+
+void GDAL2Mercator::writeStatistics(uint64_t source) {
+    string json = CPLSPrintf("{\n  \"source\" : \"%016" PRIx64 "\",\n  \"bands\" : %d,\n  \"minmax\" : [", source, min(bandCount, 4));
+    for (int t = 0;t < min(bandCount, 4);t++) {
+        json += CPLSPrintf("%s[%d, %d]", t == 0 ? "" : ", ", bandsMinMax[t][0], bandsMinMax[t][1]);
+    }
+    json += "]\n}\n";
+    
+    /// The COG may be in a read only directory, the statistics are then computed on every open
+    VSILFILE *fp = VSIFOpenL(CPLSPrintf("%s.stats.json", _sourceFileName.c_str()), "wb");
+    if (fp == NULL) {
+        printf("Write statistics error.\n");
+        return;
+    }
+    VSIFWriteL(json.c_str(), 1, json.size(), fp);
+    VSIFCloseL(fp);
+}
+
+const char *GDAL2Mercator::sourceFile(void) {
+    return _sourceFileName.c_str();
+}
+
+const char *GDAL2Mercator::fileInfo(void) {
+    lock_guard<mutex> lock(_fileInfoMutex);
+    if (_fileInfo != NULL || _cogFile == NULL || _mosaic != NULL) {
+        return _fileInfo;
+    }
+    
+    GDALDatasetH hSrcDS = GDALOpen(_cogFile, GA_ReadOnly);
+    if (hSrcDS == NULL) {
+        printf("Open COG dataset error.\n");
+        return NULL;
+    }
+    char **papszOptions = NULL;
+    papszOptions = CSLAddString(papszOptions, "-json");
+    GDALInfoOptions *psOptions = GDALInfoOptionsNew(papszOptions, NULL);
+    _fileInfo = GDALInfo(hSrcDS, psOptions);
+    GDALInfoOptionsFree(psOptions);
+    CSLDestroy(papszOptions);
+    GDALClose(hSrcDS);
+    return _fileInfo;
 }
 
 int GDAL2Mercator::getYTile(int ty, int tz) {
@@ -91,6 +263,34 @@ int GDAL2Mercator::nb_data_bands(GDALDatasetH hSrcDS) {
     }
 }
 
+// MARK: -
+int GDAL2Mercator::colorFilter(int value, int min, int max) {
+    return value < min ? min : (value > max ? max : value);
+}
+
+int GDAL2Mercator::linearStretchedValue(int value, int min, int max) {
+    if (max <= min) {
+        return value;
+    }
+    return colorFilter((value - min) * 255 / (max - min), 0, 255);
+}
+
+int GDAL2Mercator::adjustColorComponent(int colorComponent, int alpha, int brightness, int contrast, double gamma) {
+    if (alpha == 0) {
+        return colorComponent;
+    }
+    
+    double value = colorComponent + brightness;
+    /// contrast: -255 ~ 255
+    double factor = (259.0 * (contrast + 255)) / (255.0 * (259 - contrast));
+    value = factor * (value - 128) + 128;
+    value = colorFilter(int(value + 0.5), 0, 255);
+    if (gamma > 0 && gamma != 1.0) {
+        value = 255.0 * pow(value / 255.0, 1.0 / gamma);
+    }
+    return colorFilter(int(value + 0.5), 0, 255);
+}
+
 void GDAL2Mercator::geo_query(int *rb, int *wb, double ulx, double uly, double lrx, double lry, int querysize) {
     int rx = int((ulx - _geoTransform[0]) / _geoTransform[1] + 0.001);
     int ry = int((uly - _geoTransform[3]) / _geoTransform[5] + 0.001);
@@ -144,56 +344,134 @@ void GDAL2Mercator::geo_query(int *rb, int *wb, double ulx, double uly, double l
 }
 
 void GDAL2Mercator::openCOGFileWithTile(const char *cogFile) {
-    _cogFile = cogFile;
+    /// http(s):// COGs are read with range requests
+    string remoteFile;
+    if (cogFile != NULL) {
+        remoteFile = RemoteCachePath(cogFile);
+        cogFile = remoteFile.c_str();
+    }
+    
+    VSIStatBufL sStat;
+    if (cogFile != NULL && VSIStatL(cogFile, &sStat) == 0 && VSI_ISDIR(sStat.st_mode)) {
+        openMosaicWithTile(cogFile);
+        return;
+    }
+    
+    closeSource();
+    /// 保存一份, 调用者的字符串可能被释放
+    _sourceFileName = cogFile;
+    _cogFileName = cogFile;
+    _cogFile = _cogFileName.c_str();
+    _isFileOpened = FALSE;
+    _tminz = -1;
+    _tmaxz = -1;
     GDALDatasetH _hSrcDS = GDALOpen(cogFile, GA_ReadOnly);
     if (_hSrcDS == NULL) {
         printf("Open COG dataset error.\n");
-        _isFileOpened = FALSE;
         return;
     }
     
+    /// Other projections are rendered through a warped VRT instead of being converted first
+    if (warpOnTheFly && !IsWebMercator(_hSrcDS)) {
+        string vrtFile = createWarpedVRT(_hSrcDS);
+        GDALClose(_hSrcDS);
+        _hSrcDS = vrtFile.empty() ? NULL : GDALOpen(vrtFile.c_str(), GA_ReadOnly);
+        if (_hSrcDS == NULL) {
+            return;
+        }
+        _cogFileName = vrtFile;
+        _cogFile = _cogFileName.c_str();
+    }
+    
     readFileInfo(_hSrcDS);
     
+    if (mappedReads && _cogFileName == _sourceFileName) {
+        _mapped = MappedTiff::open(_hSrcDS, _cogFile);
+    }
+    
+    GDALRasterBandH hBand = GDALGetRasterBand(_hSrcDS, 1);
+    if (hBand != NULL) {
+        GDALGetBlockSize(hBand, &_blockXSize, &_blockYSize);
+        _overviewCount = GDALGetOverviewCount(hBand);
+    }
+    
     if (GDALGetGeoTransform(_hSrcDS, _geoTransform) == CE_None) {
-        double ominx = _geoTransform[0];
-        double omaxx = _geoTransform[0] + _rasterXSize * _geoTransform[1];
-        double omaxy = _geoTransform[3];
-        double ominy = _geoTransform[3] - _rasterYSize * _geoTransform[1];
-        
-        for (int tz = 0;tz < MAXZOOMLEVEL;tz++) {
-            double tminxy[2];
-            double tmaxxy[2];
-            _mercator->MetersToTile(ominx, ominy, tz, tminxy);
-            _mercator->MetersToTile(omaxx, omaxy, tz, tmaxxy);
-            double tminx = tminxy[0];
-            double tminy = tminxy[1];
-            double tmaxx = tmaxxy[0];
-            double tmaxy = tmaxxy[1];
-            tminx = max(0.0, tminx);
-            tminy = max(0.0, tminy);
-            tmaxx = min(pow(2, double(tz)) - 1, tmaxx);
-            tmaxy = min(pow(2, double(tz)) - 1, tmaxy);
-            _tminmax[tz][0] = tminx;
-            _tminmax[tz][1] = tminy;
-            _tminmax[tz][2] = tmaxx;
-            _tminmax[tz][3] = tmaxy;
-        }
-        
-        if (_tminz == -1) {
-            _tminz = _mercator->ZoomForPixelSize(_geoTransform[1] * max(_rasterXSize, _rasterYSize) / float(_tile_size));
-        }
-        if (_tmaxz == -1) {
-            _tmaxz = _mercator->ZoomForPixelSize(_geoTransform[1]);
-            _tmaxz = max(_tminz, _tmaxz);
-        }
-        
-        _tminz = min(_tminz, _tmaxz);
-        _isFileOpened = TRUE;
+        computeTileRanges();
     }
     
     GDALClose(_hSrcDS);
 }
 
+int GDAL2Mercator::openMosaicWithTile(const char *source) {
+    closeSource();
+    _sourceFileName = source == NULL ? "" : source;
+    _cogFileName = _sourceFileName;
+    _cogFile = _cogFileName.c_str();
+    _isFileOpened = FALSE;
+    _tminz = -1;
+    _tmaxz = -1;
+    
+    MosaicSource *mosaic = new MosaicSource();
+    mosaic->maxHandles = mosaicHandles;
+    mosaic->warpErrorThreshold = warpErrorThreshold;
+    int result = mosaic->open(source);
+    if (result != 0) {
+        delete mosaic;
+        return result;
+    }
+    _mosaic = mosaic;
+    _mosaic->grid(_geoTransform, &_rasterXSize, &_rasterYSize);
+    readMosaicInfo();
+    _blockXSize = _tile_size;
+    _blockYSize = _tile_size;
+    _overviewCount = 0;
+    computeTileRanges();
+    return 0;
+}
+
+bool GDAL2Mercator::isMosaic(void) {
+    return _mosaic != NULL;
+}
+
+void GDAL2Mercator::computeTileRanges(void) {
+    double ominx = _geoTransform[0];
+    double omaxx = _geoTransform[0] + _rasterXSize * _geoTransform[1];
+    double omaxy = _geoTransform[3];
+    double ominy = _geoTransform[3] - _rasterYSize * _geoTransform[1];
+    
+    for (int tz = 0;tz < MAXZOOMLEVEL;tz++) {
+        double tminxy[2];
+        double tmaxxy[2];
+        _mercator->MetersToTile(ominx, ominy, tz, tminxy);
+        _mercator->MetersToTile(omaxx, omaxy, tz, tmaxxy);
+        double tminx = tminxy[0];
+        double tminy = tminxy[1];
+        double tmaxx = tmaxxy[0];
+        double tmaxy = tmaxxy[1];
+        tminx = max(0.0, tminx);
+        tminy = max(0.0, tminy);
+        tmaxx = min(pow(2, double(tz)) - 1, tmaxx);
+        tmaxy = min(pow(2, double(tz)) - 1, tmaxy);
+        _tminmax[tz][0] = tminx;
+        _tminmax[tz][1] = tminy;
+        _tminmax[tz][2] = tmaxx;
+        _tminmax[tz][3] = tmaxy;
+    }
+    
+    if (_tminz == -1) {
+        _tminz = _mercator->ZoomForPixelSize(_geoTransform[1] * max(_rasterXSize, _rasterYSize) / float(_tile_size));
+    }
+    if (_tmaxz == -1) {
+        _tmaxz = _mercator->ZoomForPixelSize(_geoTransform[1]);
+        _tmaxz = max(_tminz, _tmaxz);
+    }
+    /// Tiles are keyed by TileKey
+    _tmaxz = min(_tmaxz, TILEKEY_MAXZOOM);
+    
+    _tminz = min(_tminz, _tmaxz);
+    _isFileOpened = TRUE;
+}
+
 int GDAL2Mercator::createTileDetails(int tx, int ty, int tz, int *tiledetails) {
     /// zoomlevel is not range in (0, _tmaxz)
     if (tz > _tmaxz || tz < 0) {
@@ -247,10 +525,101 @@ int GDAL2Mercator::createTileDetails(int tx, int ty, int tz, int *tiledetails) {
     return 0;
 }
 
-int GDAL2Mercator::createTileFile(int *tiledetails, int ty, const char *outputPath) {
-    int _tx =       tiledetails[0];
-    //    int _ty =       tiledetails[1];
-    int _tz =       tiledetails[2];
+int GDAL2Mercator::overviewLevel(double factor) {
+    /// GDAL takes the coarsest overview which is not much coarser than requested (GDAL_OVERVIEW_OVERSAMPLING_THRESHOLD)
+    int level = 0;
+    while (level < _overviewCount && double(2 << level) <= factor * 1.2) {
+        level++;
+    }
+    return level;
+}
+
+int GDAL2Mercator::cacheBlocks(void) {
+    double blockBytes = double(_blockXSize) * _blockYSize * max(1, bandCount);
+    return max(1, int(double(GDALGetCacheMax64()) / blockBytes));
+}
+
+void GDAL2Mercator::tileBlocks(int tx, int ty, int tz, vector<uint64_t> &blocks) {
+    blocks.clear();
+    int tiledetails[11];
+    if (createTileDetails(tx, ty, tz, tiledetails) != 0 || tiledetails[5] <= 0 || tiledetails[6] <= 0 || tiledetails[9] <= 0) {
+        return;
+    }
+    int level = overviewLevel(double(tiledetails[5]) / tiledetails[9]);
+    int bx0 = (tiledetails[3] >> level) / _blockXSize;
+    int bx1 = ((tiledetails[3] + tiledetails[5] - 1) >> level) / _blockXSize;
+    int by0 = (tiledetails[4] >> level) / _blockYSize;
+    int by1 = ((tiledetails[4] + tiledetails[6] - 1) >> level) / _blockYSize;
+    for (int by = by0;by <= by1;by++) {
+        for (int bx = bx0;bx <= bx1;bx++) {
+            blocks.push_back((uint64_t(level) << 56) | (uint64_t(by) << 28) | uint64_t(bx));
+        }
+    }
+}
+
+int GDAL2Mercator::blockRowStrip(int tz) {
+    if (!_isFileOpened) {
+        return 1;
+    }
+    /// Source pixels of one tile side at the overview GDAL reads
+    double bound[4];
+    _mercator->TileBounds(0, 0, tz, bound);
+    double pixels = (bound[2] - bound[0]) / _geoTransform[1];
+    pixels /= double(1 << overviewLevel(pixels / _tile_size));
+    
+    /// One column of the strip plus the next column must fit: (rows + 1) x (across + 1) blocks
+    int across = int(ceil(pixels / _blockXSize)) + 1;
+    int blockRows = cacheBlocks() / across - 1;
+    return max(1, int(double(blockRows) * _blockYSize / pixels));
+}
+
+double GDAL2Mercator::blockCacheHitRatio(int order, int tz, int cacheBlocks) {
+    int range[4];
+    if (!tileRange(tz, range)) {
+        return 0.0;
+    }
+    if (cacheBlocks <= 0) {
+        cacheBlocks = this->cacheBlocks();
+    }
+    
+    /// LRU of block keys
+    list<uint64_t> lru;
+    unordered_map<uint64_t, list<uint64_t>::iterator> cached;
+    uint64_t hits = 0;
+    uint64_t reads = 0;
+    vector<uint64_t> blocks;
+    SeedOrderTiles(order, tz, range, blockRowStrip(tz), [&](int tx, int ty) {
+        tileBlocks(tx, ty, tz, blocks);
+        for (uint64_t block : blocks) {
+            reads++;
+            auto found = cached.find(block);
+            if (found != cached.end()) {
+                hits++;
+                lru.splice(lru.begin(), lru, found->second);
+                continue;
+            }
+            lru.push_front(block);
+            cached[block] = lru.begin();
+            if (int(lru.size()) > cacheBlocks) {
+                cached.erase(lru.back());
+                lru.pop_back();
+            }
+        }
+        return true;
+    });
+    return reads > 0 ? double(hits) / double(reads) : 0.0;
+}
+
+int GDAL2Mercator::readTileData(GDALDatasetH hSrcDS, int tx, int ty, int tz, TileBuffer &tile) {
+    int tiledetails[11];
+    int result = createTileDetails(tx, ty, tz, tiledetails);
+    if (result == 0) {
+        result = readTileData(hSrcDS, tiledetails, tile);
+    }
+    return result;
+}
+
+int GDAL2Mercator::readTileData(GDALDatasetH hSrcDS, int *tiledetails, TileBuffer &tile) {
     int _rx =       tiledetails[3];
     int _ry =       tiledetails[4];
     int _rxsize =   tiledetails[5];
@@ -260,96 +629,704 @@ int GDAL2Mercator::createTileFile(int *tiledetails, int ty, const char *outputPa
     int _wxsize =   tiledetails[9];
     int _wysize =   tiledetails[10];
     
-    const char *zoomDir = CPLSPrintf("%s/%d", outputPath, _tz);
-    mkdir(zoomDir, 0777);
-    const char *txDir = CPLSPrintf("%s/%d", zoomDir, _tx);
-    mkdir(txDir, 0777);
+    /// PNG只支持Gray+Alpha和RGBA
+    int dataBands = _mosaic != NULL ? _mosaic->dataBands() : (nb_data_bands(hSrcDS) >= 3 ? 3 : 1);
     
-    GDALDatasetH _cogDS = GDALOpen(_cogFile, GA_ReadOnly);
-    GDALDriverH memDriver = GDALGetDriverByName("MEM");
-    if (memDriver == NULL) {
-        printf("MEM Driver is NULL.\n");
-        GDALClose(_cogDS);
-        return 3;
+    tile.tx = tiledetails[0];
+    tile.ty = tiledetails[1];
+    tile.tz = tiledetails[2];
+    tile.size = _tile_size;
+    tile.bands = dataBands + 1;
+    tile.pixels.assign(size_t(_tile_size) * _tile_size * tile.bands, 0);
+    
+    if (_rxsize <= 0 || _rysize <= 0 || _wxsize <= 0 || _wysize <= 0) {
+        return 0;
     }
     
-    GDALDriverH pngDriver = GDALGetDriverByName("PNG");
-    if (pngDriver == NULL) {
-        printf("PNG Driver is NULL.\n");
-        GDALClose(_cogDS);
-        return 3;
+    if (_mosaic != NULL) {
+        double bound[4];
+        _mercator->TileBounds(tile.tx, getYTile(tile.ty, tile.tz), tile.tz, bound);
+        return _mosaic->readTile(bound, tile);
     }
     
-    int tileBands = nb_data_bands(_cogDS) + 1;
+    if (_mapped != NULL && _mapped->readTile(tiledetails + 3, tile)) {
+        return 0;
+    }
     
-    GDALRasterBandH alphaBand = alphaBand = GDALGetMaskBand(GDALGetRasterBand(_cogDS, 1));
-    GDALDataType eDT = GDALGetRasterDataType(GDALGetRasterBand(_cogDS,1));
-    GDALDatasetH dsTile = GDALCreate(memDriver, "", _tile_size, _tile_size, tileBands, GDT_Byte, NULL);
+    /// 直接按像素交错读入Tile, 转换成Byte
+    int pixelSpace = tile.bands;
+    int lineSpace = _tile_size * tile.bands;
+    GByte *pData = tile.pixels.data() + (size_t(_wy) * _tile_size + _wx) * tile.bands;
+    int bandMap[3] = {1, 2, 3};
+    CPLErr eErr = GDALDatasetRasterIO(hSrcDS, GF_Read, _rx, _ry, _rxsize, _rysize, pData, _wxsize, _wysize, GDT_Byte, dataBands, bandMap, pixelSpace, lineSpace, 1);
+    if (eErr != CE_None) {
+        printf("Read Tile data error.\n");
+        return 2;
+    }
     
-    if (_rxsize != 0 && _rysize != 0 && _wxsize != 0 && _wysize != 0) {
-        for (int b = 1; b <= tileBands; ++b) {
-            GDALRasterBandH hSrcBand = GDALGetRasterBand(_cogDS, b);
-            GDALRasterBandH hDstBand = GDALGetRasterBand(dsTile, b);
-            
-            void* pData = CPLMalloc(_wxsize * _wysize * GDALGetDataTypeSize(eDT) / 8);
-            CPLErr seErr = GDALRasterIO(hSrcBand, GF_Read, _rx, _ry, _rxsize, _rysize, pData, _wxsize, _wysize, eDT, 0, 0);
-            CPLErr deErr = GDALRasterIO(hDstBand, GF_Write, _wx, _wy, _wxsize, _wysize, pData, _wxsize, _wysize, eDT, 0, 0);
-            CPLFree(pData);
+    GDALRasterBandH alphaBand = GDALGetMaskBand(GDALGetRasterBand(hSrcDS, 1));
+    eErr = GDALRasterIOEx(alphaBand, GF_Read, _rx, _ry, _rxsize, _rysize, pData + dataBands, _wxsize, _wysize, GDT_Byte, pixelSpace, lineSpace, NULL);
+    if (eErr != CE_None) {
+        printf("Read Tile alpha error.\n");
+        return 2;
+    }
+    return 0;
+}
+
+bool GDAL2Mercator::isIdentityTransform(void) {
+    for (int b = 0;b < 4;b++) {
+        if (_bandRange[b][0] != 0 || _bandRange[b][1] != 255) {
+            return false;
         }
-        
-        GDALRasterBandH alphaDstBand = GDALGetRasterBand(dsTile, tileBands);
-        void *alphaData = CPLMalloc(_wxsize * _wysize * GDALGetDataTypeSize(eDT) / 8);
-        CPLErr seErr = GDALRasterIO(alphaBand, GF_Read, _rx, _ry, _rxsize, _rysize, alphaData, _wxsize, _wysize, eDT, 0, 0);
-        CPLErr deErr = GDALRasterIO(alphaDstBand, GF_Write, _wx, _wy, _wxsize, _wysize, alphaData, _wxsize, _wysize, eDT, 0, 0);
-        CPLFree(alphaData);
-    }
-    
-    const char* pngFile = CPLSPrintf("%s/%d.png", txDir, ty);
-    GDALDatasetH d = GDALCreateCopy(pngDriver, pngFile, dsTile, FALSE, NULL, GDALTermProgress, NULL);
-    if (d == NULL) {
-        printf("Create Tile PNG error\n");
-        GDALClose(dsTile);
-        GDALClose(_cogDS);
+    }
+    return _mBrightness == 0 && _mContrast == 0 && _mGamma == 1.0;
+}
+
+void GDAL2Mercator::transformTile(TileBuffer &tile) {
+    if (isIdentityTransform()) {
+        return;
+    }
+    
+    int dataBands = tile.bands - 1;
+    unsigned char lut[3][256];
+    for (int b = 0;b < dataBands;b++) {
+        for (int v = 0;v < 256;v++) {
+            int value = linearStretchedValue(v, _bandRange[b][0], _bandRange[b][1]);
+            lut[b][v] = (unsigned char)adjustColorComponent(value, 255, _mBrightness, _mContrast, _mGamma);
+        }
+    }
+    
+    size_t pixelCount = size_t(tile.size) * tile.size;
+    unsigned char *p = tile.pixels.data();
+    for (size_t i = 0;i < pixelCount;i++, p += tile.bands) {
+        /// 透明像素不处理
+        if (p[dataBands] == 0) {
+            continue;
+        }
+        for (int b = 0;b < dataBands;b++) {
+            p[b] = lut[b][p[b]];
+        }
+    }
+}
+
+static void pngWriteData(png_structp pngPtr, png_bytep data, png_size_t length) {
+    vector<unsigned char> *output = (vector<unsigned char> *)png_get_io_ptr(pngPtr);
+    output->insert(output->end(), data, data + length);
+}
+
+static void pngFlushData(png_structp) {
+    
+}
+
+int GDAL2Mercator::encodeTile(const TileBuffer &tile, vector<unsigned char> &data) {
+    data.clear();
+    data.reserve(size_t(tile.size) * tile.size);
+    
+    png_structp pngPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (pngPtr == NULL) {
+        return 2;
+    }
+    png_infop infoPtr = png_create_info_struct(pngPtr);
+    if (infoPtr == NULL) {
+        png_destroy_write_struct(&pngPtr, NULL);
+        return 2;
+    }
+    if (setjmp(png_jmpbuf(pngPtr))) {
+        printf("Encode Tile PNG error\n");
+        png_destroy_write_struct(&pngPtr, &infoPtr);
+        data.clear();
+        return 2;
+    }
+    
+    png_set_write_fn(pngPtr, &data, pngWriteData, pngFlushData);
+    int colorType = tile.bands == 4 ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_GRAY_ALPHA;
+    png_set_IHDR(pngPtr, infoPtr, tile.size, tile.size, 8, colorType, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    /// 与GDAL PNG驱动默认的ZLEVEL一致
+    png_set_compression_level(pngPtr, 6);
+    png_write_info(pngPtr, infoPtr);
+    
+    size_t rowBytes = size_t(tile.size) * tile.bands;
+    for (int y = 0;y < tile.size;y++) {
+        png_write_row(pngPtr, (png_const_bytep)(tile.pixels.data() + y * rowBytes));
+    }
+    png_write_end(pngPtr, NULL);
+    png_destroy_write_struct(&pngPtr, &infoPtr);
+    return 0;
+}
+
+int GDAL2Mercator::decodeTile(const vector<unsigned char> &data, TileBuffer &tile) {
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_memory(&image, data.data(), data.size())) {
+        printf("Decode Tile PNG error: %s\n", image.message);
         return 2;
     }
     
-    GDALClose(_cogDS);
-    GDALClose(dsTile);
-    GDALClose(d);
+    bool gray = (image.format & PNG_FORMAT_FLAG_COLOR) == 0;
+    image.format = gray ? PNG_FORMAT_GA : PNG_FORMAT_RGBA;
+    tile.size = int(image.width);
+    tile.bands = gray ? 2 : 4;
+    tile.pixels.resize(PNG_IMAGE_SIZE(image));
+    if (image.width != image.height || !png_image_finish_read(&image, NULL, tile.pixels.data(), 0, NULL)) {
+        printf("Decode Tile PNG error: %s\n", image.message);
+        png_image_free(&image);
+        return 2;
+    }
     return 0;
 }
 
-void GDAL2Mercator::toCOGFile(const char *inputFile, const char *outputFile) {
+void GDAL2Mercator::setBandRange(int band, int min, int max) {
+    if (band < 0 || band > 3) {
+        return;
+    }
+    _bandRange[band][0] = min;
+    _bandRange[band][1] = max;
+}
+
+void GDAL2Mercator::setColorAdjustment(int brightness, int contrast, double gamma) {
+    _mBrightness = brightness;
+    _mContrast = contrast;
+    _mGamma = gamma;
+}
+
+uint64_t GDAL2Mercator::renderFingerprint(void) {
+    /// FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto mix = [&hash](const void *data, size_t length) {
+        const unsigned char *p = (const unsigned char *)data;
+        for (size_t i = 0;i < length;i++) {
+            hash = (hash ^ p[i]) * 0x100000001b3ULL;
+        }
+    };
+    mix("PNG", 3);
+    mix(&_tile_size, sizeof(_tile_size));
+    mix(&bandCount, sizeof(bandCount));
+    mix(_bandRange, sizeof(_bandRange));
+    mix(&_mBrightness, sizeof(_mBrightness));
+    mix(&_mContrast, sizeof(_mContrast));
+    mix(&_mGamma, sizeof(_mGamma));
+    return hash;
+}
+
+uint64_t GDAL2Mercator::sourceFingerprint(void) {
+    if (_mosaic != NULL) {
+        return _mosaic->fingerprint();
+    }
+    
+    VSIStatBufL sStat;
+    if (_sourceFileName.empty() || VSIStatL(_sourceFileName.c_str(), &sStat) != 0) {
+        return 0;
+    }
+    
+    /// GeoTIFF header, IFDs and the first tile offsets
+    unsigned char header[16384];
+    size_t length = 0;
+    VSILFILE *fp = VSIFOpenL(_sourceFileName.c_str(), "rb");
+    if (fp != NULL) {
+        length = VSIFReadL(header, 1, sizeof(header), fp);
+        VSIFCloseL(fp);
+    }
+    
+    uint64_t values[3] = {uint64_t(sStat.st_size), uint64_t(sStat.st_mtime), TileHash(header, length)};
+    return TileHash(values, sizeof(values));
+}
+
+int GDAL2Mercator::writeTile(int tx, int ty, int tz, const vector<unsigned char> &data, const char *outputPath) {
+    shared_ptr<DirectoryTileStore> store;
+    {
+        lock_guard<mutex> lock(_tileWriterMutex);
+        if (_tileWriter == NULL || _tileWriter->outputPath() != outputPath) {
+            _tileWriter = make_shared<DirectoryTileStore>(outputPath);
+            /// Separate readTile calls never linked equal tiles
+            _tileWriter->deduplicate = false;
+        }
+        store = _tileWriter;
+    }
+    return store->writeTile(tx, ty, tz, data);
+}
+
+int GDAL2Mercator::createTileData(int *tiledetails, vector<unsigned char> &data) {
+    GDALDatasetH _cogDS = _mosaic != NULL ? NULL : GDALOpen(_cogFile, GA_ReadOnly);
+    if (_cogDS == NULL && _mosaic == NULL) {
+        printf("Open COG dataset error.\n");
+        return 4;
+    }
+    
+    TileBuffer tile;
+    int result = readTileData(_cogDS, tiledetails, tile);
+    if (_cogDS != NULL) {
+        GDALClose(_cogDS);
+    }
+    if (result != 0) {
+        return result;
+    }
+    
+    transformTile(tile);
+    return encodeTile(tile, data);
+}
+
+int GDAL2Mercator::createTileFile(int *tiledetails, int ty, const char *outputPath) {
+    vector<unsigned char> data;
+    int result = createTileData(tiledetails, data);
+    if (result != 0) {
+        return result;
+    }
+    return writeTile(tiledetails[0], ty, tiledetails[2], data, outputPath);
+}
+
+COGProfile DefaultCOGProfile(void) {
+    COGProfile profile;
+    profile.level = 0;
+    profile.quality = 0;
+    profile.alignedLevels = 0;
+    profile.blockSize = 256;
+    profile.chunkedWarp = true;
+    profile.warpMemory = 512.0;
+    profile.warpErrorThreshold = 0.125;
+    return profile;
+}
+
+char **GDAL2Mercator::cogOptions(const COGProfile &profile, bool reproject) {
+    char **papszOptions = NULL;
+    papszOptions = CSLSetNameValue(papszOptions, "BLOCKSIZE", CPLSPrintf("%d", profile.blockSize > 0 ? profile.blockSize : 256));
+    papszOptions = CSLSetNameValue(papszOptions, "NUM_THREADS", "ALL_CPUS");
+    papszOptions = CSLSetNameValue(papszOptions, "BIGTIFF", "IF_SAFER");
+    if (!profile.compress.empty()) {
+        papszOptions = CSLSetNameValue(papszOptions, "COMPRESS", profile.compress.c_str());
+    }
+    if (profile.level > 0) {
+        papszOptions = CSLSetNameValue(papszOptions, "LEVEL", CPLSPrintf("%d", profile.level));
+    }
+    if (!profile.predictor.empty()) {
+        papszOptions = CSLSetNameValue(papszOptions, "PREDICTOR", profile.predictor.c_str());
+    }
+    if (profile.quality > 0) {
+        papszOptions = CSLSetNameValue(papszOptions, "QUALITY", CPLSPrintf("%d", profile.quality));
+    }
+    if (!profile.overviewResampling.empty()) {
+        papszOptions = CSLSetNameValue(papszOptions, "OVERVIEW_RESAMPLING", profile.overviewResampling.c_str());
+    }
+    /// The tiling scheme brings its own SRS
+    if (profile.tilingScheme.empty()) {
+        if (reproject) {
+            papszOptions = CSLSetNameValue(papszOptions, "TARGET_SRS", "EPSG:3857");
+        }
+    } else {
+        papszOptions = CSLSetNameValue(papszOptions, "TILING_SCHEME", profile.tilingScheme.c_str());
+        if (profile.alignedLevels > 0) {
+            papszOptions = CSLSetNameValue(papszOptions, "ALIGNED_LEVELS", CPLSPrintf("%d", profile.alignedLevels));
+        }
+    }
+    return papszOptions;
+}
+
+bool IsWebMercator(GDALDatasetH hSrcDS) {
+    OGRSpatialReferenceH srs = GDALGetSpatialRef(hSrcDS);
+    double geoTransform[6];
+    if (srs == NULL || GDALGetGeoTransform(hSrcDS, geoTransform) != CE_None ||
+        geoTransform[2] != 0.0 || geoTransform[4] != 0.0 || geoTransform[5] >= 0.0) {
+        return false;
+    }
+    OGRSpatialReferenceH webMercator = OSRNewSpatialReference(NULL);
+    OSRImportFromEPSG(webMercator, 3857);
+    bool same = OSRIsSame(srs, webMercator);
+    OSRDestroySpatialReference(webMercator);
+    return same;
+}
+
+GDALDatasetH CreateWebMercatorVRT(GDALDatasetH hSrcDS, double errorThreshold) {
+    OGRSpatialReferenceH webMercator = OSRNewSpatialReference(NULL);
+    OSRImportFromEPSG(webMercator, 3857);
+    char *dstWKT = NULL;
+    OSRExportToWkt(webMercator, &dstWKT);
+    OSRDestroySpatialReference(webMercator);
+    
+    /// Outside the source becomes transparent: an alpha band unless the source brings its own
+    int bandCount = GDALGetRasterCount(hSrcDS);
+    GDALWarpOptions *psWO = GDALCreateWarpOptions();
+    if (bandCount > 0 && GDALGetRasterColorInterpretation(GDALGetRasterBand(hSrcDS, bandCount)) != GCI_AlphaBand) {
+        psWO->nDstAlphaBand = bandCount + 1;
+    }
+    /// One approximate transformer per VRT, reused by every block it warps
+    GDALDatasetH hVRT = GDALAutoCreateWarpedVRT(hSrcDS, NULL, dstWKT, GRA_Bilinear, errorThreshold, psWO);
+    GDALDestroyWarpOptions(psWO);
+    CPLFree(dstWKT);
+    return hVRT;
+}
+
+string GDAL2Mercator::createWarpedVRT(GDALDatasetH hSrcDS) {
+    GDALDatasetH hVRT = CreateWebMercatorVRT(hSrcDS, warpErrorThreshold);
+    if (hVRT == NULL) {
+        printf("Create warped VRT error.\n");
+        return "";
+    }
+    
+    /// Serialized, so every reader thread opens its own handle like with a file
+    string vrtFile = CPLSPrintf("/vsimem/gdalkit/%p_%s.vrt", (void *)this, CPLGetBasename(GDALGetDescription(hSrcDS)));
+    GDALDatasetH hDstDS = GDALCreateCopy(GDALGetDriverByName("VRT"), vrtFile.c_str(), hVRT, FALSE, NULL, NULL, NULL);
+    GDALClose(hVRT);
+    if (hDstDS == NULL) {
+        printf("Write warped VRT error.\n");
+        return "";
+    }
+    GDALClose(hDstDS);
+    return vrtFile;
+}
+
+void GDAL2Mercator::closeSource(void) {
+    /// Queued readTileAsync tiles belong to the closed source, their readers hold its datasets
+    shared_ptr<TilePipeline> pipeline;
+    {
+        lock_guard<mutex> lock(_asyncMutex);
+        pipeline.swap(_asyncPipeline);
+    }
+    if (pipeline != NULL) {
+        cancelAsyncTiles();
+        pipeline->stop();
+    }
+    
+    if (STARTS_WITH(_cogFileName.c_str(), "/vsimem/")) {
+        VSIUnlink(_cogFileName.c_str());
+    }
+    delete _mosaic;
+    _mosaic = NULL;
+    delete _mapped;
+    _mapped = NULL;
+}
+
+static GDALResampleAlg warpResampleAlg(const string &name, GDALDatasetH hSrcDS) {
+    static const struct {
+        const char *name;
+        GDALResampleAlg alg;
+    } algs[] = {
+        {"NEAREST", GRA_NearestNeighbour},
+        {"BILINEAR", GRA_Bilinear},
+        {"CUBIC", GRA_Cubic},
+        {"CUBICSPLINE", GRA_CubicSpline},
+        {"LANCZOS", GRA_Lanczos},
+        {"AVERAGE", GRA_Average},
+        {"MODE", GRA_Mode},
+    };
+    for (size_t i = 0;i < sizeof(algs) / sizeof(algs[0]);i++) {
+        if (EQUAL(name.c_str(), algs[i].name)) {
+            return algs[i].alg;
+        }
+    }
+    /// The defaults of the COG driver
+    bool paletted = GDALGetRasterColorTable(GDALGetRasterBand(hSrcDS, 1)) != NULL;
+    return paletted ? GRA_NearestNeighbour : GRA_Cubic;
+}
+
+int GDAL2Mercator::warpToWebMercator(GDALDatasetH hSrcDS, const char *warpFile, const COGProfile &profile, GDALProgressFunc pfnProgress, void *pProgressArg) {
+    GDALDriverH hDriver = GDALGetDriverByName("GTiff");
+    if (hDriver == NULL) {
+        printf("Get GTiff Driver error.\n");
+        return 3;
+    }
+    int bandCount = GDALGetRasterCount(hSrcDS);
+    if (bandCount == 0) {
+        return 2;
+    }
+    
+    /// Output grid: the extent and resolution gdalwarp would choose
+    OGRSpatialReferenceH webMercator = OSRNewSpatialReference(NULL);
+    OSRImportFromEPSG(webMercator, 3857);
+    char *dstWKT = NULL;
+    OSRExportToWkt(webMercator, &dstWKT);
+    OSRDestroySpatialReference(webMercator);
+    char **papszTransformerOptions = CSLSetNameValue(NULL, "DST_SRS", dstWKT);
+    void *hTransformArg = GDALCreateGenImgProjTransformer2(hSrcDS, NULL, papszTransformerOptions);
+    double geoTransform[6];
+    double extent[4];
+    int xSize = 0;
+    int ySize = 0;
+    CPLErr eErr = hTransformArg == NULL ? CE_Failure : GDALSuggestedWarpOutput2(hSrcDS, GDALGenImgProjTransform, hTransformArg, geoTransform, &xSize, &ySize, extent, 0);
+    if (hTransformArg != NULL) {
+        GDALDestroyGenImgProjTransformer(hTransformArg);
+    }
+    if (eErr != CE_None) {
+        printf("Compute warp output error.\n");
+        CSLDestroy(papszTransformerOptions);
+        CPLFree(dstWKT);
+        return 2;
+    }
+    
+    /// The source alpha band is warped like the data, otherwise an alpha band is added
+    GDALRasterBandH hLastBand = GDALGetRasterBand(hSrcDS, bandCount);
+    int srcAlphaBand = GDALGetRasterColorInterpretation(hLastBand) == GCI_AlphaBand ? bandCount : 0;
+    int dataBands = srcAlphaBand != 0 ? bandCount - 1 : bandCount;
+    GDALDataType eType = GDALGetRasterDataType(GDALGetRasterBand(hSrcDS, 1));
+    
+    /// Uncompressed and sparse: written once and read once by the COG driver, chunks outside the source are never written
+    int blockSize = profile.blockSize > 0 ? profile.blockSize : 256;
+    char **papszCreateOptions = NULL;
+    papszCreateOptions = CSLSetNameValue(papszCreateOptions, "TILED", "YES");
+    papszCreateOptions = CSLSetNameValue(papszCreateOptions, "BLOCKXSIZE", CPLSPrintf("%d", blockSize));
+    papszCreateOptions = CSLSetNameValue(papszCreateOptions, "BLOCKYSIZE", CPLSPrintf("%d", blockSize));
+    papszCreateOptions = CSLSetNameValue(papszCreateOptions, "SPARSE_OK", "YES");
+    papszCreateOptions = CSLSetNameValue(papszCreateOptions, "BIGTIFF", "IF_SAFER");
+    if (dataBands >= 3 && eType == GDT_Byte) {
+        papszCreateOptions = CSLSetNameValue(papszCreateOptions, "PHOTOMETRIC", "RGB");
+    }
+    GDALDatasetH hDstDS = GDALCreate(hDriver, warpFile, xSize, ySize, dataBands + 1, eType, papszCreateOptions);
+    CSLDestroy(papszCreateOptions);
+    if (hDstDS == NULL) {
+        printf("Create warp file error.\n");
+        CSLDestroy(papszTransformerOptions);
+        CPLFree(dstWKT);
+        return 2;
+    }
+    GDALSetGeoTransform(hDstDS, geoTransform);
+    GDALSetProjection(hDstDS, dstWKT);
+    for (int b = 1;b <= dataBands;b++) {
+        GDALRasterBandH hSrcBand = GDALGetRasterBand(hSrcDS, b);
+        GDALRasterBandH hDstBand = GDALGetRasterBand(hDstDS, b);
+        GDALSetRasterColorInterpretation(hDstBand, GDALGetRasterColorInterpretation(hSrcBand));
+        if (GDALGetRasterColorTable(hSrcBand) != NULL) {
+            GDALSetRasterColorTable(hDstBand, GDALGetRasterColorTable(hSrcBand));
+        }
+        int hasNoData = FALSE;
+        double noData = GDALGetRasterNoDataValue(hSrcBand, &hasNoData);
+        if (hasNoData) {
+            GDALSetRasterNoDataValue(hDstBand, noData);
+        }
+    }
+    GDALSetRasterColorInterpretation(GDALGetRasterBand(hDstDS, dataBands + 1), GCI_AlphaBand);
+    
+    /// Source → destination with the approximate transformer
+    hTransformArg = GDALCreateGenImgProjTransformer2(hSrcDS, hDstDS, NULL);
+    CSLDestroy(papszTransformerOptions);
+    CPLFree(dstWKT);
+    void *hApproxArg = NULL;
+    GDALWarpOptions *psWO = GDALCreateWarpOptions();
+    psWO->hSrcDS = hSrcDS;
+    psWO->hDstDS = hDstDS;
+    psWO->nBandCount = dataBands;
+    psWO->panSrcBands = (int *)CPLMalloc(sizeof(int) * dataBands);
+    psWO->panDstBands = (int *)CPLMalloc(sizeof(int) * dataBands);
+    for (int b = 0;b < dataBands;b++) {
+        psWO->panSrcBands[b] = b + 1;
+        psWO->panDstBands[b] = b + 1;
+    }
+    /// Nodata pixels are left out of the resampling and stay nodata
+    int hasNoData = FALSE;
+    double noData = GDALGetRasterNoDataValue(GDALGetRasterBand(hSrcDS, 1), &hasNoData);
+    if (hasNoData) {
+        psWO->padfSrcNoDataReal = (double *)CPLMalloc(sizeof(double) * dataBands);
+        psWO->padfDstNoDataReal = (double *)CPLMalloc(sizeof(double) * dataBands);
+        for (int b = 0;b < dataBands;b++) {
+            int hasBandNoData = FALSE;
+            double bandNoData = GDALGetRasterNoDataValue(GDALGetRasterBand(hSrcDS, b + 1), &hasBandNoData);
+            psWO->padfSrcNoDataReal[b] = hasBandNoData ? bandNoData : noData;
+            psWO->padfDstNoDataReal[b] = psWO->padfSrcNoDataReal[b];
+        }
+    }
+    psWO->nSrcAlphaBand = srcAlphaBand;
+    psWO->nDstAlphaBand = dataBands + 1;
+    psWO->eResampleAlg = warpResampleAlg(profile.warpResampling, hSrcDS);
+    psWO->dfWarpMemoryLimit = max(16.0, profile.warpMemory) * 1024.0 * 1024.0;
+    if (profile.warpErrorThreshold > 0.0 && hTransformArg != NULL) {
+        hApproxArg = GDALCreateApproxTransformer(GDALGenImgProjTransform, hTransformArg, profile.warpErrorThreshold);
+        psWO->pfnTransformer = GDALApproxTransform;
+        psWO->pTransformerArg = hApproxArg;
+    } else {
+        psWO->pfnTransformer = GDALGenImgProjTransform;
+        psWO->pTransformerArg = hTransformArg;
+    }
+    /// Every chunk reports its progress, a FALSE from pfnProgress cancels the warp
+    psWO->pfnProgress = pfnProgress != NULL ? pfnProgress : GDALDummyProgress;
+    psWO->pProgressArg = pProgressArg;
+    psWO->papszWarpOptions = CSLSetNameValue(psWO->papszWarpOptions, "NUM_THREADS", "ALL_CPUS");
+    psWO->papszWarpOptions = CSLSetNameValue(psWO->papszWarpOptions, "INIT_DEST", "NO_DATA");
+    psWO->papszWarpOptions = CSLSetNameValue(psWO->papszWarpOptions, "SKIP_NOSOURCE", "YES");
+    
+    int result = 2;
+    if (hTransformArg != NULL) {
+        GDALWarpOperation operation;
+        /// ChunkAndWarpMulti: one chunk is read and warped while the previous one is written
+        if (operation.Initialize(psWO) == CE_None && operation.ChunkAndWarpMulti(0, 0, xSize, ySize) == CE_None) {
+            result = 0;
+        } else if (CPLGetLastErrorNo() == CPLE_UserInterrupt) {
+            result = 5;
+        }
+    }
+    GDALDestroyWarpOptions(psWO);
+    if (hApproxArg != NULL) {
+        GDALDestroyApproxTransformer(hApproxArg);
+    }
+    if (hTransformArg != NULL) {
+        GDALDestroyGenImgProjTransformer(hTransformArg);
+    }
+    if (GDALClose(hDstDS) != CE_None && result == 0) {
+        result = 2;
+    }
+    if (result == 2) {
+        printf("Warp error.\n");
+    }
+    return result;
+}
+
+int GDAL2Mercator::preflightCOGFile(const char *inputFile) {
+    GDALDatasetH hSrcDS = GDALOpen(inputFile, GA_ReadOnly);
+    if (hSrcDS == NULL) {
+        printf("Open input file error.\n");
+        return -1;
+    }
+    
+    int result = COG_PREFLIGHT_IN_PLACE;
+    const char *reason = "EPSG:3857 tiled GeoTIFF with overviews";
+    GDALDriverH hDriver = GDALGetDatasetDriver(hSrcDS);
+    GDALRasterBandH hBand = GDALGetRasterBand(hSrcDS, 1);
+    int xSize = GDALGetRasterXSize(hSrcDS);
+    int ySize = GDALGetRasterYSize(hSrcDS);
+    int blockXSize = 0;
+    int blockYSize = 0;
+    if (hBand != NULL) {
+        GDALGetBlockSize(hBand, &blockXSize, &blockYSize);
+    }
+    
+    if (hDriver == NULL || !EQUAL(GDALGetDriverShortName(hDriver), "GTiff") || hBand == NULL) {
+        result = COG_PREFLIGHT_CONVERT;
+        reason = "not a GeoTIFF";
+    } else if (!IsWebMercator(hSrcDS)) {
+        result = COG_PREFLIGHT_CONVERT;
+        reason = "not north up EPSG:3857";
+    } else if ((blockXSize >= xSize && xSize > 512) || blockYSize < 16 || blockXSize != blockYSize) {
+        /// Strips (one row or whole-width blocks) would read far more than a tile
+        result = COG_PREFLIGHT_CONVERT;
+        reason = "not tiled";
+    } else {
+        /// Overviews down to one block, like the COG driver builds them
+        int needed = 0;
+        while ((max(xSize, ySize) >> needed) > blockXSize) {
+            needed++;
+        }
+        int overviewCount = GDALGetOverviewCount(hBand);
+        if (overviewCount == 0 && needed > 0) {
+            result = COG_PREFLIGHT_ADD_OVERVIEWS;
+            reason = "overviews missing";
+        } else if (overviewCount < needed) {
+            /// GDAL can't add external overviews next to internal ones
+            result = COG_PREFLIGHT_CONVERT;
+            reason = "overviews incomplete";
+        }
+    }
+    printf("COG preflight: %s\n", reason);
+    
+    GDALClose(hSrcDS);
+    return result;
+}
+
+int GDAL2Mercator::toCOGFile(const char *inputFile, const char *outputFile, const COGProfile *profile, bool preflight) {
+    if (inputFile == NULL || outputFile == NULL) {
+        return 1;
+    }
     _inputFile = inputFile;
+    COGProfile cogProfile = profile != NULL ? *profile : DefaultCOGProfile();
+    /// TIFF tiles are multiples of 16, the overview levels below are counted down to one block
+    if (cogProfile.blockSize <= 0) {
+        cogProfile.blockSize = 256;
+    }
+    if (cogProfile.blockSize % 16 != 0) {
+        printf("COG block size must be a multiple of 16: %d\n", cogProfile.blockSize);
+        return 1;
+    }
+    
+    int path = preflight ? preflightCOGFile(inputFile) : COG_PREFLIGHT_CONVERT;
+    if (path < 0) {
+        return 4;
+    }
+    if (path != COG_PREFLIGHT_CONVERT) {
+        /// The input stays untouched, missing overviews go to an external .ovr
+        if (path == COG_PREFLIGHT_ADD_OVERVIEWS) {
+            GDALDatasetH hSrcDS = GDALOpen(inputFile, GA_ReadOnly);
+            if (hSrcDS == NULL) {
+                return 4;
+            }
+            int levels[MAXZOOMLEVEL];
+            int levelCount = 0;
+            int size = max(GDALGetRasterXSize(hSrcDS), GDALGetRasterYSize(hSrcDS));
+            while (levelCount < MAXZOOMLEVEL && (size >> levelCount) > cogProfile.blockSize) {
+                levels[levelCount] = 2 << levelCount;
+                levelCount++;
+            }
+            CPLSetThreadLocalConfigOption("GDAL_TIFF_OVR_BLOCKSIZE", CPLSPrintf("%d", cogProfile.blockSize));
+            CPLSetThreadLocalConfigOption("COMPRESS_OVERVIEW", cogProfile.compress.empty() ? "LZW" : cogProfile.compress.c_str());
+            CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", "ALL_CPUS");
+            const char *resampling = cogProfile.overviewResampling.empty() ? "AVERAGE" : cogProfile.overviewResampling.c_str();
+            CPLErr eErr = GDALBuildOverviews(hSrcDS, resampling, levelCount, levels, 0, NULL, progressFunc, NULL);
+            CPLSetThreadLocalConfigOption("GDAL_TIFF_OVR_BLOCKSIZE", NULL);
+            CPLSetThreadLocalConfigOption("COMPRESS_OVERVIEW", NULL);
+            CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", NULL);
+            GDALClose(hSrcDS);
+            if (eErr != CE_None) {
+                printf("Build overviews error.\n");
+                return 2;
+            }
+        }
+        closeSource();
+        _sourceFileName = inputFile;
+        _cogFileName = inputFile;
+        _cogFile = _cogFileName.c_str();
+        return 0;
+    }
+    
     GDALDatasetH hSrcDS = GDALOpen(inputFile, GA_ReadOnly);
     if (hSrcDS == NULL) {
         printf("Open input file error.\n");
-        return;
+        return 4;
     }
     
     GDALDriverH hDriver = GDALGetDriverByName("COG");
     if (hDriver == NULL) {
         printf("Get COG Driver error.\n");
         GDALClose(hSrcDS);
-        return;
+        return 3;
     }
     
-    char **papszOptions = NULL;
-    papszOptions = CSLSetNameValue(papszOptions, "BLOCKSIZE", "256");
-    papszOptions = CSLSetNameValue(papszOptions, "NUM_THREADS", "ALL_CPUS");
-    papszOptions = CSLSetNameValue(papszOptions, "BIGTIFF", "IF_SAFER");
-    papszOptions = CSLSetNameValue(papszOptions, "TARGET_SRS", "EPSG:3857");
-    GDALDatasetH hDstDS = GDALCreateCopy(hDriver, outputFile, hSrcDS, FALSE, papszOptions, progressFunc, NULL);
-    if (hDstDS == NULL) {
-        printf("Copy Dataset error.\n");
+    /// Warping first: the COG driver warps with its defaults and leaves most cores idle
+    string warpFile;
+    bool warp = cogProfile.chunkedWarp && cogProfile.tilingScheme.empty() && !IsWebMercator(hSrcDS);
+    void *pCopyProgress = NULL;
+    if (warp) {
+        warpFile = string(outputFile) + ".warp.tif";
+        void *pWarpProgress = GDALCreateScaledProgress(0.0, 0.5, progressFunc, NULL);
+        int result = warpToWebMercator(hSrcDS, warpFile.c_str(), cogProfile, progressFunc != NULL ? GDALScaledProgress : NULL, pWarpProgress);
+        GDALDestroyScaledProgress(pWarpProgress);
         GDALClose(hSrcDS);
-        return;
+        if (result != 0) {
+            VSIUnlink(warpFile.c_str());
+            return result;
+        }
+        hSrcDS = GDALOpen(warpFile.c_str(), GA_ReadOnly);
+        if (hSrcDS == NULL) {
+            VSIUnlink(warpFile.c_str());
+            return 2;
+        }
+        pCopyProgress = GDALCreateScaledProgress(0.5, 1.0, progressFunc, NULL);
     }
     
+    char **papszOptions = cogOptions(cogProfile, !warp);
+    GDALProgressFunc pfnCopyProgress = warp ? (progressFunc != NULL ? GDALScaledProgress : NULL) : progressFunc;
+    GDALDatasetH hDstDS = GDALCreateCopy(hDriver, outputFile, hSrcDS, FALSE, papszOptions, pfnCopyProgress, pCopyProgress);
+    CSLDestroy(papszOptions);
     GDALClose(hSrcDS);
+    if (warp) {
+        GDALDestroyScaledProgress(pCopyProgress);
+        VSIUnlink(warpFile.c_str());
+    }
+    if (hDstDS == NULL) {
+        printf("Copy Dataset error.\n");
+        return CPLGetLastErrorNo() == CPLE_UserInterrupt ? 5 : 2;
+    }
+    
     GDALClose(hDstDS);
-    CSLDestroy(papszOptions);
-    _cogFile = outputFile;
+    closeSource();
+    _sourceFileName = outputFile;
+    _cogFileName = outputFile;
+    _cogFile = _cogFileName.c_str();
+    return 0;
 }
 
 int GDAL2Mercator::readTile(int tx, int ty, int tz, const char *outputPath) {
@@ -361,6 +1338,431 @@ int GDAL2Mercator::readTile(int tx, int ty, int tz, const char *outputPath) {
     return result;
 }
 
+TileResult GDAL2Mercator::renderTile(int tx, int ty, int tz, const char *outputPath) {
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    TileResult result;
+    result.tx = tx;
+    result.ty = ty;
+    result.tz = tz;
+    result.skipped = false;
+    
+    int tiledetails[11];
+    result.status = createTileDetails(tx, ty, tz, tiledetails);
+    if (result.status == 0) {
+        if (outputPath == NULL) {
+            result.status = createTileData(tiledetails, result.bytes);
+        } else {
+            result.status = createTileFile(tiledetails, ty, outputPath);
+            if (result.status == 0) {
+                result.path = CPLSPrintf("%s/%d/%d/%d.png", outputPath, tz, tx, ty);
+            }
+        }
+    }
+    
+    result.elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    return result;
+}
+
+future<TileResult> GDAL2Mercator::readTileAsync(int tx, int ty, int tz, const char *outputPath) {
+    shared_ptr<promise<TileResult>> result = make_shared<promise<TileResult>>();
+    readTileAsync(tx, ty, tz, outputPath, [result](const TileResult &tile) {
+        result->set_value(tile);
+    });
+    return result->get_future();
+}
+
+void GDAL2Mercator::readTileAsync(int tx, int ty, int tz, const char *outputPath, TileCallback callback) {
+    bool toFile = outputPath != NULL;
+    string path = toFile ? outputPath : "";
+    
+    TileJob job;
+    job.tx = tx;
+    job.ty = ty;
+    job.tz = tz;
+    job.priority = TILE_PRIORITY_VISIBLE;
+    job.skipExisting = false;
+    job.keepBuffer = false;
+    job.params = 0;
+    /// The pipeline has no store, the PNG goes to outputPath like readTile
+    job.callback = [this, toFile, path, callback](const TileResult &tile) {
+        TileResult result = tile;
+        if (toFile && result.status == 0) {
+            result.status = writeTile(result.tx, result.ty, result.tz, result.bytes, path.c_str());
+            result.bytes.clear();
+            if (result.status == 0) {
+                result.path = CPLSPrintf("%s/%d/%d/%d.png", path.c_str(), result.tz, result.tx, result.ty);
+            }
+        }
+        if (callback) {
+            callback(result);
+        }
+    };
+    
+    shared_ptr<TilePipeline> pipeline;
+    {
+        lock_guard<mutex> lock(_asyncMutex);
+        if (_asyncPipeline == NULL) {
+            _asyncPipeline = make_shared<TilePipeline>(this, (TileStore *)NULL);
+        }
+        if (_asyncCancelled == NULL) {
+            _asyncCancelled = make_shared<atomic<bool>>(false);
+        }
+        pipeline = _asyncPipeline;
+        job.cancelled = _asyncCancelled;
+    }
+    /// Outside of the lock: submit blocks while the queue is full
+    if (!pipeline->submit(job)) {
+        TileResult result;
+        result.tx = tx;
+        result.ty = ty;
+        result.tz = tz;
+        result.status = TILE_STATUS_CANCELLED;
+        result.elapsed = 0;
+        result.skipped = false;
+        if (callback) {
+            callback(result);
+        }
+    }
+}
+
+void GDAL2Mercator::cancelAsyncTiles(void) {
+    lock_guard<mutex> lock(_asyncMutex);
+    if (_asyncCancelled != NULL) {
+        _asyncCancelled->store(true);
+    }
+    _asyncCancelled = make_shared<atomic<bool>>(false);
+}
+
+int GDAL2Mercator::generate_base_tiles(TileStore *store, int minz, int maxz, int threads, TileIndex *index, GDALProgressFunc pfnProgress, void *pProgressArg, const char *journalFile) {
+    if (!_isFileOpened) {
+        return 4;
+    }
+    if (store == NULL) {
+        return 1;
+    }
+    minz = max(minz, 0);
+    maxz = min(maxz, _tmaxz);
+    if (minz > maxz) {
+        return 1;
+    }
+    
+    /// Only the tiles intersecting seedArea
+    TileCover *cover = seedArea != NULL && !seedArea->isEmpty() ? seedArea : NULL;
+    int ranges[MAXZOOMLEVEL][4];
+    double total = 0.0;
+    for (int tz = minz;tz <= maxz;tz++) {
+        tileRange(tz, ranges[tz]);
+        if (cover != NULL) {
+            total += double(cover->count(tz, ranges[tz]));
+        } else {
+            total += double(ranges[tz][2] - ranges[tz][0] + 1) * double(ranges[tz][3] - ranges[tz][1] + 1);
+        }
+    }
+    if (total <= 0.0) {
+        return 0;
+    }
+    
+    /// Completed tiles of an interrupted seed, skipped without looking at the store
+    unique_ptr<SeedJournal> journal;
+    if (journalFile != NULL) {
+        journal.reset(new SeedJournal(journalFile));
+        if (journal->open(TileHashMix(sourceFingerprint() ^ TileHashRotl(renderFingerprint(), 32))) != 0) {
+            journal.reset();
+        }
+    }
+    
+    if (threads <= 0) {
+        threads = max(1, int(thread::hardware_concurrency()));
+    }
+    /// Reading is I/O bound, encoding CPU bound, a single writer keeps the store batches large
+    int readers = max(1, threads / 2);
+    int encoders = max(1, threads - readers);
+    
+    shared_ptr<atomic<bool>> cancelled = make_shared<atomic<bool>>(false);
+    atomic<int> failed(0);
+    atomic<int64_t> done(0);
+    mutex progressMutex;
+    
+    auto progress = [&](const TileResult &result) {
+        if (result.status != 0 && result.status != TILE_STATUS_CANCELLED) {
+            failed++;
+        }
+        if (result.status == 0 && journal) {
+            journal->add(result.tx, result.ty, result.tz);
+        }
+        double complete = double(++done) / total;
+        if (pfnProgress != NULL) {
+            lock_guard<mutex> lock(progressMutex);
+            if (!pfnProgress(complete, "", pProgressArg)) {
+                cancelled->store(true);
+            }
+        }
+    };
+    
+    /// Tiles of the subtree (tx, ty, t) at level tz within the file
+    auto overlap = [&](int tx, int ty, int t, int tz) -> int64_t {
+        int d = tz - t;
+        int64_t w = min<int64_t>((int64_t(tx) + 1) << d, int64_t(ranges[tz][2]) + 1) - max<int64_t>(int64_t(tx) << d, ranges[tz][0]);
+        int64_t h = min<int64_t>((int64_t(ty) + 1) << d, int64_t(ranges[tz][3]) + 1) - max<int64_t>(int64_t(ty) << d, ranges[tz][1]);
+        return w > 0 && h > 0 ? w * h : 0;
+    };
+    /// Same within the area, area - the part of the area in the parent of (tx, ty, t)
+    auto subtree = [&](OGRGeometryH area, int tx, int ty, int t, int tz) -> int64_t {
+        return cover != NULL ? cover->count(area, tx, ty, t, tz, ranges[tz]) : overlap(tx, ty, t, tz);
+    };
+    
+    TilePipeline pipeline(this, store, readers, encoders, 1, 64);
+    pipeline.index = index;
+    pipeline.writeBatchSize = 64;
+    
+    /// Overview levels are composed from the decoded maxz tiles
+    bool compose = composeOverviews && minz < maxz;
+    TileComposer composer(this, &pipeline, store, index, minz, overviewResampling);
+    composer.cancelled = cancelled;
+    composer.callback = progress;
+    
+    auto storedBuffer = [&](int tx, int ty, int tz) -> shared_ptr<TileBuffer> {
+        vector<unsigned char> data;
+        shared_ptr<TileBuffer> buffer = make_shared<TileBuffer>();
+        if (!store->readTile(tx, ty, tz, data) || decodeTile(data, *buffer) != 0) {
+            return NULL;
+        }
+        return buffer;
+    };
+    
+    TileJob job;
+    job.priority = TILE_PRIORITY_PREFETCH;
+    job.skipExisting = true;
+    job.keepBuffer = compose;
+    job.cancelled = cancelled;
+    job.params = 0;
+    job.callback = progress;
+    if (compose) {
+        job.callback = [&](const TileResult &result) {
+            progress(result);
+            /// A cancelled seed leaves its parents incomplete instead of composing them with holes
+            if (cancelled->load() || result.status == TILE_STATUS_CANCELLED) {
+                return;
+            }
+            shared_ptr<TileBuffer> buffer = result.buffer;
+            if (result.status == 0 && result.skipped) {
+                buffer = storedBuffer(result.tx, result.ty, result.tz);
+            }
+            composer.add(result.tx, result.ty, result.tz, buffer);
+        };
+    }
+    
+    /// Curve orders walk from the root: neighbouring tiles are rendered close together (and journaled as long runs),
+    /// the 4 children of a parent arrive close together so only a few partially filled parents are kept in memory.
+    /// Composing needs the children together, the sweeps fall back to Morton there
+    int order = seedOrder;
+    if (compose && order != SEED_ORDER_HILBERT) {
+        order = SEED_ORDER_MORTON;
+    }
+    /// area - the part of seedArea in the parent tile, NULL - the whole tile is inside
+    /// state - Hilbert orientation
+    if (compose) {
+        function<void(int, int, int, int, OGRGeometryH)> visit = [&](int tx, int ty, int t, int state, OGRGeometryH area) {
+            if (cancelled->load() || overlap(tx, ty, t, max(t, minz)) == 0) {
+                return;
+            }
+            OGRGeometryH clipped = NULL;
+            if (area != NULL && cover->classify(area, tx, ty, t, &clipped) == TILE_COVER_OUTSIDE) {
+                /// Outside the area counts as no data, the parent is composed from the area only
+                if (t > minz) {
+                    composer.add(tx, ty, t, NULL);
+                }
+                return;
+            }
+            if (t >= minz && journal && journal->contains(tx, ty, t)) {
+                /// A parent is journaled after all its children, the whole subtree is done.
+                /// Its parent still needs it, from the store
+                for (int tz = t;tz <= maxz;tz++) {
+                    done += subtree(area, tx, ty, t, tz);
+                }
+                if (t > minz) {
+                    composer.add(tx, ty, t, storedBuffer(tx, ty, t));
+                }
+            } else if (t == maxz) {
+                job.tx = tx;
+                job.ty = ty;
+                job.tz = t;
+                pipeline.submit(job);
+            } else {
+                for (int i = 0;i < 4;i++) {
+                    int dx, dy;
+                    int child = SeedOrderChild(order, state, i, &dx, &dy);
+                    visit(tx * 2 + dx, ty * 2 + dy, t + 1, child, clipped);
+                }
+            }
+            if (clipped != NULL) {
+                OGR_G_DestroyGeometry(clipped);
+            }
+        };
+        visit(0, 0, 0, 0, cover != NULL ? cover->geometry() : NULL);
+    } else {
+        for (int tz = minz;tz <= maxz && !cancelled->load();tz++) {
+            job.tz = tz;
+            if (order == SEED_ORDER_ROW || order == SEED_ORDER_BLOCK_ROW) {
+                SeedOrderTiles(order, tz, ranges[tz], blockRowStrip(tz), [&](int tx, int ty) {
+                    if (cancelled->load()) {
+                        return false;
+                    }
+                    if (cover != NULL && !cover->intersects(tx, ty, tz)) {
+                        return true;
+                    }
+                    if (journal && journal->contains(tx, ty, tz)) {
+                        done++;
+                        return true;
+                    }
+                    job.tx = tx;
+                    job.ty = ty;
+                    pipeline.submit(job);
+                    return true;
+                });
+                continue;
+            }
+            function<void(int, int, int, int, OGRGeometryH)> visit = [&](int tx, int ty, int t, int state, OGRGeometryH area) {
+                if (cancelled->load() || overlap(tx, ty, t, tz) == 0) {
+                    return;
+                }
+                OGRGeometryH clipped = NULL;
+                if (area != NULL && cover->classify(area, tx, ty, t, &clipped) == TILE_COVER_OUTSIDE) {
+                    return;
+                }
+                uint64_t start = MortonCode(tx, ty) << (2 * (tz - t));
+                uint64_t end = start + ((uint64_t(1) << (2 * (tz - t))) - 1);
+                if (journal && journal->containsRange(tz, start, end)) {
+                    done += subtree(area, tx, ty, t, tz);
+                } else if (t == tz) {
+                    job.tx = tx;
+                    job.ty = ty;
+                    pipeline.submit(job);
+                } else {
+                    for (int i = 0;i < 4;i++) {
+                        int dx, dy;
+                        int child = SeedOrderChild(order, state, i, &dx, &dy);
+                        visit(tx * 2 + dx, ty * 2 + dy, t + 1, child, clipped);
+                    }
+                }
+                if (clipped != NULL) {
+                    OGR_G_DestroyGeometry(clipped);
+                }
+            };
+            visit(0, 0, 0, 0, cover != NULL ? cover->geometry() : NULL);
+        }
+    }
+    pipeline.waitIdle();
+    pipeline.stop();
+    
+    if (journal) {
+        /// A finished seed starts over next time, an interrupted one resumes
+        if (!cancelled->load() && failed == 0) {
+            journal->remove();
+        } else {
+            journal->close();
+        }
+    }
+    
+    if (cancelled->load()) {
+        return 5;
+    }
+    return failed > 0 ? 2 : 0;
+}
+
+int GDAL2Mercator::toPMTilesFile(const char *outputFile, int minz, int maxz, TileStore *store, GDALProgressFunc pfnProgress, void *pProgressArg) {
+    if (!_isFileOpened) {
+        return 4;
+    }
+    if (outputFile == NULL) {
+        return 1;
+    }
+    minz = max(minz, 0);
+    maxz = min(maxz, _tmaxz);
+    if (minz > maxz) {
+        return 1;
+    }
+    
+    PMTilesWriter writer(outputFile);
+    if (writer.open() != 0) {
+        return 2;
+    }
+    
+    GDALDatasetH hSrcDS = _mosaic != NULL ? NULL : GDALOpen(_cogFile, GA_ReadOnly);
+    if (hSrcDS == NULL && _mosaic == NULL) {
+        printf("Open COG dataset error.\n");
+        return 4;
+    }
+    
+    /// Only the tiles intersecting seedArea, like generate_base_tiles
+    TileCover *cover = seedArea != NULL && !seedArea->isEmpty() ? seedArea : NULL;
+    double total = 0.0;
+    for (int tz = minz;tz <= maxz;tz++) {
+        int range[4];
+        tileRange(tz, range);
+        if (cover != NULL) {
+            total += double(cover->count(tz, range));
+        } else {
+            total += double(range[2] - range[0] + 1) * double(range[3] - range[1] + 1);
+        }
+    }
+    
+    int result = 0;
+    double done = 0.0;
+    vector<unsigned char> data;
+    for (int tz = minz;tz <= maxz && result == 0;tz++) {
+        int range[4];
+        tileRange(tz, range);
+        for (int tx = range[0];tx <= range[2] && result == 0;tx++) {
+            for (int ty = range[1];ty <= range[3] && result == 0;ty++) {
+                if (cover != NULL && !cover->intersects(tx, ty, tz)) {
+                    continue;
+                }
+                data.clear();
+                if (store == NULL || !store->readTile(tx, ty, tz, data)) {
+                    TileBuffer tile;
+                    int status = readTileData(hSrcDS, tx, ty, tz, tile);
+                    if (status == 0) {
+                        transformTile(tile);
+                        status = encodeTile(tile, data);
+                    }
+                    if (status != 0) {
+                        /// 跳过生成失败的Tile
+                        data.clear();
+                    }
+                }
+                if (!data.empty()) {
+                    result = writer.addTile(tx, ty, tz, data);
+                }
+                done += 1.0;
+                if (pfnProgress != NULL && !pfnProgress(total > 0.0 ? done / total : 1.0, "", pProgressArg)) {
+                    result = 5;
+                }
+            }
+        }
+    }
+    if (hSrcDS != NULL) {
+        GDALClose(hSrcDS);
+    }
+    if (result != 0) {
+        return result;
+    }
+    
+    /// MetersToLatLon: lon, lat
+    double minLonLat[2];
+    double maxLonLat[2];
+    _mercator->MetersToLatLon(_geoTransform[0], _geoTransform[3] - _rasterYSize * _geoTransform[1], minLonLat);
+    _mercator->MetersToLatLon(_geoTransform[0] + _rasterXSize * _geoTransform[1], _geoTransform[3], maxLonLat);
+    double bounds[4] = {minLonLat[0], minLonLat[1], maxLonLat[0], maxLonLat[1]};
+    /// The file name may contain quotes or backslashes
+    CPLJSONObject json;
+    json.Add("name", string(CPLGetBasename(_sourceFileName.c_str())));
+    json.Add("format", "png");
+    json.Add("type", "overlay");
+    string metadata = json.Format(CPLJSONObject::PrettyFormat::Plain);
+    return writer.finish(bounds, metadata.c_str());
+}
+
 int GDAL2Mercator::readGoogleTiles(double lat0, double lon0, double lat1, double lon1, int tz) {
     if (_isFileOpened) {
         int xy0[2];
@@ -383,3 +1785,31 @@ int GDAL2Mercator::readGoogleTiles(double lat0, double lon0, double lat1, double
     return 4;
 }
 
+bool GDAL2Mercator::hasTile(int tx, int ty, int tz) {
+    if (!_isFileOpened || tz > _tmaxz || tz < 0) {
+        return false;
+    }
+    
+    int tmsy = getYTile(ty, tz);
+    return tx >= _tminmax[tz][0] && tx <= _tminmax[tz][2] && tmsy >= _tminmax[tz][1] && tmsy <= _tminmax[tz][3];
+}
+
+bool GDAL2Mercator::tileRange(int tz, int *range) {
+    if (!_isFileOpened || tz < 0 || tz >= MAXZOOMLEVEL) {
+        return false;
+    }
+    
+    range[0] = int(_tminmax[tz][0]);
+    range[1] = getYTile(int(_tminmax[tz][3]), tz);
+    range[2] = int(_tminmax[tz][2]);
+    range[3] = getYTile(int(_tminmax[tz][1]), tz);
+    return true;
+}
+
+int GDAL2Mercator::minZoom(void) {
+    return _tminz;
+}
+
+int GDAL2Mercator::maxZoom(void) {
+    return _tmaxz;
+}
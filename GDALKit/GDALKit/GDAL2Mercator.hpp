@@ -11,6 +11,13 @@
 #include <stdio.h>
 #include <math.h>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <memory>
 
 #include "gdal.h"
 #include "gdal_utils.h"
@@ -20,10 +27,99 @@
 
 #include "GlobalMercator.hpp"
 
+class TileStore;
+class DirectoryTileStore;
+class TilePipeline;
+class TileIndex;
+class TileCover;
+class MosaicSource;
+class MappedTiff;
+
 #define MAXZOOMLEVEL 32
 
+#define TILE_RESAMPLING_AVERAGE 0
+#define TILE_RESAMPLING_NEAREST 1
+
+/// preflightCOGFile: 直接使用原始文件
+#define COG_PREFLIGHT_IN_PLACE 0
+/// preflightCOGFile: 已是EPSG:3857的分块GeoTIFF, 只缺overview
+#define COG_PREFLIGHT_ADD_OVERVIEWS 1
+/// preflightCOGFile: 需要重投影/转换
+#define COG_PREFLIGHT_CONVERT 2
+
 using namespace std;
 
+/// toCOGFile的COG驱动创建参数, 块的压缩方式决定了读取Tile时的解码耗时
+struct COGProfile {
+    /// COMPRESS: DEFLATE / ZSTD / LZW / JPEG / WEBP / LERC / NONE, 空 - 驱动默认(LZW)
+    string compress;
+    /// LEVEL: DEFLATE 1 ~ 12, ZSTD 1 ~ 22, 0 - 驱动默认
+    int level;
+    /// PREDICTOR: YES / NO / STANDARD / FLOATING_POINT, 空 - 驱动默认
+    string predictor;
+    /// QUALITY: JPEG / WEBP 1 ~ 100, 0 - 驱动默认
+    int quality;
+    /// OVERVIEW_RESAMPLING: NEAREST / AVERAGE / BILINEAR / CUBIC / LANCZOS / MODE, 空 - 驱动默认
+    string overviewResampling;
+    /// TILING_SCHEME: 空 - 按TARGET_SRS(EPSG:3857)重投影, GoogleMapsCompatible - 块与Google Tile对齐
+    string tilingScheme;
+    /// ALIGNED_LEVELS, 只在GoogleMapsCompatible时有效, 0 - 不设置
+    int alignedLevels;
+    /// BLOCKSIZE, 16的倍数, <= 0 - 256
+    int blockSize;
+    /// 重投影: true - 先用GDALWarpOperation分块多线程重投影到临时的分块GeoTIFF, false - 由COG驱动重投影
+    /// 只在tilingScheme为空时有效
+    bool chunkedWarp;
+    /// 重投影的内存上限(MB)
+    double warpMemory;
+    /// 重投影近似变换的最大误差(像素), 0 - 精确变换
+    double warpErrorThreshold;
+    /// 重投影的重采样: NEAREST / BILINEAR / CUBIC / CUBICSPLINE / LANCZOS / AVERAGE / MODE, 空 - 同COG驱动(调色板NEAREST, 其他CUBIC)
+    string warpResampling;
+};
+
+/// 原来固定的参数: BLOCKSIZE=256, 驱动默认压缩, 重投影到EPSG:3857
+/// 重投影: 分块多线程, 512MB, 误差0.125像素
+COGProfile DefaultCOGProfile(void);
+
+/// EPSG:3857且北向上(无旋转)
+bool IsWebMercator(GDALDatasetH hSrcDS);
+
+/// 重投影到EPSG:3857的warped VRT(近似变换, 没有alpha波段时加上alpha), 先于hSrcDS关闭. 失败时返回NULL
+GDALDatasetH CreateWebMercatorVRT(GDALDatasetH hSrcDS, double errorThreshold);
+
+/// 解码后的Tile, 像素交错存储, 最后一个波段为alpha
+struct TileBuffer {
+    int tx;
+    int ty;
+    int tz;
+    int size;
+    /// 2 - Gray+Alpha, 4 - RGBA
+    int bands;
+    vector<unsigned char> pixels;
+};
+
+/// 单个Tile的生成结果
+struct TileResult {
+    int tx;
+    int ty;
+    int tz;
+    /// 同readTile的返回值
+    int status;
+    /// PNG文件路径, outputPath为NULL时为空
+    string path;
+    /// PNG数据, 只在outputPath为NULL时填充
+    vector<unsigned char> bytes;
+    /// 耗时(毫秒)
+    double elapsed;
+    /// Tile已存在, 没有重新生成
+    bool skipped;
+    /// 颜色处理后的像素, 只在TileJob.keepBuffer时填充
+    shared_ptr<TileBuffer> buffer;
+};
+
+typedef function<void(const TileResult &result)> TileCallback;
+
 class GDAL2Mercator {
 private:
     GlobalMercator *_mercator;
@@ -32,6 +128,23 @@ private:
 //    const char *_proj_lib_path;
     const char *_inputFile;
     
+    /// 读取Tile的数据集: 原始文件, 或者非EPSG:3857文件的/vsimem/ warped VRT
+    string _cogFileName;
+    /// 用户打开的原始文件, 文件指纹、统计信息、元数据名称都基于它
+    string _sourceFileName;
+    /// openMosaicWithTile打开的多文件数据源, 此时没有单个数据集(_cogFile不能用GDALOpen打开)
+    MosaicSource *_mosaic;
+    /// 无压缩分块Byte GeoTIFF的内存映射, 读取Tile时不经过GDAL块缓存. NULL - 不可映射
+    MappedTiff *_mapped;
+    /// writeTile的目录存储, 保留已创建目录的缓存, outputPath改变时重建
+    shared_ptr<DirectoryTileStore> _tileWriter;
+    mutex _tileWriterMutex;
+    /// readTileAsync的工作线程(读取/编码线程数有限), 第一次调用时创建, closeSource时停止
+    shared_ptr<TilePipeline> _asyncPipeline;
+    /// readTileAsync任务的取消标记, cancelAsyncTiles时替换
+    shared_ptr<atomic<bool>> _asyncCancelled;
+    mutex _asyncMutex;
+    
     bool _isFileOpened;
     
     int _tile_size;
@@ -40,6 +153,10 @@ private:
     int _tmaxz;
     int _rasterXSize;
     int _rasterYSize;
+    /// 第1个波段的块大小和overview数量
+    int _blockXSize;
+    int _blockYSize;
+    int _overviewCount;
     
     double _tminmax[MAXZOOMLEVEL][4];
     
@@ -54,20 +171,66 @@ private:
     
     double _mGamma;
     
+    /// GDALInfo JSON, fileInfo()第一次调用时生成
+    char *_fileInfo;
+    
+    mutex _fileInfoMutex;
+    
     void readFileInfo(GDALDatasetH hSrcDS);
     
+    /// 多文件数据源的波段数和min/max(所有文件的并集)
+    void readMosaicInfo(void);
+    
+    /// 根据_geoTransform、_rasterXSize、_rasterYSize计算每个级别的Tile范围和minz/maxz
+    void computeTileRanges(void);
+    
+    void computeBandMinMax(GDALRasterBandH hBand, double *minmax);
+    /// <cogFile>.stats.json, 文件指纹不一致时返回false
+    bool readStatistics(uint64_t source);
+    
+    void writeStatistics(uint64_t source);
+    
     int nb_data_bands(GDALDatasetH hSrcDS);
     
     int getYTile(int ty, int tz);
     
     void geo_query(int *rb, int *wb, double ulx, double uly, double lrx, double lry, int querysize=0);
     
-    void generate_base_tiles(void);
-    
     int createTileDetails(int tx, int ty, int tz, int *tiledetails);
     
+    /// GDAL读取时使用的overview, 0 - 原始分辨率. factor: 读取窗口/输出大小
+    int overviewLevel(double factor);
+    
+    /// GDAL块缓存能容纳的块数
+    int cacheBlocks(void);
+    
+    /// 读取Tile会用到的源文件块, (overview << 56) | (blockY << 28) | blockX
+    void tileBlocks(int tx, int ty, int tz, vector<uint64_t> &blocks);
+    
+    /// SEED_ORDER_BLOCK_ROW每条的Tile行数: 一列Tile用到的块都留在缓存中
+    int blockRowStrip(int tz);
+    
+    int readTileData(GDALDatasetH hSrcDS, int *tiledetails, TileBuffer &tile);
+    
+    int createTileData(int *tiledetails, vector<unsigned char> &data);
+    
     int createTileFile(int *tiledetails, int ty, const char *outputPath);
     
+    bool isIdentityTransform(void);
+    
+    /// COG驱动的创建参数, 由CSLDestroy释放. reproject: false - 原始文件已是EPSG:3857, 不再设置TARGET_SRS
+    char **cogOptions(const COGProfile &profile, bool reproject = true);
+    
+    /// GDALWarpOperation::ChunkAndWarpMulti重投影到EPSG:3857的分块GeoTIFF(warpFile)
+    /// 0 - 成功, 2 - 重投影错误, 3 - 缺少GDAL驱动, 5 - 取消
+    int warpToWebMercator(GDALDatasetH hSrcDS, const char *warpFile, const COGProfile &profile, GDALProgressFunc pfnProgress, void *pProgressArg);
+    
+    /// 重投影到EPSG:3857的warped VRT, 写到/vsimem/供每个读取线程各自打开. 失败时返回空字符串
+    string createWarpedVRT(GDALDatasetH hSrcDS);
+    
+    /// 释放当前数据源: /vsimem/ VRT、多文件数据源、文件映射
+    void closeSource(void);
+    
     // MARK: -
     int colorFilter(int value, int min, int max);
     
@@ -80,8 +243,14 @@ public:
     
     const char *_cogFile;
     
-    /// 通过GDALInfo读取的文件信息
-    char *fileInfo;
+    /// 用户打开的文件(openCOGFileWithTile的参数), _cogFile可能是/vsimem下的VRT或/vsigkcache路径
+    const char *sourceFile(void);
+    
+    /// 通过GDALInfo读取的文件信息(JSON), 第一次调用时生成
+    const char *fileInfo(void);
+    
+    /// 没有保存min/max的波段, 从最小的overview计算min/max(很快, 但不精确), 默认true
+    bool statsFromOverview;
     
     /// 
     int bandCount;
@@ -96,21 +265,129 @@ public:
     
     GDALProgressFunc progressFunc;
     
+    /// generate_base_tiles只从原始文件生成maxz, 更低的级别由4个子Tile缩小合成, 默认false
+    bool composeOverviews;
+    
+    /// 合成时的重采样: TILE_RESAMPLING_AVERAGE / TILE_RESAMPLING_NEAREST
+    int overviewResampling;
+    
+    /// generate_base_tiles的顺序: SEED_ORDER_HILBERT / SEED_ORDER_MORTON / SEED_ORDER_ROW / SEED_ORDER_BLOCK_ROW, 默认SEED_ORDER_HILBERT
+    /// composeOverviews时只能使用HILBERT / MORTON, 其他顺序按MORTON
+    int seedOrder;
+    
+    /// generate_base_tiles只生成与该区域相交的Tile, 不会被释放. NULL - 整个文件, 默认NULL
+    /// composeOverviews时区域外的子Tile按无数据合成
+    TileCover *seedArea;
+    
+    /// openCOGFileWithTile打开非EPSG:3857的文件时, 通过warped VRT实时重投影读取Tile, 不需要先toCOGFile, 默认true
+    bool warpOnTheFly;
+    
+    /// warped VRT近似变换的最大误差(像素), 0 - 精确变换, 默认0.125
+    double warpErrorThreshold;
+    
+    /// openMosaicWithTile时保持打开的空闲文件句柄数, 默认64
+    int mosaicHandles;
+    
+    /// openCOGFileWithTile打开无压缩、分块的Byte GeoTIFF时, 映射文件直接从块中读取Tile, 默认true
+    bool mappedReads;
+    
 //    void readSWNE(const char *inputFile);
     
-    void toCOGFile(const char *inputFile, const char *outputFile);
+    /// 检查原始文件的投影、分块、overview, 决定toCOGFile的处理方式
+    /// COG_PREFLIGHT_IN_PLACE / COG_PREFLIGHT_ADD_OVERVIEWS / COG_PREFLIGHT_CONVERT, 文件打开错误时返回-1
+    int preflightCOGFile(const char *inputFile);
+    /// 转换成EPSG:3857的COG文件, 成功后作为当前的cogFile(_cogFile)
+    /// preflight时, 已是EPSG:3857分块GeoTIFF的原始文件不再转换: 直接使用, 或者只生成外部overview(.ovr), 此时_cogFile为inputFile
+    /// 0 - 成功, 1 - 入参错误, 2 - 转换错误, 3 - 缺少GDAL驱动, 4 - 原始文件打开错误, 5 - 取消
+    /// - Parameters:
+    ///   - profile: 创建参数, NULL - DefaultCOGProfile()
+    ///   - preflight: false - 总是完整转换
+    int toCOGFile(const char *inputFile, const char *outputFile, const COGProfile *profile = NULL, bool preflight = true);
     /// 读取COG文件中的信息，计算出生成Tile需要的计算参数
+    /// warpOnTheFly时也可以是任意投影的GDAL栅格, 通过内存中的warped VRT读取
+    /// 目录按openMosaicWithTile打开
     /// - Parameter cogFile: cog文件路径
     void openCOGFileWithTile(const char *cogFile);
+    /// 多个栅格文件作为一个数据源, 不需要先合并. 每个Tile只读取与它相交的文件
+    /// 0 - 成功, 1 - 没有可用的文件, 4 - 打开错误
+    /// - Parameter source: 目录(包括子目录中的所有栅格), 或每行一个文件路径的文本文件(相对路径相对于该文本文件), 后面的文件覆盖前面的
+    int openMosaicWithTile(const char *source);
+    /// 当前数据源是openMosaicWithTile打开的多文件数据源
+    bool isMosaic(void);
     
     int readGoogleTiles(double lat0, double lon0, double lat1, double lon1, int tz);
+    /// Tile(Google)是否在文件范围内
+    bool hasTile(int tx, int ty, int tz);
+    /// 文件在zoomlevel下的Tile(Google)范围: minx, miny, maxx, maxy
+    bool tileRange(int tz, int *range);
+    
+    int minZoom(void);
+    
+    int maxZoom(void);
     /// 读取指定位置的Tile(Google)，保存成PNG文件
-    /// 0 - 成功, 1 - 入参错误, 2 - 生成Tile错误, 3 - 缺少GDAL驱动, 4 - 原始文件打开错误
+    /// 0 - 成功, 1 - 入参错误, 2 - 生成Tile错误, 3 - 缺少GDAL驱动, 4 - 原始文件打开错误, 5 - 已取消(TilePipeline)
     /// - Parameters:
     ///   - tx: x
     ///   - ty: y
     ///   - tz: zoomlevel
     ///   - outputPath: 保存文件的文件夹
     int readTile(int tx, int ty, int tz, const char *outputPath);
+    /// 同readTile, 返回状态、路径(或PNG数据)和耗时
+    /// - Parameter outputPath: NULL时不写文件, PNG数据放在bytes中
+    TileResult renderTile(int tx, int ty, int tz, const char *outputPath);
+    /// 在工作线程中生成Tile, 线程数有限, 任务过多时阻塞
+    /// 打开其他文件、释放或cancelAsyncTiles时, 未完成的任务以状态5结束
+    future<TileResult> readTileAsync(int tx, int ty, int tz, const char *outputPath);
+    /// 同上, 完成后在工作线程中回调
+    void readTileAsync(int tx, int ty, int tz, const char *outputPath, TileCallback callback);
+    /// 取消所有未完成的readTileAsync
+    void cancelAsyncTiles(void);
+    
+    // MARK: - 分阶段生成Tile, 供TilePipeline使用
+    /// 读取: 从已打开的数据集读取Tile像素, 每个线程使用自己的hSrcDS
+    int readTileData(GDALDatasetH hSrcDS, int tx, int ty, int tz, TileBuffer &tile);
+    /// 颜色处理: 拉伸、亮度、对比度、Gamma
+    void transformTile(TileBuffer &tile);
+    /// 编码: PNG数据
+    int encodeTile(const TileBuffer &tile, vector<unsigned char> &data);
+    /// 解码: encodeTile生成的PNG数据, 0 - 成功, 2 - 解码错误
+    int decodeTile(const vector<unsigned char> &data, TileBuffer &tile);
+    /// 写入: outputPath/z/x/y.png, 先写临时文件再重命名, 读取者不会看到写了一半的Tile
+    int writeTile(int tx, int ty, int tz, const vector<unsigned char> &data, const char *outputPath);
+    
+    // MARK: - 预生成
+    /// 多线程生成minz ~ maxz范围内(_tminmax)的所有Tile, store中已存在的Tile跳过
+    /// composeOverviews时只读取maxz, 更低的级别由子Tile合成
+    /// 0 - 成功, 1 - 入参错误, 2 - 部分Tile生成/写入错误, 4 - 原始文件打开错误, 5 - 已取消
+    /// - Parameters:
+    ///   - store: Tile保存的位置
+    ///   - threads: 读取+编码线程数, 0 - CPU核数
+    ///   - index: 已生成Tile的索引, 可以为NULL
+    ///   - pfnProgress: 每完成一个Tile回调一次(任意线程), 返回FALSE时取消
+    ///   - journalFile: 已完成Tile的日志(SeedJournal), 中断后再次调用时从中断处继续, 全部完成后删除. NULL - 不记录
+    int generate_base_tiles(TileStore *store, int minz, int maxz, int threads = 0, TileIndex *index = NULL, GDALProgressFunc pfnProgress = NULL, void *pProgressArg = NULL, const char *journalFile = NULL);
+    
+    /// 按order顺序读取tz的所有Tile时, GDAL块缓存(LRU)的命中率, 只计算不读取
+    /// - Parameter cacheBlocks: 缓存的块数, 0 - 按GDALGetCacheMax64计算
+    double blockCacheHitRatio(int order, int tz, int cacheBlocks = 0);
+    
+    // MARK: - PMTiles
+    /// 生成minz ~ maxz的所有Tile(seedArea不为空时只有相交的Tile), 保存成一个PMTiles v3文件(Hilbert顺序, 相同Tile只保存一次)
+    /// 0 - 成功, 1 - 入参错误, 2 - 写入错误, 4 - 原始文件打开错误, 5 - pfnProgress取消
+    /// - Parameters:
+    ///   - outputFile: .pmtiles文件
+    ///   - store: 已生成的Tile直接从store读取, 可以为NULL
+    ///   - pfnProgress: 每个Tile调用一次, 返回FALSE时取消, 可以为NULL
+    int toPMTilesFile(const char *outputFile, int minz, int maxz, TileStore *store = NULL, GDALProgressFunc pfnProgress = NULL, void *pProgressArg = NULL);
+    
+    // MARK: - 颜色处理
+    /// 波段拉伸范围, band: 0 ~ 3
+    void setBandRange(int band, int min, int max);
+    /// 亮度(-255 ~ 255), 对比度(-255 ~ 255), Gamma
+    void setColorAdjustment(int brightness, int contrast, double gamma);
+    /// 渲染参数(Tile大小、格式、波段、颜色处理)的指纹, 用作缓存Key的一部分
+    uint64_t renderFingerprint(void);
+    /// COG文件的指纹: 文件大小、修改时间、文件头的TileHash
+    uint64_t sourceFingerprint(void);
 };
 #endif /* SGDAL2Mercator_hpp */
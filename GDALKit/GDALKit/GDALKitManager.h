@@ -10,22 +10,122 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+typedef NS_ENUM(NSInteger, GDALKitTileStoreType) {
+    /// <cogFile without extension>/z/x/y.png
+    GDALKitTileStoreTypeDirectory = 0,
+    /// <cogFile without extension>.mbtiles, tiles are read back through tileData:y:zoomLevel:
+    GDALKitTileStoreTypeMBTiles,
+};
+
+typedef NS_ENUM(NSInteger, GDALKitTileSync) {
+    /// No fsync, a crash may lose the latest tiles but never leaves a partly written one
+    GDALKitTileSyncNone = 0,
+    /// Tiles of a written batch are fsynced together before they replace the old ones, their directories once per batch
+    GDALKitTileSyncBatch,
+    /// Every tile and its directory are fsynced when written
+    GDALKitTileSyncTile,
+};
+
+typedef NS_ENUM(NSInteger, GDALKitSeedOrder) {
+    /// Z curve
+    GDALKitSeedOrderMorton = 0,
+    /// Hilbert curve, consecutive tiles share source blocks
+    GDALKitSeedOrderHilbert,
+    /// Row by row
+    GDALKitSeedOrderRow,
+    /// Strips of rows swept column by column, sized to the GDAL block cache
+    GDALKitSeedOrderBlockRow,
+};
+
 @protocol GDALKitManagerDelegate <NSObject>
 
 - (void)onConvertCOGProgress:(double)progress;
 
 - (void)onConvertCOGCompletion;
 
+@optional
+/// A tile has been rendered, status is the GDAL2Mercator::readTile code (0 - success)
+/// - Parameters:
+///   - path: the PNG file, nil when rendering failed or the tiles are saved in MBTiles
+///   - elapsed: render time in milliseconds
+- (void)onTileReady:(int)x y:(int)y zoomLevel:(int)zoomLevel status:(int)status path:(nullable NSString *)path elapsed:(double)elapsed;
+
 @end
 
 @interface GDALKitManager : NSObject
 
 @property (weak, nonatomic, nullable) id<GDALKitManagerDelegate> delegate;
 
+/// A raster file, a directory of rasters read as one mosaic without merging them first,
+/// or an http(s):// URL of a COG read with range requests
 @property (strong, nonatomic) NSString *cogFile;
 
+/// Where rendered tiles are saved, takes effect on the next cogFile. default GDALKitTileStoreTypeDirectory
+@property (assign, nonatomic) GDALKitTileStoreType tileStoreType;
+
+/// fsync policy of GDALKitTileStoreTypeDirectory, takes effect on the next cogFile. default GDALKitTileSyncNone
+@property (assign, nonatomic) GDALKitTileSync tileSync;
+
+/// geoTiles calls inside this interval are coalesced, only the latest one is rendered. default 0.05s
+@property (assign, nonatomic) NSTimeInterval minimumRequestInterval;
+
+/// Byte budget of the in-memory cache of encoded tiles, default 64MB
+@property (assign, nonatomic) NSUInteger memoryCacheSize;
+
+/// Render tiles ahead of the camera motion and at zoom±1, default NO
+@property (assign, nonatomic) BOOL prefetchEnabled;
+
+/// Max prefetched tiles per camera sample, default 32
+@property (assign, nonatomic) int prefetchBudget;
+
+/// Seconds the camera motion is extrapolated, default 0.5
+@property (assign, nonatomic) double prefetchLookahead;
+
 - (void)geoTiles:(CLLocationCoordinate2D)southwest northeast:(CLLocationCoordinate2D)northeast zoomLevel:(int)zoomLevel;
 
+/// geoTiles with the fractional camera zoom, also feeds the prefetcher when prefetchEnabled
+- (void)updateCamera:(CLLocationCoordinate2D)southwest northeast:(CLLocationCoordinate2D)northeast zoom:(double)zoom;
+
+/// PNG data of a rendered tile, from the memory cache or else the tile file. nil when it has not been rendered yet
+- (nullable NSData *)tileData:(int)x y:(int)y zoomLevel:(int)zoomLevel;
+
+/// seedTiles reads only maxZoom from the file and builds the lower zoom levels from their 4 children, default NO
+@property (assign, nonatomic) BOOL composeOverviews;
+
+/// Order seedTiles renders the tiles in, default GDALKitSeedOrderHilbert. composeOverviews uses Hilbert or Morton only
+@property (assign, nonatomic) GDALKitSeedOrder seedOrder;
+
+/// cogFile in another projection is reprojected while its tiles are read instead of requiring toCOGFile first, default YES. Takes effect on the next cogFile
+@property (assign, nonatomic) BOOL warpOnTheFly;
+
+/// Renders every tile of minZoom ~ maxZoom into the tile store on a background queue, existing tiles are skipped.
+/// Completed tiles are journaled next to the tile store, a cancelled or killed seed continues where it stopped.
+/// progress (0 ~ 1) and completion are called on the main queue, status is the GDAL2Mercator::generate_base_tiles code
+/// - Parameter threads: read + encode threads, 0 - number of CPUs
+- (void)seedTiles:(int)minZoom maxZoom:(int)maxZoom threads:(int)threads progress:(nullable void (^)(double progress))progress completion:(nullable void (^)(int status))completion;
+
+/// Limits seedTiles and prefetching to the tiles intersecting an area, a running seed is cancelled.
+/// area: WKT or GeoJSON in WGS84 lon/lat, or a vector file (Shapefile, GeoPackage, ...). nil - the whole file
+/// Returns the TileCover::load code (0 - success)
+/// - Parameter layer: layer of the vector file, nil - the first layer
+- (int)setSeedArea:(nullable NSString *)area layer:(nullable NSString *)layer;
+
+/// Stops a running seedTiles or exportPMTiles, its completion gets status 5
+- (void)cancelSeeding;
+
+/// Renders minZoom ~ maxZoom of cogFile into one PMTiles v3 archive on a background queue,
+/// tiles already in the tile store are reused, only tiles in the seed area when one is set.
+/// status is the GDAL2Mercator::toPMTilesFile code (0 - success)
+- (void)exportPMTiles:(NSString *)pmtilesFile minZoom:(int)minZoom maxZoom:(int)maxZoom completion:(nullable void (^)(int status))completion;
+
+/// hits, misses, evictions, entries, bytes, capacity of the memory cache
+- (NSDictionary<NSString *, NSNumber *> *)memoryCacheStatistics;
+
+/// Keeps the byte ranges read from http(s):// cogFiles in cacheFile (SQLite), so they are not downloaded again,
+/// also after a restart. Least recently used ranges are dropped beyond maxBytes. Takes effect on the next cogFile.
+/// 0 - success, 2 - cacheFile error
++ (int)enableRemoteCache:(NSString *)cacheFile maxBytes:(long long)maxBytes;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -7,6 +7,16 @@
 
 #import "GDALKitManager.h"
 #import "GDAL2Mercator.hpp"
+#import "TilePrefetcher.hpp"
+#import "TilePipeline.hpp"
+#import "TileIndex.hpp"
+#import "MBTilesTileStore.hpp"
+#import "TileCover.hpp"
+#import "RemoteCache.hpp"
+#import "TileHash.hpp"
+
+#include <mutex>
+#include <unordered_set>
 
 int convertCOGProgress(double dfComplete, const char *pszMessage, void *pProgressArg) {
     NSDictionary *callbackObject = @{@"OnProgressCallback":@{@"progress":@(dfComplete * 100)}};
@@ -18,8 +28,62 @@ int convertCOGProgress(double dfComplete, const char *pszMessage, void *pProgres
     return -1;
 }
 
+/// pProgressArg of generate_base_tiles
+struct SeedProgress {
+    void (^progress)(double progress);
+    shared_ptr<atomic<bool>> cancelled;
+    /// Last value sent to the main queue
+    double reported;
+};
+
+int seedTilesProgress(double dfComplete, const char *pszMessage, void *pProgressArg) {
+    SeedProgress *context = (SeedProgress *)pProgressArg;
+    if (context->cancelled->load()) {
+        return FALSE;
+    }
+    /// At most every 0.1%
+    if (context->progress != nil && (dfComplete - context->reported >= 0.001 || dfComplete >= 1.0)) {
+        context->reported = dfComplete;
+        void (^progress)(double) = context->progress;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            progress(dfComplete);
+        });
+    }
+    return TRUE;
+}
+
 @implementation GDALKitManager {
     GDAL2Mercator *mercator;
+    TilePrefetcher *prefetcher;
+    /// read → encode → write, created for each cogFile
+    TilePipeline *pipeline;
+    /// Tiles of the current file
+    TileStore *tileStore;
+    /// Encoded tiles, shared by all pipelines
+    TileCache *tileCache;
+    /// Rendered tiles of the current file, replaces the per-tile file checks
+    TileIndex *tileIndex;
+    /// Area of interest of seedTiles and the prefetcher, empty - the whole file
+    TileCover *seedArea;
+    /// Set when a newer prediction replaces the queued prefetch tiles
+    shared_ptr<atomic<bool>> prefetchCancelled;
+    /// Set to stop the running seedTiles
+    shared_ptr<atomic<bool>> seedCancelled;
+    /// Running seedTiles / exportPMTiles, they use the store and index
+    dispatch_group_t backgroundGroup;
+    
+    /// Latest-wins geoTiles request
+    CLLocationCoordinate2D pendingSouthwest;
+    CLLocationCoordinate2D pendingNortheast;
+    int pendingZoomLevel;
+    BOOL pendingScheduled;
+    NSTimeInterval lastRequestTime;
+    /// minx, maxx, miny, maxy, zoom of the last rendered request
+    int activeRange[5];
+    /// Tiles queued or rendering
+    unordered_set<uint64_t> activeTiles;
+    /// activeRange and activeTiles
+    mutex activeTilesMutex;
 }
 
 - (instancetype)init {
@@ -32,12 +96,40 @@ int convertCOGProgress(double dfComplete, const char *pszMessage, void *pProgres
         
         self->mercator = new GDAL2Mercator([gdalData UTF8String], [projLIB UTF8String]);
         self->mercator->progressFunc = convertCOGProgress;
+        
+        self->prefetcher = new TilePrefetcher();
+        self->pipeline = NULL;
+        self->tileStore = NULL;
+        _memoryCacheSize = 64 * 1024 * 1024;
+        self->tileCache = new TileCache(_memoryCacheSize);
+        self->tileIndex = new TileIndex();
+        self->seedArea = new TileCover();
+        self->mercator->seedArea = self->seedArea;
+        _seedOrder = GDALKitSeedOrderHilbert;
+        _warpOnTheFly = YES;
+        self->prefetchCancelled = make_shared<atomic<bool>>(false);
+        self->seedCancelled = make_shared<atomic<bool>>(false);
+        self->backgroundGroup = dispatch_group_create();
+        _prefetchBudget = self->prefetcher->budget;
+        _prefetchLookahead = self->prefetcher->lookahead;
+        
+        _minimumRequestInterval = 0.05;
+        [self resetActiveTiles];
     }
     return self;
 }
 
 - (void)dealloc {
     [NSNotificationCenter.defaultCenter removeObserver:self];
+    [self cancelSeeding];
+    dispatch_group_wait(self->backgroundGroup, DISPATCH_TIME_FOREVER);
+    [self cancelPrefetch];
+    delete self->pipeline;
+    delete self->tileStore;
+    delete self->tileCache;
+    delete self->tileIndex;
+    delete self->prefetcher;
+    delete self->seedArea;
 }
 
 #pragma mark - Notification Observer
@@ -59,54 +151,336 @@ int convertCOGProgress(double dfComplete, const char *pszMessage, void *pProgres
     });
 }
 
-#pragma mark - public methods
-- (void)geoTiles:(CLLocationCoordinate2D)southwest northeast:(CLLocationCoordinate2D)northeast zoomLevel:(int)zoomLevel {
-    NSString *outputPath = [[NSString stringWithUTF8String:self->mercator->_cogFile] stringByDeletingPathExtension];
-    NSFileManager *fm = [[NSFileManager alloc] init];
+#pragma mark - private methods
+/// Next to the file the user opened: _cogFile of a reprojected file is a VRT in /vsimem
+- (NSString *)outputPath {
+    NSString *source = [NSString stringWithUTF8String:self->mercator->sourceFile()];
+    /// Remote (/vsigkcache/, /vsicurl/) and other virtual files: Caches/GDALKit/<hash of the URL>_<name>
+    if ([source hasPrefix:@"/vsi"]) {
+        NSString *url = source;
+        for (NSString *prefix in @[@REMOTE_CACHE_PREFIX, @"/vsicurl/"]) {
+            if ([url hasPrefix:prefix]) {
+                url = [url substringFromIndex:prefix.length];
+            }
+        }
+        NSString *cacheDir = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject stringByAppendingPathComponent:@"GDALKit"];
+        [NSFileManager.defaultManager createDirectoryAtPath:cacheDir withIntermediateDirectories:YES attributes:nil error:nil];
+        NSString *name = url.lastPathComponent.stringByDeletingPathExtension;
+        uint64_t hash = TileHash(url.UTF8String, strlen(url.UTF8String));
+        return [cacheDir stringByAppendingPathComponent:[NSString stringWithFormat:@"%016llx_%@", (unsigned long long)hash, name]];
+    }
+    /// Never the source itself: a mosaic directory or a file without extension gets <name>_tiles
+    BOOL isDirectory = NO;
+    if ([NSFileManager.defaultManager fileExistsAtPath:source isDirectory:&isDirectory] && isDirectory) {
+        return [source.stringByStandardizingPath stringByAppendingString:@"_tiles"];
+    }
+    NSString *outputPath = [source stringByDeletingPathExtension];
+    if (outputPath.length == 0 || [outputPath isEqualToString:source]) {
+        outputPath = [source stringByAppendingString:@"_tiles"];
+    }
+    return outputPath;
+}
+
+- (TileStore *)createTileStore {
+    NSString *outputPath = [self outputPath];
+    if (self.tileStoreType == GDALKitTileStoreTypeMBTiles) {
+        NSString *mbtilesFile = [outputPath stringByAppendingPathExtension:@"mbtiles"];
+        MBTilesTileStore *store = new MBTilesTileStore([mbtilesFile UTF8String]);
+        if (store->open() != 0) {
+            delete store;
+            return NULL;
+        }
+        store->setMetadata("name", [[outputPath lastPathComponent] UTF8String]);
+        store->setMetadata("format", "png");
+        store->setMetadata("type", "overlay");
+        store->setMetadata("minzoom", to_string(self->mercator->minZoom()).c_str());
+        store->setMetadata("maxzoom", to_string(self->mercator->maxZoom()).c_str());
+        return store;
+    }
+    
     NSError *error;
-    [fm createDirectoryAtPath:outputPath withIntermediateDirectories:YES attributes:nil error:&error];
+    [[NSFileManager defaultManager] createDirectoryAtPath:outputPath withIntermediateDirectories:YES attributes:nil error:&error];
     if (error) {
+        return NULL;
+    }
+    DirectoryTileStore *store = new DirectoryTileStore([outputPath UTF8String]);
+    store->syncPolicy = (int)self.tileSync;
+    return store;
+}
+
+- (void)notifyTileReady:(const TileResult &)result {
+    /// Existing tiles and cancelled prefetch are not reported
+    if (result.skipped || result.status == TILE_STATUS_CANCELLED) {
+        return;
+    }
+    if (!(self.delegate && [self.delegate respondsToSelector:@selector(onTileReady:y:zoomLevel:status:path:elapsed:)])) {
         return;
     }
     
-    if (self->mercator->readGoogleTiles(southwest.latitude, southwest.longitude, northeast.latitude, northeast.longitude, zoomLevel) == 0) {
-        int minx = self->mercator->rangTileXY[0];
-        int maxx = self->mercator->rangTileXY[1];
-        int miny = self->mercator->rangTileXY[2];
-        int maxy = self->mercator->rangTileXY[3];
-        
-        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-            dispatch_group_t groupx = dispatch_group_create();
-            
-            for (int tx = minx;tx <= maxx;tx++) {
-                dispatch_group_enter(groupx);
-                
-                dispatch_group_t groupy = dispatch_group_create();
-                
-                for (int ty = miny;ty <= maxy;ty++) {
-                    dispatch_group_enter(groupy);
-                    
-                    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
-                        NSString *filePath = [NSString stringWithFormat:@"%@/%d/%d/%d.png", outputPath, zoomLevel, tx, ty];
-                        if (![fm fileExistsAtPath:filePath]) {
-                            int ret = self->mercator->readTile(tx, ty, zoomLevel, [outputPath UTF8String]);
-                            dispatch_group_leave(groupy);
-                        } else {
-                            dispatch_group_leave(groupy);
-                        }
-                    });
+    NSString *path = result.path.empty() ? nil : [NSString stringWithUTF8String:result.path.c_str()];
+    int tx = result.tx;
+    int ty = result.ty;
+    int tz = result.tz;
+    int status = result.status;
+    double elapsed = result.elapsed;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (self.delegate && [self.delegate respondsToSelector:@selector(onTileReady:y:zoomLevel:status:path:elapsed:)]) {
+            [self.delegate onTileReady:tx y:ty zoomLevel:tz status:status path:path elapsed:elapsed];
+        }
+    });
+}
+
+- (void)submitTile:(int)tx y:(int)ty zoomLevel:(int)zoomLevel priority:(int)priority {
+    TileJob job;
+    job.tx = tx;
+    job.ty = ty;
+    job.tz = zoomLevel;
+    job.priority = priority;
+    job.skipExisting = true;
+    job.keepBuffer = false;
+    if (priority == TILE_PRIORITY_VISIBLE) {
+        uint64_t key = TileKey(tx, ty, zoomLevel);
+        job.callback = [self, key](const TileResult &result) {
+            {
+                lock_guard<mutex> lock(self->activeTilesMutex);
+                self->activeTiles.erase(key);
+            }
+            [self notifyTileReady:result];
+        };
+    } else {
+        job.cancelled = self->prefetchCancelled;
+        job.callback = [self](const TileResult &result) {
+            [self notifyTileReady:result];
+        };
+    }
+    self->pipeline->submit(job);
+}
+
+- (void)resetActiveTiles {
+    lock_guard<mutex> lock(self->activeTilesMutex);
+    self->activeRange[0] = -1;
+    self->activeRange[4] = -1;
+}
+
+- (void)flushPendingRequest {
+    CLLocationCoordinate2D southwest;
+    CLLocationCoordinate2D northeast;
+    int zoomLevel;
+    @synchronized (self) {
+        self->pendingScheduled = NO;
+        self->lastRequestTime = NSProcessInfo.processInfo.systemUptime;
+        southwest = self->pendingSouthwest;
+        northeast = self->pendingNortheast;
+        zoomLevel = self->pendingZoomLevel;
+    }
+    [self requestTiles:southwest northeast:northeast zoomLevel:zoomLevel];
+}
+
+- (void)requestTiles:(CLLocationCoordinate2D)southwest northeast:(CLLocationCoordinate2D)northeast zoomLevel:(int)zoomLevel {
+    if (self->mercator->readGoogleTiles(southwest.latitude, southwest.longitude, northeast.latitude, northeast.longitude, zoomLevel) != 0) {
+        return;
+    }
+    
+    int minx = self->mercator->rangTileXY[0];
+    int maxx = self->mercator->rangTileXY[1];
+    int miny = self->mercator->rangTileXY[2];
+    int maxy = self->mercator->rangTileXY[3];
+    
+    {
+        lock_guard<mutex> lock(self->activeTilesMutex);
+        /// Same tile set as the last request
+        if (self->activeRange[0] == minx && self->activeRange[1] == maxx && self->activeRange[2] == miny && self->activeRange[3] == maxy && self->activeRange[4] == zoomLevel) {
+            return;
+        }
+        self->activeRange[0] = minx;
+        self->activeRange[1] = maxx;
+        self->activeRange[2] = miny;
+        self->activeRange[3] = maxy;
+        self->activeRange[4] = zoomLevel;
+    }
+    
+    for (int tx = minx;tx <= maxx;tx++) {
+        for (int ty = miny;ty <= maxy;ty++) {
+            /// Off the raster: nothing to render, and the tile index cannot remember it
+            if (!self->mercator->hasTile(tx, ty, zoomLevel)) {
+                continue;
+            }
+            {
+                lock_guard<mutex> lock(self->activeTilesMutex);
+                /// Already queued by an earlier request
+                if (!self->activeTiles.insert(TileKey(tx, ty, zoomLevel)).second) {
+                    continue;
                 }
-                dispatch_group_notify(groupy, dispatch_get_main_queue(), ^{
-                    dispatch_group_leave(groupx);
-                });
             }
-            
-            dispatch_group_notify(groupx, dispatch_get_main_queue(), ^{
-                
+            [self submitTile:tx y:ty zoomLevel:zoomLevel priority:TILE_PRIORITY_VISIBLE];
+        }
+    }
+}
+
+- (void)cancelPrefetch {
+    @synchronized (self) {
+        self->prefetchCancelled->store(true);
+        self->prefetchCancelled = make_shared<atomic<bool>>(false);
+    }
+}
+
+- (void)prefetchTiles:(CLLocationCoordinate2D)southwest northeast:(CLLocationCoordinate2D)northeast zoom:(double)zoom {
+    self->prefetcher->addSample(southwest.latitude, southwest.longitude, northeast.latitude, northeast.longitude, zoom, NSProcessInfo.processInfo.systemUptime);
+    
+    vector<TileXYZ> tiles;
+    self->prefetcher->predictTiles(tiles);
+    
+    /// A new prediction replaces the pending one
+    [self cancelPrefetch];
+    
+    bool anywhere = self->seedArea->isEmpty();
+    for (const TileXYZ &tile : tiles) {
+        if (self->mercator->hasTile(tile.x, tile.y, tile.z) && (anywhere || self->seedArea->intersects(tile.x, tile.y, tile.z))) {
+            [self submitTile:tile.x y:tile.y zoomLevel:tile.z priority:TILE_PRIORITY_PREFETCH];
+        }
+    }
+}
+
+#pragma mark - public methods
+- (void)geoTiles:(CLLocationCoordinate2D)southwest northeast:(CLLocationCoordinate2D)northeast zoomLevel:(int)zoomLevel {
+    if (self->pipeline == NULL) {
+        return;
+    }
+    
+    @synchronized (self) {
+        self->pendingSouthwest = southwest;
+        self->pendingNortheast = northeast;
+        self->pendingZoomLevel = zoomLevel;
+        if (self->pendingScheduled) {
+            return;
+        }
+        
+        NSTimeInterval wait = self->lastRequestTime + self.minimumRequestInterval - NSProcessInfo.processInfo.systemUptime;
+        if (wait > 0) {
+            self->pendingScheduled = YES;
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(wait * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+                [self flushPendingRequest];
             });
+            return;
+        }
+    }
+    [self flushPendingRequest];
+}
+
+- (NSData *)tileData:(int)x y:(int)y zoomLevel:(int)zoomLevel {
+    if (self->pipeline == NULL || zoomLevel < 0 || zoomLevel > TILEKEY_MAXZOOM) {
+        return nil;
+    }
+    
+    TileCacheKey key = {TileKey(x, y, zoomLevel), self->mercator->renderFingerprint()};
+    TileData data;
+    if (self->tileCache->get(key, data)) {
+        return [NSData dataWithBytes:data->data() length:data->size()];
+    }
+    
+    if (!self->tileIndex->contains(x, y, zoomLevel)) {
+        return nil;
+    }
+    
+    shared_ptr<vector<unsigned char>> bytes = make_shared<vector<unsigned char>>();
+    if (!self->tileStore->readTile(x, y, zoomLevel, *bytes)) {
+        return nil;
+    }
+    self->tileCache->put(key, bytes);
+    return [NSData dataWithBytes:bytes->data() length:bytes->size()];
+}
+
+- (void)seedTiles:(int)minZoom maxZoom:(int)maxZoom threads:(int)threads progress:(void (^)(double))progress completion:(void (^)(int))completion {
+    if (self->pipeline == NULL) {
+        if (completion) {
+            completion(4);
+        }
+        return;
+    }
+    
+    GDAL2Mercator *mercator = self->mercator;
+    TileStore *store = self->tileStore;
+    TileIndex *index = self->tileIndex;
+    shared_ptr<atomic<bool>> cancelled;
+    @synchronized (self) {
+        cancelled = self->seedCancelled;
+    }
+    /// Next to the tile store, a killed seed continues where it stopped
+    NSString *journalFile = [[self outputPath] stringByAppendingPathExtension:@"seedjournal"];
+    dispatch_group_async(self->backgroundGroup, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        SeedProgress context = {progress, cancelled, 0.0};
+        int status = mercator->generate_base_tiles(store, minZoom, maxZoom, threads, index, seedTilesProgress, &context, [journalFile UTF8String]);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion) {
+                completion(status);
+            }
         });
-    } else {
-        
+    });
+}
+
+- (int)setSeedArea:(NSString *)area layer:(NSString *)layer {
+    /// The running seed walks the current area
+    [self cancelSeeding];
+    dispatch_group_wait(self->backgroundGroup, DISPATCH_TIME_FOREVER);
+    [self cancelPrefetch];
+    if (area == nil) {
+        self->seedArea->reset();
+        return 0;
+    }
+    return self->seedArea->load([area UTF8String], [layer UTF8String]);
+}
+
+- (void)cancelSeeding {
+    @synchronized (self) {
+        self->seedCancelled->store(true);
+        self->seedCancelled = make_shared<atomic<bool>>(false);
+    }
+}
+
+- (void)exportPMTiles:(NSString *)pmtilesFile minZoom:(int)minZoom maxZoom:(int)maxZoom completion:(void (^)(int))completion {
+    if (self->pipeline == NULL) {
+        if (completion) {
+            completion(4);
+        }
+        return;
+    }
+    
+    GDAL2Mercator *mercator = self->mercator;
+    TileStore *store = self->tileStore;
+    shared_ptr<atomic<bool>> cancelled;
+    @synchronized (self) {
+        cancelled = self->seedCancelled;
+    }
+    dispatch_group_async(self->backgroundGroup, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        /// Cancelled like a seed, not reported through onConvertCOGProgress
+        SeedProgress context = {nil, cancelled, 0.0};
+        int status = mercator->toPMTilesFile([pmtilesFile UTF8String], minZoom, maxZoom, store, seedTilesProgress, &context);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion) {
+                completion(status);
+            }
+        });
+    });
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)memoryCacheStatistics {
+    TileCacheStats stats = self->tileCache->stats();
+    return @{@"hits":@(stats.hits),
+             @"misses":@(stats.misses),
+             @"evictions":@(stats.evictions),
+             @"entries":@(stats.entries),
+             @"bytes":@(stats.bytes),
+             @"capacity":@(stats.capacity)};
+}
+
++ (int)enableRemoteCache:(NSString *)cacheFile maxBytes:(long long)maxBytes {
+    return RemoteCache::install(cacheFile.UTF8String, maxBytes);
+}
+
+- (void)updateCamera:(CLLocationCoordinate2D)southwest northeast:(CLLocationCoordinate2D)northeast zoom:(double)zoom {
+    [self geoTiles:southwest northeast:northeast zoomLevel:(int)round(zoom)];
+    if (self.prefetchEnabled && self->pipeline != NULL) {
+        [self prefetchTiles:southwest northeast:northeast zoom:zoom];
     }
 }
 
@@ -114,6 +488,81 @@ int convertCOGProgress(double dfComplete, const char *pszMessage, void *pProgres
 #pragma mark - getter & setter
 - (void)setCogFile:(NSString *)cogFile {
     _cogFile = cogFile;
+    [self cancelSeeding];
+    dispatch_group_wait(self->backgroundGroup, DISPATCH_TIME_FOREVER);
+    [self cancelPrefetch];
+    [self resetActiveTiles];
+    self->prefetcher->reset();
+    
+    /// Queued tiles of the previous file are cancelled
+    delete self->pipeline;
+    self->pipeline = NULL;
     self->mercator->openCOGFileWithTile([cogFile UTF8String]);
+    self->tileCache->clear();
+    
+    /// One scan of the tile store instead of a lookup per tile
+    int ranges[MAXZOOMLEVEL][4];
+    for (int tz = 0;tz < MAXZOOMLEVEL;tz++) {
+        if (!self->mercator->tileRange(tz, ranges[tz])) {
+            ranges[tz][0] = 0;
+            ranges[tz][1] = 0;
+            ranges[tz][2] = -1;
+            ranges[tz][3] = -1;
+        }
+    }
+    self->tileIndex->reset(ranges, self->mercator->maxZoom());
+    
+    delete self->tileStore;
+    self->tileStore = [self createTileStore];
+    if (self->tileStore == NULL) {
+        return;
+    }
+    /// Tiles of another file or other render parameters are removed, a matching store stays warm
+    TileManifest manifest = {self->mercator->sourceFingerprint(), self->mercator->renderFingerprint()};
+    self->tileStore->validate(manifest);
+    self->tileStore->rebuildIndex(self->tileIndex);
+    
+    /// A single writer, MBTiles batches all tiles it drains into one transaction
+    self->pipeline = new TilePipeline(self->mercator, self->tileStore, 2, 0, 1);
+    self->pipeline->cache = self->tileCache;
+    self->pipeline->index = self->tileIndex;
+}
+
+- (void)setMemoryCacheSize:(NSUInteger)memoryCacheSize {
+    _memoryCacheSize = memoryCacheSize;
+    self->tileCache->setCapacity(memoryCacheSize);
+}
+
+- (void)setComposeOverviews:(BOOL)composeOverviews {
+    _composeOverviews = composeOverviews;
+    self->mercator->composeOverviews = composeOverviews;
+}
+
+- (void)setSeedOrder:(GDALKitSeedOrder)seedOrder {
+    _seedOrder = seedOrder;
+    self->mercator->seedOrder = (int)seedOrder;
+}
+
+- (void)setWarpOnTheFly:(BOOL)warpOnTheFly {
+    _warpOnTheFly = warpOnTheFly;
+    self->mercator->warpOnTheFly = warpOnTheFly;
+}
+
+- (void)setPrefetchEnabled:(BOOL)prefetchEnabled {
+    _prefetchEnabled = prefetchEnabled;
+    if (!prefetchEnabled) {
+        [self cancelPrefetch];
+        self->prefetcher->reset();
+    }
+}
+
+- (void)setPrefetchBudget:(int)prefetchBudget {
+    _prefetchBudget = prefetchBudget;
+    self->prefetcher->budget = prefetchBudget;
+}
+
+- (void)setPrefetchLookahead:(double)prefetchLookahead {
+    _prefetchLookahead = prefetchLookahead;
+    self->prefetcher->lookahead = prefetchLookahead;
 }
 @end
@@ -9,12 +9,29 @@
 #define GlobalMercator_hpp
 
 #include <stdio.h>
+#include <stdint.h>
 #include <list>
 #include <math.h>
 #include <iostream>
 
 using namespace std;
 
+/// Google(XYZ) tile coordinate
+struct TileXYZ {
+    int x;
+    int y;
+    int z;
+};
+
+/// Highest zoom TileKey can hold: x and y get 29 bits each, 2^29 tiles per side
+#define TILEKEY_MAXZOOM 29
+
+/// Pack z/x/y into one 64 bit key, z <= TILEKEY_MAXZOOM. Higher levels collide, they are
+/// never opened (GDAL2Mercator clamps its max zoom) and rejected where keys are built from requests
+static inline uint64_t TileKey(int x, int y, int z) {
+    return ((uint64_t)z << 58) | ((uint64_t)(uint32_t)x << 29) | (uint64_t)(uint32_t)y;
+}
+
 class GlobalMercator {
 private:
     int _tile_size;
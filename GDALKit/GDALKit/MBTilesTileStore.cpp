@@ -0,0 +1,344 @@
+//
+//  MBTilesTileStore.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "MBTilesTileStore.hpp"
+#include "TileHash.hpp"
+
+#include <inttypes.h>
+
+/// MBTiles uses TMS rows
+static inline int tmsRow(int ty, int tz) {
+    return ((1 << tz) - 1) - ty;
+}
+
+MBTilesTileStore::MBTilesTileStore(const char *path) {
+    _path = path;
+    _writeDB = NULL;
+    _readDB = NULL;
+    _insertStmt = NULL;
+    _insertImageStmt = NULL;
+    _selectStmt = NULL;
+    _existsStmt = NULL;
+    _batchDepth = 0;
+    _deduplicated = false;
+}
+
+MBTilesTileStore::~MBTilesTileStore(void) {
+    close();
+}
+
+int MBTilesTileStore::exec(sqlite3 *db, const char *sql) {
+    char *errmsg = NULL;
+    if (sqlite3_exec(db, sql, NULL, NULL, &errmsg) != SQLITE_OK) {
+        printf("MBTiles error: %s (%s)\n", errmsg == NULL ? "" : errmsg, sql);
+        sqlite3_free(errmsg);
+        return 2;
+    }
+    return 0;
+}
+
+void MBTilesTileStore::close(void) {
+    if (_batchDepth > 0) {
+        /// An unfinished batch is still written
+        exec(_writeDB, "COMMIT");
+        _batchDepth = 0;
+        _batchOwner = thread::id();
+        _batchDone.notify_all();
+    }
+    sqlite3_finalize(_insertStmt);
+    sqlite3_finalize(_insertImageStmt);
+    sqlite3_finalize(_selectStmt);
+    sqlite3_finalize(_existsStmt);
+    _insertStmt = NULL;
+    _insertImageStmt = NULL;
+    _selectStmt = NULL;
+    _existsStmt = NULL;
+    sqlite3_close(_writeDB);
+    sqlite3_close(_readDB);
+    _writeDB = NULL;
+    _readDB = NULL;
+    _imageIds.clear();
+}
+
+int MBTilesTileStore::createSchema(void) {
+    /// tiles is a table in files created without deduplication
+    sqlite3_stmt *stmt = NULL;
+    int type = 0;
+    if (sqlite3_prepare_v2(_writeDB, "SELECT type FROM sqlite_master WHERE name = 'tiles'", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        type = strcmp((const char *)sqlite3_column_text(stmt, 0), "view") == 0 ? 2 : 1;
+    }
+    sqlite3_finalize(stmt);
+    _deduplicated = type == 2 || (type == 0 && deduplicate);
+    
+    if (exec(_writeDB, "CREATE TABLE IF NOT EXISTS metadata (name TEXT, value TEXT)") != 0 ||
+        exec(_writeDB, "CREATE UNIQUE INDEX IF NOT EXISTS name ON metadata (name)") != 0) {
+        return 2;
+    }
+    if (!_deduplicated) {
+        if (exec(_writeDB, "CREATE TABLE IF NOT EXISTS tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB)") != 0 ||
+            exec(_writeDB, "CREATE UNIQUE INDEX IF NOT EXISTS tile_index ON tiles (zoom_level, tile_column, tile_row)") != 0) {
+            return 2;
+        }
+        return 0;
+    }
+    
+    if (exec(_writeDB, "CREATE TABLE IF NOT EXISTS images (tile_id TEXT, tile_data BLOB)") != 0 ||
+        exec(_writeDB, "CREATE UNIQUE INDEX IF NOT EXISTS images_id ON images (tile_id)") != 0 ||
+        exec(_writeDB, "CREATE TABLE IF NOT EXISTS map (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_id TEXT)") != 0 ||
+        exec(_writeDB, "CREATE UNIQUE INDEX IF NOT EXISTS map_index ON map (zoom_level, tile_column, tile_row)") != 0 ||
+        exec(_writeDB, "CREATE VIEW IF NOT EXISTS tiles AS SELECT map.zoom_level AS zoom_level, map.tile_column AS tile_column, map.tile_row AS tile_row, images.tile_data AS tile_data FROM map JOIN images ON images.tile_id = map.tile_id") != 0) {
+        return 2;
+    }
+    
+    /// Known images are not written again
+    if (sqlite3_prepare_v2(_writeDB, "SELECT tile_id FROM images", -1, &stmt, NULL) != SQLITE_OK) {
+        return 2;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *tileId = (const char *)sqlite3_column_text(stmt, 0);
+        if (tileId != NULL) {
+            _imageIds.insert(tileId);
+        }
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+int MBTilesTileStore::open(void) {
+    close();
+    
+    if (sqlite3_open_v2(_path.c_str(), &_writeDB, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+        printf("Open MBTiles error: %s\n", sqlite3_errmsg(_writeDB));
+        close();
+        return 2;
+    }
+    
+    if (exec(_writeDB, "PRAGMA journal_mode=WAL") != 0 ||
+        exec(_writeDB, "PRAGMA synchronous=NORMAL") != 0 ||
+        createSchema() != 0) {
+        close();
+        return 2;
+    }
+    
+    const char *insertSQL = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
+    if (_deduplicated) {
+        insertSQL = "INSERT OR REPLACE INTO map (zoom_level, tile_column, tile_row, tile_id) VALUES (?, ?, ?, ?)";
+    }
+    if (sqlite3_prepare_v2(_writeDB, insertSQL, -1, &_insertStmt, NULL) != SQLITE_OK ||
+        (_deduplicated && sqlite3_prepare_v2(_writeDB, "INSERT OR IGNORE INTO images (tile_id, tile_data) VALUES (?, ?)", -1, &_insertImageStmt, NULL) != SQLITE_OK)) {
+        printf("MBTiles prepare error: %s\n", sqlite3_errmsg(_writeDB));
+        close();
+        return 2;
+    }
+    
+    if (sqlite3_open_v2(_path.c_str(), &_readDB, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(_readDB, "SELECT tile_data FROM tiles WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?", -1, &_selectStmt, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(_readDB, _deduplicated ? "SELECT 1 FROM map WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?" : "SELECT 1 FROM tiles WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?", -1, &_existsStmt, NULL) != SQLITE_OK) {
+        printf("MBTiles prepare error: %s\n", sqlite3_errmsg(_readDB));
+        close();
+        return 2;
+    }
+    return 0;
+}
+
+int MBTilesTileStore::setMetadata(const char *name, const char *value) {
+    lock_guard<mutex> lock(_writeMutex);
+    if (_writeDB == NULL) {
+        return 2;
+    }
+    
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(_writeDB, "INSERT OR REPLACE INTO metadata (name, value) VALUES (?, ?)", -1, &stmt, NULL) != SQLITE_OK) {
+        return 2;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, value, -1, SQLITE_TRANSIENT);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? 0 : 2;
+}
+
+int MBTilesTileStore::writeTile(int tx, int ty, int tz, const vector<unsigned char> &data) {
+    unique_lock<mutex> lock(_writeMutex);
+    /// Outside of its own batch a writer waits for the open batch of another one,
+    /// its tile must not end up in that transaction
+    thread::id writer = this_thread::get_id();
+    _batchDone.wait(lock, [&]() {
+        return _batchOwner == thread::id() || _batchOwner == writer;
+    });
+    if (_insertStmt == NULL) {
+        return 2;
+    }
+    
+    char tileId[40];
+    if (_deduplicated) {
+        /// tile_id: TileHash + length
+        uint64_t hash = TileHash(data.data(), data.size());
+        snprintf(tileId, sizeof(tileId), "%016" PRIx64 "-%zu", hash, data.size());
+        /// Same hash with another length is another image
+        if (_imageIds.count(tileId) > 0) {
+            _duplicates++;
+        } else {
+            sqlite3_bind_text(_insertImageStmt, 1, tileId, -1, SQLITE_STATIC);
+            sqlite3_bind_blob(_insertImageStmt, 2, data.data(), int(data.size()), SQLITE_STATIC);
+            int rc = sqlite3_step(_insertImageStmt);
+            sqlite3_reset(_insertImageStmt);
+            sqlite3_clear_bindings(_insertImageStmt);
+            if (rc != SQLITE_DONE) {
+                printf("MBTiles insert error: %s\n", sqlite3_errmsg(_writeDB));
+                return 2;
+            }
+            _imageIds.insert(tileId);
+        }
+    }
+    
+    sqlite3_bind_int(_insertStmt, 1, tz);
+    sqlite3_bind_int(_insertStmt, 2, tx);
+    sqlite3_bind_int(_insertStmt, 3, tmsRow(ty, tz));
+    if (_deduplicated) {
+        sqlite3_bind_text(_insertStmt, 4, tileId, -1, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_blob(_insertStmt, 4, data.data(), int(data.size()), SQLITE_STATIC);
+    }
+    int rc = sqlite3_step(_insertStmt);
+    sqlite3_reset(_insertStmt);
+    sqlite3_clear_bindings(_insertStmt);
+    if (rc != SQLITE_DONE) {
+        printf("MBTiles insert error: %s\n", sqlite3_errmsg(_writeDB));
+        return 2;
+    }
+    return 0;
+}
+
+bool MBTilesTileStore::readTile(int tx, int ty, int tz, vector<unsigned char> &data) {
+    lock_guard<mutex> lock(_readMutex);
+    if (_selectStmt == NULL) {
+        return false;
+    }
+    
+    sqlite3_bind_int(_selectStmt, 1, tz);
+    sqlite3_bind_int(_selectStmt, 2, tx);
+    sqlite3_bind_int(_selectStmt, 3, tmsRow(ty, tz));
+    bool found = sqlite3_step(_selectStmt) == SQLITE_ROW;
+    if (found) {
+        const unsigned char *blob = (const unsigned char *)sqlite3_column_blob(_selectStmt, 0);
+        int length = sqlite3_column_bytes(_selectStmt, 0);
+        data.assign(blob, blob + length);
+    }
+    sqlite3_reset(_selectStmt);
+    return found;
+}
+
+bool MBTilesTileStore::containsTile(int tx, int ty, int tz) {
+    lock_guard<mutex> lock(_readMutex);
+    if (_existsStmt == NULL) {
+        return false;
+    }
+    
+    sqlite3_bind_int(_existsStmt, 1, tz);
+    sqlite3_bind_int(_existsStmt, 2, tx);
+    sqlite3_bind_int(_existsStmt, 3, tmsRow(ty, tz));
+    bool found = sqlite3_step(_existsStmt) == SQLITE_ROW;
+    sqlite3_reset(_existsStmt);
+    return found;
+}
+
+int MBTilesTileStore::beginBatch(void) {
+    unique_lock<mutex> lock(_writeMutex);
+    thread::id writer = this_thread::get_id();
+    if (_batchOwner == writer) {
+        _batchDepth++;
+        return 0;
+    }
+    /// Batches of two writers (viewport and seeding pipelines) get a transaction each
+    _batchDone.wait(lock, [&]() {
+        return _batchOwner == thread::id();
+    });
+    if (_writeDB == NULL || exec(_writeDB, "BEGIN IMMEDIATE") != 0) {
+        return 2;
+    }
+    _batchOwner = writer;
+    _batchDepth = 1;
+    return 0;
+}
+
+int MBTilesTileStore::commitBatch(void) {
+    lock_guard<mutex> lock(_writeMutex);
+    /// No batch of this thread (beginBatch failed)
+    if (_batchOwner != this_thread::get_id() || --_batchDepth > 0) {
+        return 0;
+    }
+    int result = exec(_writeDB, "COMMIT");
+    if (result != 0) {
+        exec(_writeDB, "ROLLBACK");
+    }
+    _batchOwner = thread::id();
+    _batchDone.notify_all();
+    return result;
+}
+
+uint64_t MBTilesTileStore::rebuildIndex(TileIndex *index) {
+    index->clear();
+    
+    lock_guard<mutex> lock(_readMutex);
+    sqlite3_stmt *stmt = NULL;
+    const char *sql = _deduplicated ? "SELECT zoom_level, tile_column, tile_row FROM map" : "SELECT zoom_level, tile_column, tile_row FROM tiles";
+    if (_readDB == NULL || sqlite3_prepare_v2(_readDB, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return 0;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int tz = sqlite3_column_int(stmt, 0);
+        int tx = sqlite3_column_int(stmt, 1);
+        int ty = tmsRow(sqlite3_column_int(stmt, 2), tz);
+        index->set(tx, ty, tz);
+    }
+    sqlite3_finalize(stmt);
+    return index->count();
+}
+
+bool MBTilesTileStore::readManifest(TileManifest &manifest) {
+    lock_guard<mutex> lock(_readMutex);
+    sqlite3_stmt *stmt = NULL;
+    if (_readDB == NULL || sqlite3_prepare_v2(_readDB, "SELECT name, value FROM metadata WHERE name IN ('gdalkit_source', 'gdalkit_render')", -1, &stmt, NULL) != SQLITE_OK) {
+        return false;
+    }
+    int found = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *name = (const char *)sqlite3_column_text(stmt, 0);
+        const char *value = (const char *)sqlite3_column_text(stmt, 1);
+        if (name == NULL || value == NULL) {
+            continue;
+        }
+        uint64_t *field = strcmp(name, "gdalkit_source") == 0 ? &manifest.source : &manifest.render;
+        if (sscanf(value, "%" SCNx64, field) == 1) {
+            found++;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return found == 2;
+}
+
+int MBTilesTileStore::writeManifest(const TileManifest &manifest) {
+    char value[32];
+    snprintf(value, sizeof(value), "%016" PRIx64, manifest.source);
+    int result = setMetadata("gdalkit_source", value);
+    snprintf(value, sizeof(value), "%016" PRIx64, manifest.render);
+    return setMetadata("gdalkit_render", value) | result;
+}
+
+int MBTilesTileStore::clear(void) {
+    lock_guard<mutex> lock(_writeMutex);
+    if (_writeDB == NULL) {
+        return 2;
+    }
+    _imageIds.clear();
+    if (_deduplicated) {
+        return exec(_writeDB, "DELETE FROM map") | exec(_writeDB, "DELETE FROM images");
+    }
+    return exec(_writeDB, "DELETE FROM tiles");
+}
@@ -0,0 +1,86 @@
+//
+//  MBTilesTileStore.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef MBTilesTileStore_hpp
+#define MBTilesTileStore_hpp
+
+#include <stdio.h>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_set>
+
+#include "sqlite3.h"
+#include "TileStore.hpp"
+
+/// All tiles in one MBTiles(SQLite) file.
+/// WAL journal, prepared statements, and the writer wraps every batch in one transaction.
+/// Reads use their own connection so they are not blocked by a running batch.
+/// New files use the images/map schema with a tiles view when deduplicate is set,
+/// existing files keep their schema.
+class MBTilesTileStore : public TileStore {
+private:
+    string _path;
+    
+    sqlite3 *_writeDB;
+    sqlite3 *_readDB;
+    
+    sqlite3_stmt *_insertStmt;
+    sqlite3_stmt *_insertImageStmt;
+    sqlite3_stmt *_selectStmt;
+    sqlite3_stmt *_existsStmt;
+    
+    mutex _writeMutex;
+    mutex _readMutex;
+    
+    /// Thread whose batch transaction is open, guarded by _writeMutex. One writer batch,
+    /// one transaction at a time: other writers wait on _batchDone
+    thread::id _batchOwner;
+    condition_variable _batchDone;
+    /// Nested beginBatch calls of _batchOwner
+    int _batchDepth;
+    
+    /// images/map schema
+    bool _deduplicated;
+    /// tile_id (TileHash-length) of the rows in images
+    unordered_set<string> _imageIds;
+    
+    int exec(sqlite3 *db, const char *sql);
+    
+    int createSchema(void);
+    
+    void close(void);
+public:
+    MBTilesTileStore(const char *path);
+    ~MBTilesTileStore(void);
+    
+    /// 打开或创建文件, 0 - 成功, 2 - 错误
+    int open(void);
+    
+    /// metadata表: name, format, bounds, minzoom, maxzoom...
+    int setMetadata(const char *name, const char *value);
+    
+    int writeTile(int tx, int ty, int tz, const vector<unsigned char> &data) override;
+    
+    bool readTile(int tx, int ty, int tz, vector<unsigned char> &data) override;
+    
+    bool containsTile(int tx, int ty, int tz) override;
+    
+    int beginBatch(void) override;
+    
+    int commitBatch(void) override;
+    
+    uint64_t rebuildIndex(TileIndex *index) override;
+    
+    /// metadata表: gdalkit_source, gdalkit_render
+    bool readManifest(TileManifest &manifest) override;
+    
+    int writeManifest(const TileManifest &manifest) override;
+    
+    int clear(void) override;
+};
+#endif /* MBTilesTileStore_hpp */
@@ -0,0 +1,282 @@
+//
+//  MappedTiff.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "MappedTiff.hpp"
+
+#include "cpl_string.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+MappedTiff::MappedTiff(void) {
+    _fd = -1;
+    _map = NULL;
+    _mapSize = 0;
+    _blockXSize = 0;
+    _blockYSize = 0;
+    _bands = 0;
+    _pixelInterleave = true;
+    _dataBands = 1;
+    _alphaBand = -1;
+    _noData = -1;
+    _overviewCount = 0;
+}
+
+MappedTiff::~MappedTiff(void) {
+    if (_map != NULL) {
+        munmap((void *)_map, _mapSize);
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+    }
+}
+
+MappedTiff *MappedTiff::open(GDALDatasetH hSrcDS, const char *path) {
+    /// Only plain files can be mapped
+    if (hSrcDS == NULL || path == NULL || STARTS_WITH(path, "/vsi")) {
+        return NULL;
+    }
+    GDALDriverH hDriver = GDALGetDatasetDriver(hSrcDS);
+    int bands = GDALGetRasterCount(hSrcDS);
+    if (hDriver == NULL || !EQUAL(GDALGetDriverShortName(hDriver), "GTiff") || bands == 0) {
+        return NULL;
+    }
+    /// Byte samples only: their byte order is always native, and no conversion is needed
+    for (int b = 1;b <= bands;b++) {
+        if (GDALGetRasterDataType(GDALGetRasterBand(hSrcDS, b)) != GDT_Byte) {
+            return NULL;
+        }
+    }
+    GDALRasterBandH hBand = GDALGetRasterBand(hSrcDS, 1);
+    const char *compression = GDALGetMetadataItem(hSrcDS, "COMPRESSION", "IMAGE_STRUCTURE");
+    const char *interleave = GDALGetMetadataItem(hSrcDS, "INTERLEAVE", "IMAGE_STRUCTURE");
+    if ((compression != NULL && !EQUAL(compression, "NONE")) ||
+        GDALGetMetadataItem(hBand, "NBITS", "IMAGE_STRUCTURE") != NULL ||
+        GDALGetMetadataItem(hSrcDS, "SOURCE_COLOR_SPACE", "IMAGE_STRUCTURE") != NULL) {
+        return NULL;
+    }
+    if (interleave != NULL && !EQUAL(interleave, "PIXEL") && !EQUAL(interleave, "BAND")) {
+        return NULL;
+    }
+    /// readTile keeps one row pointer per plane, at most 4 (RGBA)
+    bool pixelInterleave = bands == 1 || interleave == NULL || EQUAL(interleave, "PIXEL");
+    if (!pixelInterleave && bands > 4) {
+        return NULL;
+    }
+
+    MappedTiff *tiff = new MappedTiff();
+    tiff->_bands = bands;
+    tiff->_pixelInterleave = pixelInterleave;
+    GDALGetBlockSize(hBand, &tiff->_blockXSize, &tiff->_blockYSize);
+
+    /// The alpha like GDALGetMaskBand gives it
+    int maskFlags = GDALGetMaskFlags(hBand);
+    bool supported = true;
+    if (maskFlags & GMF_ALPHA) {
+        GDALRasterBandH hLast = GDALGetRasterBand(hSrcDS, bands);
+        supported = (maskFlags & GMF_PER_DATASET) && bands > 1 && GDALGetRasterColorInterpretation(hLast) == GCI_AlphaBand;
+        tiff->_alphaBand = bands - 1;
+    } else if (maskFlags & GMF_NODATA) {
+        double noData = GDALGetRasterNoDataValue(hBand, NULL);
+        supported = noData >= 0.0 && noData <= 255.0 && noData == floor(noData);
+        tiff->_noData = int(noData);
+    } else {
+        /// .msk files and internal masks are left to GDAL
+        supported = maskFlags == GMF_ALL_VALID;
+    }
+    int dataBands = tiff->_alphaBand >= 0 || bands == 4 || bands == 2 ? bands - 1 : bands;
+    tiff->_dataBands = dataBands >= 3 ? 3 : 1;
+
+    /// Tiles: TIFF tile sizes are multiples of 16, strips are whole rows
+    if (!supported || tiff->_blockXSize % 16 != 0 || tiff->_blockYSize % 16 != 0) {
+        delete tiff;
+        return NULL;
+    }
+
+    struct stat st;
+    tiff->_fd = ::open(path, O_RDONLY);
+    if (tiff->_fd < 0 || fstat(tiff->_fd, &st) != 0 || st.st_size <= 0) {
+        delete tiff;
+        return NULL;
+    }
+    tiff->_mapSize = size_t(st.st_size);
+    void *map = mmap(NULL, tiff->_mapSize, PROT_READ, MAP_SHARED, tiff->_fd, 0);
+    if (map == MAP_FAILED) {
+        tiff->_mapSize = 0;
+        delete tiff;
+        return NULL;
+    }
+    tiff->_map = (const unsigned char *)map;
+
+    Level level;
+    if (!tiff->readLevel(hSrcDS, -1, level)) {
+        delete tiff;
+        return NULL;
+    }
+    tiff->_levels.push_back(level);
+
+    /// Offsets of overviews in an external .ovr point into that file
+    bool externalOverviews = false;
+    char **files = GDALGetFileList(hSrcDS);
+    for (int i = 0;files != NULL && files[i] != NULL;i++) {
+        externalOverviews |= EQUAL(CPLGetExtension(files[i]), "ovr");
+    }
+    CSLDestroy(files);
+    int overviews = externalOverviews ? 0 : GDALGetOverviewCount(hBand);
+    for (int i = 0;i < overviews;i++) {
+        Level overview;
+        if (!tiff->readLevel(hSrcDS, i, overview)) {
+            break;
+        }
+        tiff->_levels.push_back(overview);
+    }
+    /// Reads choosing a missing overview return false, so the levels must not have gaps
+    if (int(tiff->_levels.size()) - 1 < GDALGetOverviewCount(hBand)) {
+        tiff->_levels.resize(1);
+    }
+    tiff->_overviewCount = GDALGetOverviewCount(hBand);
+    tiff->_zeroBlock.assign(size_t(tiff->_blockXSize) * (tiff->_pixelInterleave ? bands : 1), 0);
+
+    printf("Mapped reads: %d x %d blocks, %d levels\n", tiff->_blockXSize, tiff->_blockYSize, int(tiff->_levels.size()));
+    return tiff;
+}
+
+bool MappedTiff::readLevel(GDALDatasetH hSrcDS, int overview, Level &level) {
+    int planes = _pixelInterleave ? 1 : _bands;
+    size_t blockBytes = size_t(_blockXSize) * _blockYSize * (_pixelInterleave ? _bands : 1);
+    level.offsets.resize(planes);
+    for (int p = 0;p < planes;p++) {
+        GDALRasterBandH hBand = GDALGetRasterBand(hSrcDS, p + 1);
+        if (overview >= 0) {
+            hBand = GDALGetOverview(hBand, overview);
+        }
+        int blockXSize = 0;
+        int blockYSize = 0;
+        if (hBand != NULL) {
+            GDALGetBlockSize(hBand, &blockXSize, &blockYSize);
+        }
+        if (hBand == NULL || blockXSize != _blockXSize || blockYSize != _blockYSize) {
+            return false;
+        }
+        level.xSize = GDALGetRasterBandXSize(hBand);
+        level.ySize = GDALGetRasterBandYSize(hBand);
+        level.blocksPerRow = (level.xSize + _blockXSize - 1) / _blockXSize;
+        level.blocksPerColumn = (level.ySize + _blockYSize - 1) / _blockYSize;
+
+        vector<uint64_t> &offsets = level.offsets[p];
+        offsets.assign(size_t(level.blocksPerRow) * level.blocksPerColumn, 0);
+        for (int y = 0;y < level.blocksPerColumn;y++) {
+            for (int x = 0;x < level.blocksPerRow;x++) {
+                const char *offset = GDALGetMetadataItem(hBand, CPLSPrintf("BLOCK_OFFSET_%d_%d", x, y), "TIFF");
+                if (offset == NULL) {
+                    /// Sparse, never written
+                    continue;
+                }
+                const char *size = GDALGetMetadataItem(hBand, CPLSPrintf("BLOCK_SIZE_%d_%d", x, y), "TIFF");
+                uint64_t value = strtoull(offset, NULL, 10);
+                if (size == NULL || strtoull(size, NULL, 10) < blockBytes || value + blockBytes > _mapSize) {
+                    return false;
+                }
+                offsets[size_t(y) * level.blocksPerRow + x] = value;
+            }
+        }
+    }
+    return true;
+}
+
+int MappedTiff::chooseLevel(double factor) {
+    /// The overview GDALRasterIO would take: the coarsest one not much coarser than requested
+    int level = 0;
+    while (level < _overviewCount && double(2 << level) <= factor * 1.2) {
+        level++;
+    }
+    return level < int(_levels.size()) ? level : -1;
+}
+
+bool MappedTiff::readTile(const int *window, TileBuffer &tile) {
+    int rx = window[0];
+    int ry = window[1];
+    int rxsize = window[2];
+    int rysize = window[3];
+    int wx = window[4];
+    int wy = window[5];
+    int wxsize = window[6];
+    int wysize = window[7];
+    if (tile.bands - 1 != _dataBands) {
+        return false;
+    }
+    int level = chooseLevel(double(rxsize) / wxsize);
+    if (level < 0) {
+        return false;
+    }
+    const Level &source = _levels[level];
+
+    /// The window in level pixels, nearest sampling at pixel centers
+    double scaleX = double(source.xSize) / _levels[0].xSize;
+    double scaleY = double(source.ySize) / _levels[0].ySize;
+    double ox = rx * scaleX;
+    double oy = ry * scaleY;
+    double stepX = rxsize * scaleX / wxsize;
+    double stepY = rysize * scaleY / wysize;
+    vector<int> columns(wxsize);
+    for (int i = 0;i < wxsize;i++) {
+        columns[i] = min(source.xSize - 1, max(0, int(ox + (i + 0.5) * stepX + 1e-10)));
+    }
+
+    int pixelStride = _pixelInterleave ? _bands : 1;
+    int planes = int(source.offsets.size());
+    /// RGBA / Gray+Alpha stored exactly like the tile, read 1:1: whole runs are copied
+    bool direct = _pixelInterleave && _bands == tile.bands && _alphaBand == _bands - 1 && stepX == 1.0 && ox == floor(ox);
+    const unsigned char *rows[4];
+    for (int j = 0;j < wysize;j++) {
+        int sy = min(source.ySize - 1, max(0, int(oy + (j + 0.5) * stepY + 1e-10)));
+        int blockY = sy / _blockYSize;
+        size_t rowOffset = size_t(sy % _blockYSize) * _blockXSize * pixelStride;
+        unsigned char *dst = tile.pixels.data() + (size_t(wy + j) * tile.size + wx) * tile.bands;
+
+        int i = 0;
+        while (i < wxsize) {
+            int blockX = columns[i] / _blockXSize;
+            int end = i + 1;
+            while (end < wxsize && columns[end] / _blockXSize == blockX) {
+                end++;
+            }
+            size_t block = size_t(blockY) * source.blocksPerRow + blockX;
+            for (int p = 0;p < planes;p++) {
+                uint64_t offset = source.offsets[p][block];
+                rows[p] = offset != 0 ? _map + offset + rowOffset : _zeroBlock.data();
+            }
+
+            if (direct) {
+                memcpy(dst + size_t(i) * tile.bands, rows[0] + size_t(columns[i] % _blockXSize) * _bands, size_t(end - i) * tile.bands);
+            } else {
+                for (int k = i;k < end;k++) {
+                    int x = columns[k] % _blockXSize;
+                    unsigned char *out = dst + size_t(k) * tile.bands;
+                    for (int b = 0;b < _dataBands;b++) {
+                        out[b] = _pixelInterleave ? rows[0][x * _bands + b] : rows[b][x];
+                    }
+                    if (_alphaBand >= 0) {
+                        out[_dataBands] = _pixelInterleave ? rows[0][x * _bands + _alphaBand] : rows[_alphaBand][x];
+                    } else if (_noData >= 0) {
+                        out[_dataBands] = out[0] == _noData ? 0 : 255;
+                    } else {
+                        out[_dataBands] = 255;
+                    }
+                }
+            }
+            i = end;
+        }
+    }
+    return true;
+}
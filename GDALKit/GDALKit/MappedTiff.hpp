@@ -0,0 +1,75 @@
+//
+//  MappedTiff.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef MappedTiff_hpp
+#define MappedTiff_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "GDAL2Mercator.hpp"
+
+using namespace std;
+
+/// Tile reads straight from a memory mapped, uncompressed, tiled Byte GeoTIFF.
+/// The block offsets come from the GTiff driver (BLOCK_OFFSET_x_y in the TIFF domain) once on open,
+/// after that a tile window is gathered from the mapped blocks into the tile buffer with nearest
+/// sampling like GDALRasterIO, without GDAL's block cache and its extra copy.
+/// Pixel interleaved RGBA / Gray+Alpha blocks read 1:1 are copied a block row run at a time.
+/// Reads which can not be served (e.g. an overview level that is in an external .ovr) return false
+/// and are left to GDAL. Read only, one instance is shared by all reader threads.
+class MappedTiff {
+private:
+    struct Level {
+        int xSize;
+        int ySize;
+        int blocksPerRow;
+        int blocksPerColumn;
+        /// [plane][blockY * blocksPerRow + blockX], 0 - sparse block. One plane when pixel interleaved
+        vector<vector<uint64_t>> offsets;
+    };
+
+    int _fd;
+    const unsigned char *_map;
+    size_t _mapSize;
+
+    int _blockXSize;
+    int _blockYSize;
+    /// Bands stored in the file
+    int _bands;
+    bool _pixelInterleave;
+    /// 1 - Gray, 3 - RGB
+    int _dataBands;
+    /// File band (0 based) of the alpha, -1 - none
+    int _alphaBand;
+    /// Band 1 nodata, -1 - none
+    int _noData;
+    vector<Level> _levels;
+    /// Overviews GDAL has, _levels may have fewer
+    int _overviewCount;
+    /// Stands in for sparse blocks
+    vector<unsigned char> _zeroBlock;
+
+    MappedTiff(void);
+
+    /// Block offsets of the full resolution (overview -1) or of an overview, false - not mappable
+    bool readLevel(GDALDatasetH hSrcDS, int overview, Level &level);
+
+    int chooseLevel(double factor);
+public:
+    ~MappedTiff(void);
+
+    /// Maps path when hSrcDS (opened from path) has a layout this class can read, NULL otherwise
+    static MappedTiff *open(GDALDatasetH hSrcDS, const char *path);
+
+    /// window - rx, ry, rxsize, rysize, wx, wy, wxsize, wysize like createTileDetails.
+    /// tile.size / tile.bands / tile.pixels are prepared by the caller. false - not read, use GDAL
+    bool readTile(const int *window, TileBuffer &tile);
+};
+#endif /* MappedTiff_hpp */
@@ -0,0 +1,375 @@
+//
+//  MosaicSource.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "MosaicSource.hpp"
+#include "TileHash.hpp"
+
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+MosaicSource::MosaicSource(void) {
+    _index = NULL;
+    _rasterXSize = 0;
+    _rasterYSize = 0;
+    _dataBands = 1;
+    maxHandles = 64;
+    warpErrorThreshold = 0.125;
+}
+
+MosaicSource::~MosaicSource(void) {
+    close();
+}
+
+void MosaicSource::fileBounds(const void *hFeature, CPLRectObj *pBounds) {
+    *pBounds = ((const MosaicFile *)hFeature)->bounds;
+}
+
+int MosaicSource::open(const char *source) {
+    if (source == NULL) {
+        return 1;
+    }
+    VSIStatBufL sStat;
+    if (VSIStatL(source, &sStat) != 0) {
+        printf("Open mosaic error: %s\n", source);
+        return 4;
+    }
+
+    vector<string> files;
+    if (VSI_ISDIR(sStat.st_mode)) {
+        char **entries = VSIReadDirRecursive(source);
+        for (int i = 0;entries != NULL && entries[i] != NULL;i++) {
+            const char *extension = CPLGetExtension(entries[i]);
+            /// Sidecars of the rasters, .ovr files are TIFFs too
+            if (EQUAL(extension, "ovr") || EQUAL(extension, "msk") || EQUAL(extension, "xml") || EQUAL(extension, "json")) {
+                continue;
+            }
+            string path = CPLFormFilename(source, entries[i], NULL);
+            VSIStatBufL sEntry;
+            if (VSIStatL(path.c_str(), &sEntry) != 0 || VSI_ISDIR(sEntry.st_mode)) {
+                continue;
+            }
+            if (GDALIdentifyDriverEx(path.c_str(), GDAL_OF_RASTER, NULL, NULL) != NULL) {
+                files.push_back(path);
+            }
+        }
+        CSLDestroy(entries);
+        /// The directory listing order is not stable
+        sort(files.begin(), files.end());
+    } else {
+        VSILFILE *fp = VSIFOpenL(source, "rb");
+        if (fp == NULL) {
+            printf("Open mosaic error: %s\n", source);
+            return 4;
+        }
+        string directory = CPLGetPath(source);
+        const char *line;
+        while ((line = CPLReadLineL(fp)) != NULL) {
+            string path = line;
+            size_t begin = path.find_first_not_of(" \t\r");
+            size_t end = path.find_last_not_of(" \t\r");
+            if (begin == string::npos || path[begin] == '#') {
+                continue;
+            }
+            path = path.substr(begin, end - begin + 1);
+            if (CPLIsFilenameRelative(path.c_str())) {
+                path = CPLFormFilename(directory.c_str(), path.c_str(), NULL);
+            }
+            files.push_back(path);
+        }
+        VSIFCloseL(fp);
+    }
+    return open(files);
+}
+
+int MosaicSource::open(const vector<string> &files) {
+    close();
+    _files.reserve(files.size());
+    for (const string &path : files) {
+        addFile(path);
+    }
+    if (_files.empty()) {
+        printf("Mosaic has no readable raster.\n");
+        return 1;
+    }
+
+    /// The union of the footprints at the finest pixel size
+    CPLRectObj bounds = _files[0].bounds;
+    double resolution = _files[0].geoTransform[1];
+    for (const MosaicFile &file : _files) {
+        bounds.minx = min(bounds.minx, file.bounds.minx);
+        bounds.miny = min(bounds.miny, file.bounds.miny);
+        bounds.maxx = max(bounds.maxx, file.bounds.maxx);
+        bounds.maxy = max(bounds.maxy, file.bounds.maxy);
+        resolution = min(resolution, file.geoTransform[1]);
+    }
+    resolution = max(resolution, max(bounds.maxx - bounds.minx, bounds.maxy - bounds.miny) / INT_MAX);
+    _geoTransform[0] = bounds.minx;
+    _geoTransform[1] = resolution;
+    _geoTransform[2] = 0.0;
+    _geoTransform[3] = bounds.maxy;
+    _geoTransform[4] = 0.0;
+    _geoTransform[5] = -resolution;
+    _rasterXSize = max(1, int(ceil((bounds.maxx - bounds.minx) / resolution - 0.001)));
+    _rasterYSize = max(1, int(ceil((bounds.maxy - bounds.miny) / resolution - 0.001)));
+    _dataBands = _files[0].dataBands;
+
+    /// _files is not resized anymore, the tree keeps pointers into it
+    _index = CPLQuadTreeCreate(&bounds, fileBounds);
+    for (MosaicFile &file : _files) {
+        CPLQuadTreeInsert(_index, &file);
+    }
+    printf("Mosaic of %d files, %d x %d\n", int(_files.size()), _rasterXSize, _rasterYSize);
+    return 0;
+}
+
+int MosaicSource::addFile(const string &path) {
+    GDALDatasetH hSrcDS = GDALOpenEx(path.c_str(), GDAL_OF_RASTER | GDAL_OF_READONLY, NULL, NULL, NULL);
+    if (hSrcDS == NULL) {
+        printf("Skip mosaic file %s: open error\n", path.c_str());
+        return 4;
+    }
+    int bands = GDALGetRasterCount(hSrcDS);
+    if (bands == 0) {
+        GDALClose(hSrcDS);
+        return 1;
+    }
+
+    MosaicFile file;
+    file.path = path;
+    int alphaFlags = GDALGetMaskFlags(GDALGetRasterBand(hSrcDS, 1));
+    int dataBands = (alphaFlags & GMF_ALPHA) || bands == 4 || bands == 2 ? bands - 1 : bands;
+    file.dataBands = dataBands >= 3 ? 3 : 1;
+    file.warped = !IsWebMercator(hSrcDS);
+
+    /// The grid of a warped file is the one its warped VRT gets again when the handle is opened
+    GDALDatasetH hGridDS = file.warped ? CreateWebMercatorVRT(hSrcDS, warpErrorThreshold) : hSrcDS;
+    int status = 0;
+    if (hGridDS == NULL || GDALGetGeoTransform(hGridDS, file.geoTransform) != CE_None) {
+        printf("Skip mosaic file %s: no EPSG:3857 grid\n", path.c_str());
+        status = 2;
+    } else {
+        file.xSize = GDALGetRasterXSize(hGridDS);
+        file.ySize = GDALGetRasterYSize(hGridDS);
+        file.bounds.minx = file.geoTransform[0];
+        file.bounds.maxx = file.geoTransform[0] + file.xSize * file.geoTransform[1];
+        file.bounds.maxy = file.geoTransform[3];
+        file.bounds.miny = file.geoTransform[3] + file.ySize * file.geoTransform[5];
+        _files.push_back(file);
+    }
+    if (hGridDS != NULL && hGridDS != hSrcDS) {
+        GDALClose(hGridDS);
+    }
+    GDALClose(hSrcDS);
+    return status;
+}
+
+void MosaicSource::close(void) {
+    lock_guard<mutex> lock(_handlesMutex);
+    for (MosaicHandle &handle : _handles) {
+        closeHandle(handle);
+    }
+    _handles.clear();
+    if (_index != NULL) {
+        CPLQuadTreeDestroy(_index);
+        _index = NULL;
+    }
+    _files.clear();
+    _rasterXSize = 0;
+    _rasterYSize = 0;
+}
+
+int MosaicSource::fileCount(void) {
+    return int(_files.size());
+}
+
+void MosaicSource::grid(double *geoTransform, int *xSize, int *ySize) {
+    memcpy(geoTransform, _geoTransform, sizeof(_geoTransform));
+    *xSize = _rasterXSize;
+    *ySize = _rasterYSize;
+}
+
+int MosaicSource::dataBands(void) {
+    return _dataBands;
+}
+
+const char *MosaicSource::filePath(int file) {
+    return file >= 0 && file < int(_files.size()) ? _files[file].path.c_str() : NULL;
+}
+
+uint64_t MosaicSource::fingerprint(void) {
+    vector<uint64_t> values;
+    values.reserve(_files.size() * 3);
+    for (const MosaicFile &file : _files) {
+        VSIStatBufL sStat;
+        if (VSIStatL(file.path.c_str(), &sStat) != 0) {
+            memset(&sStat, 0, sizeof(sStat));
+        }
+        values.push_back(TileHash(file.path.data(), file.path.size()));
+        values.push_back(uint64_t(sStat.st_size));
+        values.push_back(uint64_t(sStat.st_mtime));
+    }
+    return TileHash(values.data(), values.size() * sizeof(uint64_t));
+}
+
+void MosaicSource::search(const double *bound, vector<int> &files) {
+    files.clear();
+    if (_index == NULL) {
+        return;
+    }
+    CPLRectObj rect = {bound[0], bound[1], bound[2], bound[3]};
+    int count = 0;
+    void **features = CPLQuadTreeSearch(_index, &rect, &count);
+    for (int i = 0;i < count;i++) {
+        const MosaicFile *file = (const MosaicFile *)features[i];
+        /// The tree also returns files which only touch the bound
+        if (file->bounds.minx < bound[2] && file->bounds.maxx > bound[0] && file->bounds.miny < bound[3] && file->bounds.maxy > bound[1]) {
+            files.push_back(int(file - _files.data()));
+        }
+    }
+    CPLFree(features);
+    sort(files.begin(), files.end());
+}
+
+MosaicSource::MosaicHandle MosaicSource::acquire(int file) {
+    {
+        lock_guard<mutex> lock(_handlesMutex);
+        for (list<MosaicHandle>::iterator it = _handles.begin();it != _handles.end();++it) {
+            if (it->file == file) {
+                MosaicHandle handle = *it;
+                _handles.erase(it);
+                return handle;
+            }
+        }
+    }
+
+    MosaicHandle handle = {file, NULL, NULL};
+    handle.hSrcDS = GDALOpenEx(_files[file].path.c_str(), GDAL_OF_RASTER | GDAL_OF_READONLY, NULL, NULL, NULL);
+    if (handle.hSrcDS != NULL && _files[file].warped) {
+        handle.hWarpedDS = CreateWebMercatorVRT(handle.hSrcDS, warpErrorThreshold);
+        if (handle.hWarpedDS == NULL) {
+            closeHandle(handle);
+        }
+    }
+    return handle;
+}
+
+void MosaicSource::release(MosaicHandle handle) {
+    lock_guard<mutex> lock(_handlesMutex);
+    _handles.push_front(handle);
+    while (int(_handles.size()) > max(1, maxHandles)) {
+        closeHandle(_handles.back());
+        _handles.pop_back();
+    }
+}
+
+void MosaicSource::closeHandle(MosaicHandle &handle) {
+    /// The warped VRT holds a reference to its source, it is closed first
+    if (handle.hWarpedDS != NULL) {
+        GDALClose(handle.hWarpedDS);
+        handle.hWarpedDS = NULL;
+    }
+    if (handle.hSrcDS != NULL) {
+        GDALClose(handle.hSrcDS);
+        handle.hSrcDS = NULL;
+    }
+}
+
+int MosaicSource::readFile(int index, const double *bound, TileBuffer &tile, vector<unsigned char> &scratch) {
+    const MosaicFile &file = _files[index];
+    int size = tile.size;
+    double resolution = (bound[2] - bound[0]) / size;
+
+    /// Tile pixels covered by the file
+    int wx0 = max(0, int(floor((max(bound[0], file.bounds.minx) - bound[0]) / resolution + 0.001)));
+    int wx1 = min(size, int(ceil((min(bound[2], file.bounds.maxx) - bound[0]) / resolution - 0.001)));
+    int wy0 = max(0, int(floor((bound[3] - min(bound[3], file.bounds.maxy)) / resolution + 0.001)));
+    int wy1 = min(size, int(ceil((bound[3] - max(bound[1], file.bounds.miny)) / resolution - 0.001)));
+    if (wx1 <= wx0 || wy1 <= wy0) {
+        return 0;
+    }
+
+    /// The same window in file pixels, kept fractional so neighbouring files line up
+    const double *gt = file.geoTransform;
+    double sx0 = max(0.0, (bound[0] + wx0 * resolution - gt[0]) / gt[1]);
+    double sx1 = min(double(file.xSize), (bound[0] + wx1 * resolution - gt[0]) / gt[1]);
+    double sy0 = max(0.0, (bound[3] - wy0 * resolution - gt[3]) / gt[5]);
+    double sy1 = min(double(file.ySize), (bound[3] - wy1 * resolution - gt[3]) / gt[5]);
+    if (sx1 <= sx0 || sy1 <= sy0) {
+        return 0;
+    }
+    int rx = int(floor(sx0));
+    int ry = int(floor(sy0));
+    int rxsize = max(1, min(file.xSize, int(ceil(sx1))) - rx);
+    int rysize = max(1, min(file.ySize, int(ceil(sy1))) - ry);
+    GDALRasterIOExtraArg sExtraArg;
+    INIT_RASTERIO_EXTRA_ARG(sExtraArg);
+    sExtraArg.bFloatingPointWindowValidity = TRUE;
+    sExtraArg.dfXOff = sx0;
+    sExtraArg.dfYOff = sy0;
+    sExtraArg.dfXSize = sx1 - sx0;
+    sExtraArg.dfYSize = sy1 - sy0;
+
+    MosaicHandle handle = acquire(index);
+    if (handle.hSrcDS == NULL) {
+        printf("Open mosaic file %s error.\n", file.path.c_str());
+        return 4;
+    }
+    GDALDatasetH hDS = handle.hWarpedDS != NULL ? handle.hWarpedDS : handle.hSrcDS;
+
+    int wxsize = wx1 - wx0;
+    int wysize = wy1 - wy0;
+    int dataBands = tile.bands - 1;
+    int bandMap[3];
+    for (int b = 0;b < 3;b++) {
+        bandMap[b] = file.dataBands >= 3 ? b + 1 : 1;
+    }
+    scratch.assign(size_t(wxsize) * wysize * tile.bands, 0);
+    GSpacing pixelSpace = tile.bands;
+    GSpacing lineSpace = GSpacing(wxsize) * tile.bands;
+    CPLErr eErr = GDALDatasetRasterIOEx(hDS, GF_Read, rx, ry, rxsize, rysize, scratch.data(), wxsize, wysize, GDT_Byte, dataBands, bandMap, pixelSpace, lineSpace, 1, &sExtraArg);
+    if (eErr == CE_None) {
+        GDALRasterBandH alphaBand = GDALGetMaskBand(GDALGetRasterBand(hDS, 1));
+        eErr = GDALRasterIOEx(alphaBand, GF_Read, rx, ry, rxsize, rysize, scratch.data() + dataBands, wxsize, wysize, GDT_Byte, pixelSpace, lineSpace, &sExtraArg);
+    }
+    release(handle);
+    if (eErr != CE_None) {
+        printf("Read mosaic file %s error.\n", file.path.c_str());
+        return 2;
+    }
+
+    /// Drawn over the files before it wherever it has data
+    for (int y = 0;y < wysize;y++) {
+        const unsigned char *src = scratch.data() + size_t(y) * wxsize * tile.bands;
+        unsigned char *dst = tile.pixels.data() + (size_t(wy0 + y) * size + wx0) * tile.bands;
+        for (int x = 0;x < wxsize;x++) {
+            if (src[dataBands] != 0) {
+                memcpy(dst, src, tile.bands);
+            }
+            src += tile.bands;
+            dst += tile.bands;
+        }
+    }
+    return 0;
+}
+
+int MosaicSource::readTile(const double *bound, TileBuffer &tile) {
+    vector<int> files;
+    search(bound, files);
+    vector<unsigned char> scratch;
+    for (int file : files) {
+        int status = readFile(file, bound, tile, scratch);
+        if (status != 0) {
+            return status;
+        }
+    }
+    return 0;
+}
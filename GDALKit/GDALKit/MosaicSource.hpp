@@ -0,0 +1,115 @@
+//
+//  MosaicSource.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef MosaicSource_hpp
+#define MosaicSource_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cpl_quad_tree.h"
+#include "GDAL2Mercator.hpp"
+
+using namespace std;
+
+/// Many rasters read as one source, without merging them into one file first.
+/// The EPSG:3857 footprints of the files are kept in a quad tree, a tile only opens and reads
+/// the few files it intersects. Files in another projection are read through a warped VRT.
+/// Open dataset handles are pooled: a handle is used by one thread at a time,
+/// the idle ones are kept in LRU order and the least recently used are closed beyond maxHandles.
+class MosaicSource {
+private:
+    struct MosaicFile {
+        string path;
+        /// EPSG:3857 grid of the file, or of its warped VRT
+        double geoTransform[6];
+        int xSize;
+        int ySize;
+        /// minx, miny, maxx, maxy in meters
+        CPLRectObj bounds;
+        /// Not EPSG:3857, opened through GDALAutoCreateWarpedVRT
+        bool warped;
+        /// 1 - Gray, 3 - RGB
+        int dataBands;
+    };
+
+    struct MosaicHandle {
+        int file;
+        GDALDatasetH hSrcDS;
+        /// NULL - the file is read directly
+        GDALDatasetH hWarpedDS;
+    };
+
+    vector<MosaicFile> _files;
+    CPLQuadTree *_index;
+
+    /// Idle handles, most recently used first
+    list<MosaicHandle> _handles;
+    mutex _handlesMutex;
+
+    double _geoTransform[6];
+    int _rasterXSize;
+    int _rasterYSize;
+    int _dataBands;
+
+    static void fileBounds(const void *hFeature, CPLRectObj *pBounds);
+
+    int addFile(const string &path);
+
+    MosaicHandle acquire(int file);
+
+    void release(MosaicHandle handle);
+
+    void closeHandle(MosaicHandle &handle);
+
+    int readFile(int index, const double *bound, TileBuffer &tile, vector<unsigned char> &scratch);
+public:
+    MosaicSource(void);
+    ~MosaicSource(void);
+
+    /// Idle dataset handles kept open, default 64
+    int maxHandles;
+
+    /// Approximation error (pixels) of the warped VRTs, default 0.125
+    double warpErrorThreshold;
+
+    /// A directory (all rasters in it and its subdirectories) or a text file with one raster per line,
+    /// relative paths are relative to the text file. Files which can not be read are skipped.
+    /// 0 - 成功, 1 - 没有可用的文件, 4 - 打开错误
+    int open(const char *source);
+
+    /// Rasters in drawing order, later files are drawn over earlier ones
+    int open(const vector<string> &files);
+
+    void close(void);
+
+    int fileCount(void);
+
+    /// Virtual grid over all files: the union of the footprints at the finest pixel size
+    void grid(double *geoTransform, int *xSize, int *ySize);
+
+    /// 1 - Gray, 3 - RGB, from the first file
+    int dataBands(void);
+
+    /// Path of the i-th file in drawing order
+    const char *filePath(int file);
+
+    /// Size, modification time and path of every file
+    uint64_t fingerprint(void);
+
+    /// Indices (drawing order) of the files intersecting bound (minx, miny, maxx, maxy)
+    void search(const double *bound, vector<int> &files);
+
+    /// Reads the tile with bound (minx, miny, maxx, maxy) from the files it intersects into tile.pixels.
+    /// tile.size / tile.bands are set by the caller, pixels outside every file stay transparent
+    int readTile(const double *bound, TileBuffer &tile);
+};
+#endif /* MosaicSource_hpp */
@@ -0,0 +1,581 @@
+//
+//  PMTiles.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "PMTiles.hpp"
+#include "TileHash.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <math.h>
+#include <algorithm>
+#include <zlib.h>
+
+// MARK: - Encoding
+static void writeVarint(vector<unsigned char> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static bool readVarint(const unsigned char *&p, const unsigned char *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0;shift < 64 && p < end;shift += 7) {
+        unsigned char b = *p++;
+        value |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void writeUInt(unsigned char *p, uint64_t value, int bytes) {
+    for (int i = 0;i < bytes;i++) {
+        p[i] = (unsigned char)(value >> (i * 8));
+    }
+}
+
+static uint64_t readUInt(const unsigned char *p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0;i < bytes;i++) {
+        value |= (uint64_t)p[i] << (i * 8);
+    }
+    return value;
+}
+
+static bool gzipData(const unsigned char *data, size_t length, vector<unsigned char> &out) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&stream, length) + 32);
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = (uInt)length;
+    stream.next_out = out.data();
+    stream.avail_out = (uInt)out.size();
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+static bool gunzipData(const unsigned char *data, size_t length, vector<unsigned char> &out) {
+    z_stream stream = {};
+    /// gzip or zlib header
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        return false;
+    }
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = (uInt)length;
+    out.resize(max((size_t)4096, length * 4));
+    int result = Z_OK;
+    while (result == Z_OK) {
+        if (stream.total_out == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        stream.next_out = out.data() + stream.total_out;
+        stream.avail_out = (uInt)(out.size() - stream.total_out);
+        result = inflate(&stream, Z_NO_FLUSH);
+    }
+    out.resize(stream.total_out);
+    inflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+static void serializeDirectory(const PMTilesEntry *entries, size_t count, vector<unsigned char> &out) {
+    vector<unsigned char> raw;
+    writeVarint(raw, count);
+    uint64_t lastId = 0;
+    for (size_t i = 0;i < count;i++) {
+        writeVarint(raw, entries[i].tileId - lastId);
+        lastId = entries[i].tileId;
+    }
+    for (size_t i = 0;i < count;i++) {
+        writeVarint(raw, entries[i].runLength);
+    }
+    for (size_t i = 0;i < count;i++) {
+        writeVarint(raw, entries[i].length);
+    }
+    for (size_t i = 0;i < count;i++) {
+        /// 0 - directly after the previous entry
+        if (i > 0 && entries[i].offset == entries[i - 1].offset + entries[i - 1].length) {
+            writeVarint(raw, 0);
+        } else {
+            writeVarint(raw, entries[i].offset + 1);
+        }
+    }
+    gzipData(raw.data(), raw.size(), out);
+}
+
+static bool deserializeDirectory(const unsigned char *data, size_t length, vector<PMTilesEntry> &entries) {
+    const unsigned char *p = data;
+    const unsigned char *end = data + length;
+    uint64_t count;
+    if (!readVarint(p, end, count) || count > length) {
+        return false;
+    }
+    entries.resize(count);
+    uint64_t lastId = 0;
+    uint64_t value;
+    for (size_t i = 0;i < count;i++) {
+        if (!readVarint(p, end, value)) {
+            return false;
+        }
+        lastId += value;
+        entries[i].tileId = lastId;
+    }
+    for (size_t i = 0;i < count;i++) {
+        if (!readVarint(p, end, value)) {
+            return false;
+        }
+        entries[i].runLength = (uint32_t)value;
+    }
+    for (size_t i = 0;i < count;i++) {
+        if (!readVarint(p, end, value)) {
+            return false;
+        }
+        entries[i].length = (uint32_t)value;
+    }
+    for (size_t i = 0;i < count;i++) {
+        if (!readVarint(p, end, value)) {
+            return false;
+        }
+        if (value == 0 && i > 0) {
+            entries[i].offset = entries[i - 1].offset + entries[i - 1].length;
+        } else {
+            entries[i].offset = value - 1;
+        }
+    }
+    return true;
+}
+
+uint64_t PMTilesTileId(int tz, int tx, int ty) {
+    uint64_t acc = (((uint64_t)1 << (tz * 2)) - 1) / 3;
+    uint64_t x = (uint32_t)tx;
+    uint64_t y = (uint32_t)ty;
+    for (int a = tz - 1;a >= 0;a--) {
+        uint64_t s = (uint64_t)1 << a;
+        uint64_t rx = (x & s) ? 1 : 0;
+        uint64_t ry = (y & s) ? 1 : 0;
+        acc += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return acc;
+}
+
+// MARK: - PMTilesWriter
+PMTilesWriter::PMTilesWriter(const char *path) {
+    _path = path;
+    _tempPath = _path + ".tmp";
+    _tempFile = NULL;
+    _tempSize = 0;
+    _minZoom = 255;
+    _maxZoom = 0;
+}
+
+PMTilesWriter::~PMTilesWriter(void) {
+    if (_tempFile != NULL) {
+        VSIFCloseL(_tempFile);
+        VSIUnlink(_tempPath.c_str());
+    }
+}
+
+int PMTilesWriter::open(void) {
+    lock_guard<mutex> lock(_mutex);
+    _tempFile = VSIFOpenL(_tempPath.c_str(), "w+b");
+    if (_tempFile == NULL) {
+        printf("Open PMTiles temp file error: %s\n", _tempPath.c_str());
+        return 2;
+    }
+    _tempSize = 0;
+    _entries.clear();
+    _contents.clear();
+    return 0;
+}
+
+int PMTilesWriter::addTile(int tx, int ty, int tz, const vector<unsigned char> &data) {
+    if (data.empty() || tz < 0 || tz > 26) {
+        return 1;
+    }
+
+    PMTilesEntry entry;
+    entry.tileId = PMTilesTileId(tz, tx, ty);
+    entry.length = (uint32_t)data.size();
+    entry.runLength = 1;
+    uint64_t hash = TileHash(data.data(), data.size());
+
+    lock_guard<mutex> lock(_mutex);
+    if (_tempFile == NULL) {
+        return 2;
+    }
+    auto found = _contents.find(hash);
+    if (found != _contents.end() && found->second.length == entry.length) {
+        entry.offset = found->second.offset;
+    } else {
+        if (VSIFWriteL(data.data(), 1, data.size(), _tempFile) != data.size()) {
+            printf("Write PMTiles temp file error.\n");
+            return 2;
+        }
+        entry.offset = _tempSize;
+        _tempSize += data.size();
+        _contents[hash] = entry;
+    }
+    _entries.push_back(entry);
+    _minZoom = min(_minZoom, tz);
+    _maxZoom = max(_maxZoom, tz);
+    return 0;
+}
+
+size_t PMTilesWriter::count(void) {
+    lock_guard<mutex> lock(_mutex);
+    return _entries.size();
+}
+
+void PMTilesWriter::buildDirectories(const vector<PMTilesEntry> &entries, vector<unsigned char> &root, vector<unsigned char> &leaves) {
+    leaves.clear();
+    serializeDirectory(entries.data(), entries.size(), root);
+    if (root.size() <= PMTILES_ROOT_SIZE) {
+        return;
+    }
+
+    /// Root points to leaf directories, grow the leaves until the root fits
+    size_t leafSize = 4096;
+    while (true) {
+        leaves.clear();
+        vector<PMTilesEntry> rootEntries;
+        vector<unsigned char> leaf;
+        for (size_t i = 0;i < entries.size();i += leafSize) {
+            size_t count = min(leafSize, entries.size() - i);
+            serializeDirectory(entries.data() + i, count, leaf);
+            rootEntries.push_back({entries[i].tileId, (uint64_t)leaves.size(), (uint32_t)leaf.size(), 0});
+            leaves.insert(leaves.end(), leaf.begin(), leaf.end());
+        }
+        serializeDirectory(rootEntries.data(), rootEntries.size(), root);
+        if (root.size() <= PMTILES_ROOT_SIZE) {
+            return;
+        }
+        leafSize *= 2;
+    }
+}
+
+int PMTilesWriter::finish(const double *bounds, const char *metadata) {
+    lock_guard<mutex> lock(_mutex);
+    if (_tempFile == NULL) {
+        return 2;
+    }
+
+    /// Hilbert order, the last write of a tile wins
+    stable_sort(_entries.begin(), _entries.end(), [](const PMTilesEntry &a, const PMTilesEntry &b) {
+        return a.tileId < b.tileId;
+    });
+    vector<PMTilesEntry> sorted;
+    sorted.reserve(_entries.size());
+    for (const PMTilesEntry &entry : _entries) {
+        if (!sorted.empty() && sorted.back().tileId == entry.tileId) {
+            sorted.back() = entry;
+        } else {
+            sorted.push_back(entry);
+        }
+    }
+
+    /// Tile data in the order of first use, runs of identical tiles share one entry
+    unordered_map<uint64_t, uint64_t> dataOffsets;
+    vector<pair<uint64_t, uint32_t>> copies;
+    vector<PMTilesEntry> entries;
+    uint64_t dataLength = 0;
+    uint64_t addressed = 0;
+    for (const PMTilesEntry &entry : sorted) {
+        uint64_t offset;
+        auto found = dataOffsets.find(entry.offset);
+        if (found == dataOffsets.end()) {
+            offset = dataLength;
+            dataOffsets[entry.offset] = offset;
+            copies.push_back({entry.offset, entry.length});
+            dataLength += entry.length;
+        } else {
+            offset = found->second;
+        }
+        addressed++;
+
+        if (!entries.empty()) {
+            PMTilesEntry &last = entries.back();
+            if (last.offset == offset && last.tileId + last.runLength == entry.tileId) {
+                last.runLength++;
+                continue;
+            }
+        }
+        entries.push_back({entry.tileId, offset, entry.length, 1});
+    }
+
+    vector<unsigned char> root;
+    vector<unsigned char> leaves;
+    buildDirectories(entries, root, leaves);
+
+    const char *json = metadata == NULL ? "{}" : metadata;
+    vector<unsigned char> meta;
+    gzipData((const unsigned char *)json, strlen(json), meta);
+
+    unsigned char header[PMTILES_HEADER_SIZE] = {};
+    uint64_t rootOffset = PMTILES_HEADER_SIZE;
+    uint64_t metadataOffset = rootOffset + root.size();
+    uint64_t leafOffset = metadataOffset + meta.size();
+    uint64_t dataOffset = leafOffset + leaves.size();
+    memcpy(header, "PMTiles", 7);
+    header[7] = 3;
+    writeUInt(header + 8, rootOffset, 8);
+    writeUInt(header + 16, root.size(), 8);
+    writeUInt(header + 24, metadataOffset, 8);
+    writeUInt(header + 32, meta.size(), 8);
+    writeUInt(header + 40, leafOffset, 8);
+    writeUInt(header + 48, leaves.size(), 8);
+    writeUInt(header + 56, dataOffset, 8);
+    writeUInt(header + 64, dataLength, 8);
+    writeUInt(header + 72, addressed, 8);
+    writeUInt(header + 80, entries.size(), 8);
+    writeUInt(header + 88, copies.size(), 8);
+    header[96] = 1;
+    header[97] = 2;
+    header[98] = 1;
+    header[99] = 2;
+    header[100] = (unsigned char)(entries.empty() ? 0 : _minZoom);
+    header[101] = (unsigned char)(entries.empty() ? 0 : _maxZoom);
+    double w = bounds == NULL ? -180.0 : bounds[0];
+    double s = bounds == NULL ? -85.0511287 : bounds[1];
+    double e = bounds == NULL ? 180.0 : bounds[2];
+    double n = bounds == NULL ? 85.0511287 : bounds[3];
+    writeUInt(header + 102, (uint32_t)(int32_t)lround(w * 1e7), 4);
+    writeUInt(header + 106, (uint32_t)(int32_t)lround(s * 1e7), 4);
+    writeUInt(header + 110, (uint32_t)(int32_t)lround(e * 1e7), 4);
+    writeUInt(header + 114, (uint32_t)(int32_t)lround(n * 1e7), 4);
+    header[118] = header[100];
+    writeUInt(header + 119, (uint32_t)(int32_t)lround((w + e) / 2.0 * 1e7), 4);
+    writeUInt(header + 123, (uint32_t)(int32_t)lround((s + n) / 2.0 * 1e7), 4);
+
+    VSILFILE *file = VSIFOpenL(_path.c_str(), "wb");
+    if (file == NULL) {
+        printf("Open PMTiles file error: %s\n", _path.c_str());
+        return 2;
+    }
+    bool ok = VSIFWriteL(header, 1, PMTILES_HEADER_SIZE, file) == PMTILES_HEADER_SIZE;
+    ok = ok && VSIFWriteL(root.data(), 1, root.size(), file) == root.size();
+    ok = ok && VSIFWriteL(meta.data(), 1, meta.size(), file) == meta.size();
+    ok = ok && (leaves.empty() || VSIFWriteL(leaves.data(), 1, leaves.size(), file) == leaves.size());
+
+    vector<unsigned char> buffer;
+    for (size_t i = 0;ok && i < copies.size();i++) {
+        buffer.resize(copies[i].second);
+        ok = VSIFSeekL(_tempFile, copies[i].first, SEEK_SET) == 0 &&
+             VSIFReadL(buffer.data(), 1, buffer.size(), _tempFile) == buffer.size() &&
+             VSIFWriteL(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    }
+    ok = VSIFCloseL(file) == 0 && ok;
+    if (!ok) {
+        printf("Write PMTiles file error: %s\n", _path.c_str());
+        VSIUnlink(_path.c_str());
+        return 2;
+    }
+
+    VSIFCloseL(_tempFile);
+    _tempFile = NULL;
+    VSIUnlink(_tempPath.c_str());
+    return 0;
+}
+
+// MARK: - PMTilesReader
+PMTilesReader::PMTilesReader(const char *path) {
+    _path = path;
+    _fd = -1;
+    _map = NULL;
+    _mapSize = 0;
+    memset(&_header, 0, sizeof(_header));
+}
+
+PMTilesReader::~PMTilesReader(void) {
+    close();
+}
+
+void PMTilesReader::close(void) {
+    lock_guard<mutex> lock(_mutex);
+    if (_map != NULL) {
+        munmap((void *)_map, _mapSize);
+        _map = NULL;
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    _mapSize = 0;
+    _root.clear();
+    _leaves.clear();
+    _leafOrder.clear();
+}
+
+int PMTilesReader::open(void) {
+    close();
+
+    int fd = ::open(_path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < PMTILES_HEADER_SIZE) {
+        printf("Open PMTiles file error: %s\n", _path.c_str());
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return 2;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        printf("Map PMTiles file error: %s\n", _path.c_str());
+        ::close(fd);
+        return 2;
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    _fd = fd;
+    _map = (const unsigned char *)map;
+    _mapSize = (size_t)st.st_size;
+
+    const unsigned char *h = _map;
+    if (memcmp(h, "PMTiles", 7) != 0 || h[7] != 3) {
+        printf("Not a PMTiles v3 file: %s\n", _path.c_str());
+        return 3;
+    }
+    _header.rootOffset = readUInt(h + 8, 8);
+    _header.rootLength = readUInt(h + 16, 8);
+    _header.metadataOffset = readUInt(h + 24, 8);
+    _header.metadataLength = readUInt(h + 32, 8);
+    _header.leafOffset = readUInt(h + 40, 8);
+    _header.leafLength = readUInt(h + 48, 8);
+    _header.dataOffset = readUInt(h + 56, 8);
+    _header.dataLength = readUInt(h + 64, 8);
+    _header.addressedTiles = readUInt(h + 72, 8);
+    _header.tileEntries = readUInt(h + 80, 8);
+    _header.tileContents = readUInt(h + 88, 8);
+    _header.clustered = h[96] == 1;
+    _header.internalCompression = h[97];
+    _header.tileCompression = h[98];
+    _header.tileType = h[99];
+    _header.minZoom = h[100];
+    _header.maxZoom = h[101];
+    for (int i = 0;i < 4;i++) {
+        _header.bounds[i] = (int32_t)readUInt(h + 102 + i * 4, 4) / 1e7;
+    }
+    _header.centerZoom = h[118];
+    _header.centerLon = (int32_t)readUInt(h + 119, 4) / 1e7;
+    _header.centerLat = (int32_t)readUInt(h + 123, 4) / 1e7;
+
+    if (!readDirectory(_header.rootOffset, _header.rootLength, _root)) {
+        printf("Read PMTiles root directory error: %s\n", _path.c_str());
+        return 3;
+    }
+    return 0;
+}
+
+const PMTilesHeader &PMTilesReader::header(void) {
+    return _header;
+}
+
+bool PMTilesReader::readDirectory(uint64_t offset, uint64_t length, vector<PMTilesEntry> &entries) {
+    if (offset + length > _mapSize) {
+        return false;
+    }
+    const unsigned char *data = _map + offset;
+    if (_header.internalCompression == 2) {
+        vector<unsigned char> raw;
+        return gunzipData(data, length, raw) && deserializeDirectory(raw.data(), raw.size(), entries);
+    }
+    return deserializeDirectory(data, length, entries);
+}
+
+PMTilesReader::Directory PMTilesReader::leafDirectory(uint64_t offset, uint64_t length) {
+    auto found = _leaves.find(offset);
+    if (found != _leaves.end()) {
+        _leafOrder.splice(_leafOrder.begin(), _leafOrder, found->second.second);
+        return found->second.first;
+    }
+
+    shared_ptr<vector<PMTilesEntry>> entries = make_shared<vector<PMTilesEntry>>();
+    if (!readDirectory(_header.leafOffset + offset, length, *entries)) {
+        return NULL;
+    }
+    _leafOrder.push_front(offset);
+    _leaves[offset] = {entries, _leafOrder.begin()};
+    if (_leaves.size() > PMTILES_LEAF_CACHE) {
+        _leaves.erase(_leafOrder.back());
+        _leafOrder.pop_back();
+    }
+    return entries;
+}
+
+bool PMTilesReader::findTile(uint64_t tileId, PMTilesEntry &entry) {
+    lock_guard<mutex> lock(_mutex);
+    if (_map == NULL) {
+        return false;
+    }
+
+    Directory directory(&_root, [](const vector<PMTilesEntry> *) {});
+    /// root -> leaf -> leaf...
+    for (int depth = 0;depth < 4 && directory != NULL;depth++) {
+        auto it = upper_bound(directory->begin(), directory->end(), tileId, [](uint64_t id, const PMTilesEntry &e) {
+            return id < e.tileId;
+        });
+        if (it == directory->begin()) {
+            return false;
+        }
+        const PMTilesEntry &found = *(it - 1);
+        if (found.runLength > 0) {
+            if (tileId >= found.tileId + found.runLength) {
+                return false;
+            }
+            entry = found;
+            return true;
+        }
+        directory = leafDirectory(found.offset, found.length);
+    }
+    return false;
+}
+
+bool PMTilesReader::getTile(int tx, int ty, int tz, const unsigned char **data, size_t *length) {
+    if (tz < 0 || tz > 26) {
+        return false;
+    }
+    PMTilesEntry entry;
+    if (!findTile(PMTilesTileId(tz, tx, ty), entry)) {
+        return false;
+    }
+    uint64_t offset = _header.dataOffset + entry.offset;
+    if (offset + entry.length > _mapSize) {
+        return false;
+    }
+    *data = _map + offset;
+    *length = entry.length;
+    return true;
+}
+
+bool PMTilesReader::readTile(int tx, int ty, int tz, vector<unsigned char> &data) {
+    const unsigned char *bytes;
+    size_t length;
+    if (!getTile(tx, ty, tz, &bytes, &length)) {
+        return false;
+    }
+    data.assign(bytes, bytes + length);
+    return true;
+}
+
+bool PMTilesReader::containsTile(int tx, int ty, int tz) {
+    PMTilesEntry entry;
+    return tz >= 0 && tz <= 26 && findTile(PMTilesTileId(tz, tx, ty), entry);
+}
@@ -0,0 +1,149 @@
+//
+//  PMTiles.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef PMTiles_hpp
+#define PMTiles_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "cpl_vsi.h"
+
+#define PMTILES_HEADER_SIZE 127
+/// Root directory must fit into the first 16KB together with the header
+#define PMTILES_ROOT_SIZE (16384 - PMTILES_HEADER_SIZE)
+#define PMTILES_LEAF_CACHE 64
+
+using namespace std;
+
+/// PMTiles v3 directory entry, runLength 0 points to a leaf directory
+struct PMTilesEntry {
+    uint64_t tileId;
+    uint64_t offset;
+    uint32_t length;
+    uint32_t runLength;
+};
+
+struct PMTilesHeader {
+    uint64_t rootOffset;
+    uint64_t rootLength;
+    uint64_t metadataOffset;
+    uint64_t metadataLength;
+    uint64_t leafOffset;
+    uint64_t leafLength;
+    uint64_t dataOffset;
+    uint64_t dataLength;
+    uint64_t addressedTiles;
+    uint64_t tileEntries;
+    uint64_t tileContents;
+    bool clustered;
+    /// 1 - none, 2 - gzip
+    int internalCompression;
+    int tileCompression;
+    /// 2 - png
+    int tileType;
+    int minZoom;
+    int maxZoom;
+    /// west, south, east, north
+    double bounds[4];
+    int centerZoom;
+    double centerLon;
+    double centerLat;
+};
+
+/// Hilbert tile id of a Google XYZ tile
+uint64_t PMTilesTileId(int tz, int tx, int ty);
+
+/// Writes a clustered PMTiles v3 archive.
+/// Tiles can be added in any order, they are spooled into `path.tmp` and copied in
+/// Hilbert order by finish(). Identical tiles are stored once.
+class PMTilesWriter {
+private:
+    string _path;
+    string _tempPath;
+    VSILFILE *_tempFile;
+    uint64_t _tempSize;
+
+    /// offset of an entry points into the temp file until finish()
+    vector<PMTilesEntry> _entries;
+    /// TileHash -> entry with the same content
+    unordered_map<uint64_t, PMTilesEntry> _contents;
+
+    int _minZoom;
+    int _maxZoom;
+
+    mutex _mutex;
+
+    void buildDirectories(const vector<PMTilesEntry> &entries, vector<unsigned char> &root, vector<unsigned char> &leaves);
+public:
+    PMTilesWriter(const char *path);
+    ~PMTilesWriter(void);
+
+    /// 0 - 成功, 2 - 写入错误
+    int open(void);
+
+    /// Google XYZ
+    int addTile(int tx, int ty, int tz, const vector<unsigned char> &data);
+
+    /// Writes the archive and removes the temp file
+    /// - Parameters:
+    ///   - bounds: west, south, east, north
+    ///   - metadata: JSON, NULL - {}
+    int finish(const double *bounds, const char *metadata);
+
+    /// Number of tiles added
+    size_t count(void);
+};
+
+/// Reads a PMTiles v3 archive through mmap.
+/// getTile returns a pointer into the mapping, the root directory and the recently used
+/// leaf directories are kept decoded.
+class PMTilesReader {
+private:
+    string _path;
+    int _fd;
+    const unsigned char *_map;
+    size_t _mapSize;
+
+    PMTilesHeader _header;
+    vector<PMTilesEntry> _root;
+
+    typedef shared_ptr<const vector<PMTilesEntry>> Directory;
+    list<uint64_t> _leafOrder;
+    unordered_map<uint64_t, pair<Directory, list<uint64_t>::iterator>> _leaves;
+    mutex _mutex;
+
+    bool readDirectory(uint64_t offset, uint64_t length, vector<PMTilesEntry> &entries);
+
+    Directory leafDirectory(uint64_t offset, uint64_t length);
+
+    bool findTile(uint64_t tileId, PMTilesEntry &entry);
+public:
+    PMTilesReader(const char *path);
+    ~PMTilesReader(void);
+
+    /// 0 - 成功, 2 - 文件错误, 3 - 不是PMTiles v3
+    int open(void);
+
+    void close(void);
+
+    const PMTilesHeader &header(void);
+
+    /// Zero copy, data stays valid until close()
+    bool getTile(int tx, int ty, int tz, const unsigned char **data, size_t *length);
+
+    bool readTile(int tx, int ty, int tz, vector<unsigned char> &data);
+
+    bool containsTile(int tx, int ty, int tz);
+};
+#endif /* PMTiles_hpp */
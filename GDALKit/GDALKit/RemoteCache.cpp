@@ -0,0 +1,523 @@
+//
+//  RemoteCache.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "RemoteCache.hpp"
+#include "TileHash.hpp"
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_vsi.h"
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+
+static mutex sharedMutex;
+static shared_ptr<RemoteCache> sharedCache;
+
+RemoteCache::RemoteCache(const char *path, int64_t maxBytes, int chunkSize)
+: chunkSize(max(4096, chunkSize)) {
+    _path = path;
+    _db = NULL;
+    _selectStmt = NULL;
+    _insertStmt = NULL;
+    _touchStmt = NULL;
+    _lengthStmt = NULL;
+    _bytes = 0;
+    _maxBytes = maxBytes;
+    _clock = 0;
+    prefetchBytes = 256 * 1024;
+}
+
+RemoteCache::~RemoteCache(void) {
+    close();
+}
+
+int RemoteCache::exec(const char *sql) {
+    char *errmsg = NULL;
+    if (sqlite3_exec(_db, sql, NULL, NULL, &errmsg) != SQLITE_OK) {
+        printf("Remote cache error: %s (%s)\n", errmsg == NULL ? "" : errmsg, sql);
+        sqlite3_free(errmsg);
+        return 2;
+    }
+    return 0;
+}
+
+void RemoteCache::flushTouches(void) {
+    for (const pair<const pair<uint64_t, int64_t>, int64_t> &touch : _touches) {
+        sqlite3_bind_int64(_touchStmt, 1, touch.second);
+        sqlite3_bind_int64(_touchStmt, 2, int64_t(touch.first.first));
+        sqlite3_bind_int64(_touchStmt, 3, touch.first.second);
+        sqlite3_step(_touchStmt);
+        sqlite3_reset(_touchStmt);
+    }
+    _touches.clear();
+}
+
+void RemoteCache::close(void) {
+    if (_touchStmt != NULL && !_touches.empty() && exec("BEGIN") == 0) {
+        flushTouches();
+        exec("COMMIT");
+    }
+    _touches.clear();
+    sqlite3_finalize(_selectStmt);
+    sqlite3_finalize(_insertStmt);
+    sqlite3_finalize(_touchStmt);
+    sqlite3_finalize(_lengthStmt);
+    _selectStmt = NULL;
+    _insertStmt = NULL;
+    _touchStmt = NULL;
+    _lengthStmt = NULL;
+    sqlite3_close(_db);
+    _db = NULL;
+}
+
+int RemoteCache::open(void) {
+    lock_guard<mutex> lock(_mutex);
+    close();
+    if (sqlite3_open_v2(_path.c_str(), &_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+        printf("Open remote cache error: %s\n", _path.c_str());
+        close();
+        return 2;
+    }
+    if (exec("PRAGMA journal_mode = WAL") != 0 ||
+        exec("PRAGMA synchronous = NORMAL") != 0 ||
+        exec("CREATE TABLE IF NOT EXISTS chunks (file INTEGER NOT NULL, chunk INTEGER NOT NULL, data BLOB NOT NULL, used INTEGER NOT NULL, PRIMARY KEY (file, chunk))") != 0 ||
+        exec("CREATE INDEX IF NOT EXISTS chunks_used ON chunks (used)") != 0) {
+        close();
+        return 2;
+    }
+
+    /// user_version holds the chunk size, the chunks of another size can not be used
+    sqlite3_stmt *stmt = NULL;
+    int version = 0;
+    if (sqlite3_prepare_v2(_db, "PRAGMA user_version", -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    if (version != chunkSize) {
+        if (exec("DELETE FROM chunks") != 0 || exec(CPLSPrintf("PRAGMA user_version = %d", chunkSize)) != 0) {
+            close();
+            return 2;
+        }
+    }
+
+    _bytes = 0;
+    _clock = 0;
+    if (sqlite3_prepare_v2(_db, "SELECT total(length(data)), max(used) FROM chunks", -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        _bytes = sqlite3_column_int64(stmt, 0);
+        _clock = sqlite3_column_int64(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_prepare_v2(_db, "SELECT data FROM chunks WHERE file = ? AND chunk = ?", -1, &_selectStmt, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(_db, "INSERT OR REPLACE INTO chunks (file, chunk, data, used) VALUES (?, ?, ?, ?)", -1, &_insertStmt, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(_db, "UPDATE chunks SET used = ? WHERE file = ? AND chunk = ?", -1, &_touchStmt, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(_db, "SELECT length(data) FROM chunks WHERE file = ? AND chunk = ?", -1, &_lengthStmt, NULL) != SQLITE_OK) {
+        printf("Remote cache error: %s\n", sqlite3_errmsg(_db));
+        close();
+        return 2;
+    }
+    return 0;
+}
+
+bool RemoteCache::get(uint64_t file, int64_t chunk, vector<unsigned char> &data) {
+    lock_guard<mutex> lock(_mutex);
+    if (_selectStmt == NULL) {
+        return false;
+    }
+    bool found = false;
+    sqlite3_bind_int64(_selectStmt, 1, int64_t(file));
+    sqlite3_bind_int64(_selectStmt, 2, chunk);
+    if (sqlite3_step(_selectStmt) == SQLITE_ROW) {
+        const unsigned char *blob = (const unsigned char *)sqlite3_column_blob(_selectStmt, 0);
+        data.assign(blob, blob + sqlite3_column_bytes(_selectStmt, 0));
+        found = true;
+    }
+    sqlite3_reset(_selectStmt);
+    if (found) {
+        /// Written with the next put, a read is no write transaction
+        _touches[make_pair(file, chunk)] = ++_clock;
+        if (_touches.size() >= REMOTE_CACHE_TOUCHES && exec("BEGIN") == 0) {
+            flushTouches();
+            exec("COMMIT");
+        }
+    }
+    return found;
+}
+
+int RemoteCache::put(uint64_t file, const vector<pair<int64_t, vector<unsigned char>>> &chunks) {
+    lock_guard<mutex> lock(_mutex);
+    if (_insertStmt == NULL || exec("BEGIN") != 0) {
+        return 2;
+    }
+    /// Before the inserts, a chunk read and then replaced keeps its new used value
+    flushTouches();
+    int result = 0;
+    /// Applied once committed, a replaced chunk counts with its new size only
+    int64_t added = 0;
+    for (const pair<int64_t, vector<unsigned char>> &chunk : chunks) {
+        int64_t previous = 0;
+        sqlite3_bind_int64(_lengthStmt, 1, int64_t(file));
+        sqlite3_bind_int64(_lengthStmt, 2, chunk.first);
+        if (sqlite3_step(_lengthStmt) == SQLITE_ROW) {
+            previous = sqlite3_column_int64(_lengthStmt, 0);
+        }
+        sqlite3_reset(_lengthStmt);
+        
+        sqlite3_bind_int64(_insertStmt, 1, int64_t(file));
+        sqlite3_bind_int64(_insertStmt, 2, chunk.first);
+        sqlite3_bind_blob(_insertStmt, 3, chunk.second.data(), int(chunk.second.size()), SQLITE_STATIC);
+        sqlite3_bind_int64(_insertStmt, 4, ++_clock);
+        if (sqlite3_step(_insertStmt) != SQLITE_DONE) {
+            result = 2;
+        } else {
+            added += int64_t(chunk.second.size()) - previous;
+        }
+        sqlite3_reset(_insertStmt);
+    }
+    if (exec(result == 0 ? "COMMIT" : "ROLLBACK") != 0) {
+        result = 2;
+    }
+    if (result == 0) {
+        _bytes += added;
+    }
+    if (_maxBytes > 0 && _bytes > _maxBytes) {
+        evict();
+    }
+    return result;
+}
+
+void RemoteCache::evict(void) {
+    /// Down to 90%, so not every put evicts
+    int64_t excess = _bytes - _maxBytes * 9 / 10;
+    int64_t count = excess / chunkSize + 1;
+    if (exec(CPLSPrintf("DELETE FROM chunks WHERE rowid IN (SELECT rowid FROM chunks ORDER BY used LIMIT %lld)", (long long)count)) != 0) {
+        return;
+    }
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(_db, "SELECT total(length(data)) FROM chunks", -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        _bytes = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+}
+
+int64_t RemoteCache::bytes(void) {
+    lock_guard<mutex> lock(_mutex);
+    return _bytes;
+}
+
+int RemoteCache::clear(void) {
+    lock_guard<mutex> lock(_mutex);
+    if (_db == NULL || exec("DELETE FROM chunks") != 0) {
+        return 2;
+    }
+    _touches.clear();
+    _bytes = 0;
+    return 0;
+}
+
+// MARK: - /vsigkcache/
+
+typedef shared_ptr<vector<unsigned char>> RemoteChunk;
+
+struct RemoteFile {
+    shared_ptr<RemoteCache> cache;
+    VSILFILE *fp;
+    uint64_t key;
+    vsi_l_offset size;
+    vsi_l_offset offset;
+    bool eof;
+    /// Last REMOTE_FILE_CHUNKS chunks used by this handle, most recent first. A handle is used by one thread at a time
+    list<pair<int64_t, RemoteChunk>> recent;
+};
+
+static string remotePath(const char *pszFilename) {
+    return string("/vsicurl/") + (pszFilename + strlen(REMOTE_CACHE_PREFIX));
+}
+
+static RemoteChunk recentChunk(RemoteFile *file, int64_t chunk) {
+    for (list<pair<int64_t, RemoteChunk>>::iterator it = file->recent.begin();it != file->recent.end();++it) {
+        if (it->first == chunk) {
+            file->recent.splice(file->recent.begin(), file->recent, it);
+            return it->second;
+        }
+    }
+    return NULL;
+}
+
+static void keepChunk(RemoteFile *file, int64_t chunk, const RemoteChunk &data) {
+    file->recent.push_front(make_pair(chunk, data));
+    if (file->recent.size() > REMOTE_FILE_CHUNKS) {
+        file->recent.pop_back();
+    }
+}
+
+/// Fills chunks (index → data) from the handle, then the cache, the missing ones with one multi-range read
+static int fetchChunks(RemoteFile *file, map<int64_t, RemoteChunk> &chunks) {
+    vector<int64_t> missing;
+    for (map<int64_t, RemoteChunk>::iterator it = chunks.begin();it != chunks.end();++it) {
+        it->second = recentChunk(file, it->first);
+        if (it->second != NULL) {
+            continue;
+        }
+        RemoteChunk data = make_shared<vector<unsigned char>>();
+        if (file->cache->get(file->key, it->first, *data)) {
+            it->second = data;
+            keepChunk(file, it->first, data);
+        } else {
+            missing.push_back(it->first);
+        }
+    }
+    if (missing.empty()) {
+        return 0;
+    }
+
+    /// Consecutive chunks become one range
+    int64_t chunkSize = file->cache->chunkSize;
+    vector<pair<int64_t, int64_t>> runs;
+    for (int64_t chunk : missing) {
+        if (!runs.empty() && runs.back().second + 1 == chunk) {
+            runs.back().second = chunk;
+        } else {
+            runs.push_back(make_pair(chunk, chunk));
+        }
+    }
+    vector<vector<unsigned char>> buffers(runs.size());
+    vector<void *> data(runs.size());
+    vector<vsi_l_offset> offsets(runs.size());
+    vector<size_t> sizes(runs.size());
+    for (size_t i = 0;i < runs.size();i++) {
+        offsets[i] = vsi_l_offset(runs[i].first * chunkSize);
+        vsi_l_offset end = min(file->size, vsi_l_offset((runs[i].second + 1) * chunkSize));
+        sizes[i] = size_t(end - offsets[i]);
+        buffers[i].resize(sizes[i]);
+        data[i] = buffers[i].data();
+    }
+    if (VSIFReadMultiRangeL(int(runs.size()), data.data(), offsets.data(), sizes.data(), file->fp) != 0) {
+        printf("Read remote ranges error.\n");
+        return -1;
+    }
+
+    vector<pair<int64_t, vector<unsigned char>>> fetched;
+    for (size_t i = 0;i < runs.size();i++) {
+        for (int64_t chunk = runs[i].first;chunk <= runs[i].second;chunk++) {
+            size_t begin = size_t((chunk - runs[i].first) * chunkSize);
+            size_t end = min(buffers[i].size(), begin + size_t(chunkSize));
+            RemoteChunk target = make_shared<vector<unsigned char>>(buffers[i].begin() + begin, buffers[i].begin() + end);
+            chunks[chunk] = target;
+            keepChunk(file, chunk, target);
+            fetched.push_back(make_pair(chunk, *target));
+        }
+    }
+    file->cache->put(file->key, fetched);
+    return 0;
+}
+
+static int readRanges(RemoteFile *file, int nRanges, void **ppData, const vsi_l_offset *panOffsets, const size_t *panSizes) {
+    int64_t chunkSize = file->cache->chunkSize;
+    map<int64_t, RemoteChunk> chunks;
+    for (int i = 0;i < nRanges;i++) {
+        if (panSizes[i] == 0) {
+            continue;
+        }
+        for (int64_t chunk = int64_t(panOffsets[i]) / chunkSize;chunk <= int64_t(panOffsets[i] + panSizes[i] - 1) / chunkSize;chunk++) {
+            chunks[chunk];
+        }
+    }
+    if (fetchChunks(file, chunks) != 0) {
+        return -1;
+    }
+
+    for (int i = 0;i < nRanges;i++) {
+        unsigned char *dst = (unsigned char *)ppData[i];
+        vsi_l_offset offset = panOffsets[i];
+        size_t remaining = panSizes[i];
+        while (remaining > 0) {
+            const vector<unsigned char> &data = *chunks[int64_t(offset) / chunkSize];
+            size_t begin = size_t(offset % chunkSize);
+            if (begin >= data.size()) {
+                /// Past the end of the file
+                return -1;
+            }
+            size_t length = min(remaining, data.size() - begin);
+            memcpy(dst, data.data() + begin, length);
+            dst += length;
+            offset += length;
+            remaining -= length;
+        }
+    }
+    return 0;
+}
+
+static int remoteStat(void *, const char *pszFilename, VSIStatBufL *pStatBuf, int nFlags) {
+    return VSIStatExL(remotePath(pszFilename).c_str(), pStatBuf, nFlags);
+}
+
+static char **remoteSiblingFiles(void *, const char *) {
+    /// No probing for .ovr / .aux.xml / .msk over HTTP
+    return (char **)CPLCalloc(1, sizeof(char *));
+}
+
+static void *remoteOpen(void *, const char *pszFilename, const char *pszAccess) {
+    if (strchr(pszAccess, 'w') != NULL || strchr(pszAccess, 'a') != NULL || strchr(pszAccess, '+') != NULL) {
+        errno = EACCES;
+        return NULL;
+    }
+    shared_ptr<RemoteCache> cache;
+    {
+        lock_guard<mutex> lock(sharedMutex);
+        cache = sharedCache;
+    }
+    string path = remotePath(pszFilename);
+    VSIStatBufL sStat;
+    if (cache == NULL || VSIStatL(path.c_str(), &sStat) != 0) {
+        errno = ENOENT;
+        return NULL;
+    }
+    VSILFILE *fp = VSIFOpenL(path.c_str(), "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    RemoteFile *file = new RemoteFile();
+    file->cache = cache;
+    file->fp = fp;
+    file->size = vsi_l_offset(sStat.st_size);
+    file->offset = 0;
+    file->eof = false;
+    uint64_t values[3] = {TileHash(path.data(), path.size()), uint64_t(sStat.st_size), uint64_t(sStat.st_mtime)};
+    file->key = TileHash(values, sizeof(values));
+
+    /// The header and IFDs in one request, later opens find them in the cache
+    int64_t chunkSize = cache->chunkSize;
+    int64_t prefetch = min<int64_t>(int64_t(file->size), cache->prefetchBytes);
+    map<int64_t, RemoteChunk> chunks;
+    for (int64_t chunk = 0;chunk * chunkSize < prefetch;chunk++) {
+        chunks[chunk];
+    }
+    fetchChunks(file, chunks);
+    return file;
+}
+
+static vsi_l_offset remoteTell(void *pFile) {
+    return ((RemoteFile *)pFile)->offset;
+}
+
+static int remoteSeek(void *pFile, vsi_l_offset nOffset, int nWhence) {
+    RemoteFile *file = (RemoteFile *)pFile;
+    if (nWhence == SEEK_SET) {
+        file->offset = nOffset;
+    } else if (nWhence == SEEK_CUR) {
+        file->offset += nOffset;
+    } else if (nWhence == SEEK_END) {
+        file->offset = file->size + nOffset;
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+    file->eof = false;
+    return 0;
+}
+
+static size_t remoteRead(void *pFile, void *pBuffer, size_t nSize, size_t nCount) {
+    RemoteFile *file = (RemoteFile *)pFile;
+    size_t bytes = nSize * nCount;
+    if (bytes == 0) {
+        return 0;
+    }
+    if (file->offset >= file->size) {
+        file->eof = true;
+        return 0;
+    }
+    size_t available = size_t(min<vsi_l_offset>(bytes, file->size - file->offset));
+    void *data = pBuffer;
+    if (readRanges(file, 1, &data, &file->offset, &available) != 0) {
+        return 0;
+    }
+    file->offset += available;
+    if (available < bytes) {
+        file->eof = true;
+    }
+    return available / nSize;
+}
+
+static int remoteReadMultiRange(void *pFile, int nRanges, void **ppData, const vsi_l_offset *panOffsets, const size_t *panSizes) {
+    RemoteFile *file = (RemoteFile *)pFile;
+    for (int i = 0;i < nRanges;i++) {
+        if (panOffsets[i] + panSizes[i] > file->size) {
+            return -1;
+        }
+    }
+    return readRanges(file, nRanges, ppData, panOffsets, panSizes);
+}
+
+static int remoteEof(void *pFile) {
+    return ((RemoteFile *)pFile)->eof ? 1 : 0;
+}
+
+static int remoteClose(void *pFile) {
+    RemoteFile *file = (RemoteFile *)pFile;
+    VSIFCloseL(file->fp);
+    delete file;
+    return 0;
+}
+
+int RemoteCache::install(const char *path, int64_t maxBytes, int chunkSize) {
+    shared_ptr<RemoteCache> cache = make_shared<RemoteCache>(path, maxBytes, chunkSize);
+    if (cache->open() != 0) {
+        return 2;
+    }
+
+    lock_guard<mutex> lock(sharedMutex);
+    if (sharedCache == NULL) {
+        /// Adjacent ranges in one request, several requests over one HTTP/2 connection
+        if (CPLGetConfigOption("GDAL_HTTP_MERGE_CONSECUTIVE_RANGES", NULL) == NULL) {
+            CPLSetConfigOption("GDAL_HTTP_MERGE_CONSECUTIVE_RANGES", "YES");
+        }
+        if (CPLGetConfigOption("GDAL_HTTP_MULTIPLEX", NULL) == NULL) {
+            CPLSetConfigOption("GDAL_HTTP_MULTIPLEX", "YES");
+        }
+        VSIFilesystemPluginCallbacksStruct *callbacks = VSIAllocFilesystemPluginCallbacksStruct();
+        callbacks->stat = remoteStat;
+        callbacks->sibling_files = remoteSiblingFiles;
+        callbacks->open = remoteOpen;
+        callbacks->tell = remoteTell;
+        callbacks->seek = remoteSeek;
+        callbacks->read = remoteRead;
+        callbacks->read_multi_range = remoteReadMultiRange;
+        callbacks->eof = remoteEof;
+        callbacks->close = remoteClose;
+        int result = VSIInstallPluginHandler(REMOTE_CACHE_PREFIX, callbacks);
+        VSIFreeFilesystemPluginCallbacksStruct(callbacks);
+        if (result != 0) {
+            printf("Install %s error.\n", REMOTE_CACHE_PREFIX);
+            return 2;
+        }
+    }
+    /// Open handles keep the previous cache until they are closed
+    sharedCache = cache;
+    return 0;
+}
+
+RemoteCache *RemoteCache::shared(void) {
+    lock_guard<mutex> lock(sharedMutex);
+    return sharedCache.get();
+}
+
+string RemoteCachePath(const char *path) {
+    if (path == NULL) {
+        return "";
+    }
+    if (!STARTS_WITH_CI(path, "http://") && !STARTS_WITH_CI(path, "https://")) {
+        return path;
+    }
+    return string(RemoteCache::shared() != NULL ? REMOTE_CACHE_PREFIX : "/vsicurl/") + path;
+}
@@ -0,0 +1,101 @@
+//
+//  RemoteCache.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef RemoteCache_hpp
+#define RemoteCache_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sqlite3.h"
+
+/// Remote files read through the cache: /vsigkcache/https://host/file.tif
+#define REMOTE_CACHE_PREFIX "/vsigkcache/"
+
+/// Chunks each open /vsigkcache/ handle keeps in memory, libtiff's small reads of the same chunk stay out of SQLite
+#define REMOTE_FILE_CHUNKS 8
+
+/// Chunk reads remembered before their used column is written without a put
+#define REMOTE_CACHE_TOUCHES 1024
+
+using namespace std;
+
+/// Fixed size chunks of remote files kept in one SQLite file, so they survive restarts.
+/// A file is keyed by its URL, size and modification time: a changed remote file gets new chunks,
+/// the old ones age out. Least recently used chunks are evicted beyond maxBytes.
+///
+/// install() registers the /vsigkcache/ file system in front of /vsicurl/. Every read, and every
+/// multi-range read of GTiff (all blocks of one RasterIO window), first takes the chunks it finds in
+/// the cache, the missing ones are merged into runs and fetched in one VSIFReadMultiRangeL, which
+/// /vsicurl sends as parallel / merged range requests. The first chunks of a file (the IFDs of a COG)
+/// are fetched together when it is opened. Reads only remember which chunks they used, the used
+/// column is written with the next put (or every REMOTE_CACHE_TOUCHES reads), not once per read.
+class RemoteCache {
+private:
+    string _path;
+    sqlite3 *_db;
+    sqlite3_stmt *_selectStmt;
+    sqlite3_stmt *_insertStmt;
+    sqlite3_stmt *_touchStmt;
+    sqlite3_stmt *_lengthStmt;
+    mutex _mutex;
+
+    int64_t _bytes;
+    int64_t _maxBytes;
+    /// Access counter, the used column of a chunk
+    int64_t _clock;
+    /// (file, chunk) -> used, read since the last write
+    map<pair<uint64_t, int64_t>, int64_t> _touches;
+
+    int exec(const char *sql);
+
+    /// Writes _touches, inside the caller's transaction
+    void flushTouches(void);
+
+    void evict(void);
+
+    void close(void);
+public:
+    /// - Parameters:
+    ///   - chunkSize: bytes per chunk, a cache file created with another chunk size is cleared
+    RemoteCache(const char *path, int64_t maxBytes, int chunkSize = 65536);
+    ~RemoteCache(void);
+
+    const int chunkSize;
+
+    /// Bytes of the IFD region fetched when a file is opened, default 256KB
+    int prefetchBytes;
+
+    /// 打开或创建文件, 0 - 成功, 2 - 错误
+    int open(void);
+
+    bool get(uint64_t file, int64_t chunk, vector<unsigned char> &data);
+
+    /// Chunks of one fetch in one transaction
+    int put(uint64_t file, const vector<pair<int64_t, vector<unsigned char>>> &chunks);
+
+    int64_t bytes(void);
+
+    int clear(void);
+
+    /// Opens the cache file and makes it the one /vsigkcache/ reads through, the file system is
+    /// registered on the first call. Calling it again replaces the cache (e.g. another file)
+    /// 0 - 成功, 2 - 缓存文件错误
+    static int install(const char *path, int64_t maxBytes, int chunkSize = 65536);
+
+    /// NULL before install
+    static RemoteCache *shared(void);
+};
+
+/// http(s):// URLs as GDAL paths: through /vsigkcache/ once installed, /vsicurl/ otherwise. Other paths are returned as is
+string RemoteCachePath(const char *path);
+#endif /* RemoteCache_hpp */
@@ -0,0 +1,306 @@
+//
+//  SeedJournal.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "SeedJournal.hpp"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#define JOURNAL_MAGIC "GKSJ"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 16
+/// z(1) + start(8) + count(4)
+#define JOURNAL_RECORD_SIZE 13
+
+static uint64_t spreadBits(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+    return x;
+}
+
+uint64_t MortonCode(int tx, int ty) {
+    return spreadBits((uint32_t)tx) | (spreadBits((uint32_t)ty) << 1);
+}
+
+static bool writeAll(int fd, const unsigned char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= size_t(written);
+    }
+    return true;
+}
+
+static void encodeRecord(unsigned char *p, int tz, uint64_t start, uint32_t count) {
+    p[0] = (unsigned char)tz;
+    for (int i = 0;i < 8;i++) {
+        p[1 + i] = (unsigned char)(start >> (i * 8));
+    }
+    for (int i = 0;i < 4;i++) {
+        p[9 + i] = (unsigned char)(count >> (i * 8));
+    }
+}
+
+SeedJournal::SeedJournal(const char *path) {
+    _path = path;
+    _fd = -1;
+    _fingerprint = 0;
+    _pendingCount = 0;
+    _records = 0;
+    flushTiles = 256;
+    flushInterval = 1.0;
+}
+
+SeedJournal::~SeedJournal(void) {
+    close();
+}
+
+void SeedJournal::insert(int tz, uint64_t start, uint64_t end) {
+    map<uint64_t, uint64_t> &done = _done[tz];
+    /// Merge with the run before and all runs overlapping / touching [start, end]
+    auto it = done.upper_bound(start);
+    if (it != done.begin()) {
+        auto previous = prev(it);
+        if (previous->second + 1 >= start) {
+            start = previous->first;
+            end = max(end, previous->second);
+            it = done.erase(previous);
+        }
+    }
+    while (it != done.end() && it->first <= end + 1) {
+        end = max(end, it->second);
+        it = done.erase(it);
+    }
+    done[start] = end;
+}
+
+bool SeedJournal::containsLocked(int tz, uint64_t start, uint64_t end) {
+    if (tz < 0 || tz >= MAXZOOMLEVEL) {
+        return false;
+    }
+    map<uint64_t, uint64_t> &done = _done[tz];
+    auto it = done.upper_bound(start);
+    if (it == done.begin()) {
+        return false;
+    }
+    --it;
+    return it->second >= end;
+}
+
+int SeedJournal::open(uint64_t fingerprint) {
+    lock_guard<mutex> lock(_mutex);
+    _fingerprint = fingerprint;
+    for (int tz = 0;tz < MAXZOOMLEVEL;tz++) {
+        _done[tz].clear();
+        _pending[tz].clear();
+    }
+    _pendingCount = 0;
+    _records = 0;
+    _lastFlush = chrono::steady_clock::now();
+
+    /// Existing runs, a torn record at the end is ignored
+    FILE *fp = fopen(_path.c_str(), "rb");
+    bool valid = false;
+    off_t length = JOURNAL_HEADER_SIZE;
+    if (fp != NULL) {
+        unsigned char header[JOURNAL_HEADER_SIZE];
+        if (fread(header, 1, JOURNAL_HEADER_SIZE, fp) == JOURNAL_HEADER_SIZE && memcmp(header, JOURNAL_MAGIC, 4) == 0 && header[4] == JOURNAL_VERSION) {
+            uint64_t stored = 0;
+            memcpy(&stored, header + 8, 8);
+            valid = stored == fingerprint;
+        }
+        unsigned char record[JOURNAL_RECORD_SIZE];
+        while (valid && fread(record, 1, JOURNAL_RECORD_SIZE, fp) == JOURNAL_RECORD_SIZE) {
+            int tz = record[0];
+            uint64_t start = 0;
+            uint32_t count = 0;
+            for (int i = 0;i < 8;i++) {
+                start |= uint64_t(record[1 + i]) << (i * 8);
+            }
+            for (int i = 0;i < 4;i++) {
+                count |= uint32_t(record[9 + i]) << (i * 8);
+            }
+            if (tz < MAXZOOMLEVEL && count > 0) {
+                insert(tz, start, start + count - 1);
+                _records++;
+            }
+            length += JOURNAL_RECORD_SIZE;
+        }
+        fclose(fp);
+        if (!valid) {
+            printf("Seed journal belongs to another file, start over\n");
+        }
+    }
+
+    if (valid) {
+        /// Appends continue after the last whole record
+        truncate(_path.c_str(), length);
+        return compact();
+    }
+
+    _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        printf("Open seed journal error: %s\n", _path.c_str());
+        return 2;
+    }
+    unsigned char header[JOURNAL_HEADER_SIZE] = {0};
+    memcpy(header, JOURNAL_MAGIC, 4);
+    header[4] = JOURNAL_VERSION;
+    memcpy(header + 8, &fingerprint, 8);
+    if (!writeAll(_fd, header, JOURNAL_HEADER_SIZE) || fsync(_fd) != 0) {
+        printf("Write seed journal error: %s\n", _path.c_str());
+        return 2;
+    }
+    return 0;
+}
+
+int SeedJournal::compact(void) {
+    /// Rewrite the merged runs when appends have fragmented the file, then keep appending
+    size_t runs = 0;
+    for (int tz = 0;tz < MAXZOOMLEVEL;tz++) {
+        runs += _done[tz].size();
+    }
+    if (_records <= runs * 2) {
+        _fd = ::open(_path.c_str(), O_WRONLY | O_APPEND);
+        return _fd < 0 ? 2 : 0;
+    }
+
+    vector<unsigned char> data(JOURNAL_HEADER_SIZE, 0);
+    memcpy(data.data(), JOURNAL_MAGIC, 4);
+    data[4] = JOURNAL_VERSION;
+    memcpy(data.data() + 8, &_fingerprint, 8);
+    _records = 0;
+    for (int tz = 0;tz < MAXZOOMLEVEL;tz++) {
+        for (auto &run : _done[tz]) {
+            for (uint64_t start = run.first;start <= run.second;start += 0xffffffffULL) {
+                unsigned char record[JOURNAL_RECORD_SIZE];
+                encodeRecord(record, tz, start, uint32_t(min(run.second - start + 1, uint64_t(0xffffffffULL))));
+                data.insert(data.end(), record, record + JOURNAL_RECORD_SIZE);
+                _records++;
+                if (run.second - start < 0xffffffffULL) {
+                    break;
+                }
+            }
+        }
+    }
+
+    string tempPath = _path + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || !writeAll(fd, data.data(), data.size()) || fsync(fd) != 0 || ::close(fd) != 0 || rename(tempPath.c_str(), _path.c_str()) != 0) {
+        printf("Compact seed journal error: %s\n", _path.c_str());
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        unlink(tempPath.c_str());
+    }
+    _fd = ::open(_path.c_str(), O_WRONLY | O_APPEND);
+    return _fd < 0 ? 2 : 0;
+}
+
+bool SeedJournal::contains(int tx, int ty, int tz) {
+    uint64_t code = MortonCode(tx, ty);
+    lock_guard<mutex> lock(_mutex);
+    return containsLocked(tz, code, code);
+}
+
+bool SeedJournal::containsRange(int tz, uint64_t start, uint64_t end) {
+    lock_guard<mutex> lock(_mutex);
+    return containsLocked(tz, start, end);
+}
+
+void SeedJournal::add(int tx, int ty, int tz) {
+    if (tz < 0 || tz >= MAXZOOMLEVEL) {
+        return;
+    }
+    uint64_t code = MortonCode(tx, ty);
+    lock_guard<mutex> lock(_mutex);
+    _pending[tz].push_back(code);
+    _pendingCount++;
+    if (_pendingCount >= flushTiles ||
+        chrono::duration<double>(chrono::steady_clock::now() - _lastFlush).count() >= flushInterval) {
+        flushLocked();
+    }
+}
+
+int SeedJournal::flushLocked(void) {
+    _lastFlush = chrono::steady_clock::now();
+    if (_pendingCount == 0) {
+        return 0;
+    }
+
+    /// Buffered tiles as runs of consecutive Morton codes
+    vector<unsigned char> data;
+    for (int tz = 0;tz < MAXZOOMLEVEL;tz++) {
+        vector<uint64_t> &codes = _pending[tz];
+        if (codes.empty()) {
+            continue;
+        }
+        sort(codes.begin(), codes.end());
+        codes.erase(unique(codes.begin(), codes.end()), codes.end());
+        size_t i = 0;
+        while (i < codes.size()) {
+            size_t j = i;
+            while (j + 1 < codes.size() && codes[j + 1] == codes[j] + 1 && j + 1 - i < 0xffffffffULL) {
+                j++;
+            }
+            unsigned char record[JOURNAL_RECORD_SIZE];
+            encodeRecord(record, tz, codes[i], uint32_t(j - i + 1));
+            data.insert(data.end(), record, record + JOURNAL_RECORD_SIZE);
+            insert(tz, codes[i], codes[j]);
+            _records++;
+            i = j + 1;
+        }
+        codes.clear();
+    }
+    _pendingCount = 0;
+
+    if (_fd < 0 || !writeAll(_fd, data.data(), data.size()) || fsync(_fd) != 0) {
+        printf("Write seed journal error: %s\n", _path.c_str());
+        return 2;
+    }
+    return 0;
+}
+
+int SeedJournal::flush(void) {
+    lock_guard<mutex> lock(_mutex);
+    return flushLocked();
+}
+
+void SeedJournal::close(void) {
+    lock_guard<mutex> lock(_mutex);
+    flushLocked();
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+void SeedJournal::remove(void) {
+    close();
+    unlink(_path.c_str());
+}
+
+uint64_t SeedJournal::count(void) {
+    lock_guard<mutex> lock(_mutex);
+    uint64_t count = 0;
+    for (int tz = 0;tz < MAXZOOMLEVEL;tz++) {
+        for (auto &run : _done[tz]) {
+            count += run.second - run.first + 1;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,86 @@
+//
+//  SeedJournal.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef SeedJournal_hpp
+#define SeedJournal_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef MAXZOOMLEVEL
+#define MAXZOOMLEVEL 32
+#endif
+
+using namespace std;
+
+/// Interleaves the bits of x (even) and y (odd)
+uint64_t MortonCode(int tx, int ty);
+
+/// Append-only journal of the tiles a seed has completed, as Morton code runs per zoom.
+/// A restarted seed skips journaled tiles (and whole journaled subtrees) without touching the store.
+/// Completed tiles are buffered and appended + fsync'ed in batches, a crash loses at most one batch.
+class SeedJournal {
+private:
+    string _path;
+    int _fd;
+    uint64_t _fingerprint;
+
+    /// start -> end (inclusive), merged
+    map<uint64_t, uint64_t> _done[MAXZOOMLEVEL];
+    vector<uint64_t> _pending[MAXZOOMLEVEL];
+    size_t _pendingCount;
+    size_t _records;
+    chrono::steady_clock::time_point _lastFlush;
+
+    mutex _mutex;
+
+    void insert(int tz, uint64_t start, uint64_t end);
+
+    bool containsLocked(int tz, uint64_t start, uint64_t end);
+
+    int flushLocked(void);
+
+    int compact(void);
+public:
+    SeedJournal(const char *path);
+    ~SeedJournal(void);
+
+    /// Tiles buffered before an append, default 256
+    size_t flushTiles;
+
+    /// Seconds between appends, default 1
+    double flushInterval;
+
+    /// Reads the journal, a journal written for another fingerprint is discarded
+    /// 0 - 成功, 2 - 文件错误
+    int open(uint64_t fingerprint);
+
+    bool contains(int tx, int ty, int tz);
+
+    /// All tiles of the Morton range start ~ end are journaled
+    bool containsRange(int tz, uint64_t start, uint64_t end);
+
+    void add(int tx, int ty, int tz);
+
+    /// Appends the buffered tiles and fsyncs
+    int flush(void);
+
+    /// Flush and close
+    void close(void);
+
+    /// Close and delete the file, when the seed has finished
+    void remove(void);
+
+    /// Journaled tiles
+    uint64_t count(void);
+};
+#endif /* SeedJournal_hpp */
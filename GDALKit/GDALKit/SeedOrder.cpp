@@ -0,0 +1,91 @@
+//
+//  SeedOrder.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "SeedOrder.hpp"
+
+#include <stdint.h>
+#include <algorithm>
+
+/// Quadrants (x + 2y) in visiting order and the orientation of each, per orientation
+static const int HilbertQuadrants[4][4] = {
+    {0, 2, 3, 1},
+    {0, 1, 3, 2},
+    {3, 1, 0, 2},
+    {3, 2, 0, 1},
+};
+
+static const int HilbertStates[4][4] = {
+    {1, 0, 0, 3},
+    {0, 1, 1, 2},
+    {3, 2, 2, 1},
+    {2, 3, 3, 0},
+};
+
+int SeedOrderChild(int order, int state, int i, int *dx, int *dy) {
+    if (order != SEED_ORDER_HILBERT) {
+        *dx = i & 1;
+        *dy = i >> 1;
+        return 0;
+    }
+    int quadrant = HilbertQuadrants[state][i];
+    *dx = quadrant & 1;
+    *dy = quadrant >> 1;
+    return HilbertStates[state][i];
+}
+
+static bool visitCurve(int order, int tx, int ty, int t, int state, int tz, const int *range, function<bool(int, int)> &visit) {
+    int d = tz - t;
+    if ((int64_t(tx + 1) << d) <= range[0] || (int64_t(tx) << d) > range[2] ||
+        (int64_t(ty + 1) << d) <= range[1] || (int64_t(ty) << d) > range[3]) {
+        return true;
+    }
+    if (t == tz) {
+        return visit(tx, ty);
+    }
+    for (int i = 0;i < 4;i++) {
+        int dx, dy;
+        int child = SeedOrderChild(order, state, i, &dx, &dy);
+        if (!visitCurve(order, tx * 2 + dx, ty * 2 + dy, t + 1, child, tz, range, visit)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SeedOrderTiles(int order, int tz, const int *range, int stripRows, function<bool(int tx, int ty)> visit) {
+    if (range[0] > range[2] || range[1] > range[3]) {
+        return;
+    }
+    switch (order) {
+        case SEED_ORDER_ROW:
+            for (int ty = range[1];ty <= range[3];ty++) {
+                for (int tx = range[0];tx <= range[2];tx++) {
+                    if (!visit(tx, ty)) {
+                        return;
+                    }
+                }
+            }
+            break;
+        case SEED_ORDER_BLOCK_ROW:
+            /// Down each column of the strip, the blocks of the previous column are still cached
+            stripRows = max(1, stripRows);
+            for (int top = range[1];top <= range[3];top += stripRows) {
+                int bottom = min(range[3], top + stripRows - 1);
+                for (int tx = range[0];tx <= range[2];tx++) {
+                    for (int ty = top;ty <= bottom;ty++) {
+                        if (!visit(tx, ty)) {
+                            return;
+                        }
+                    }
+                }
+            }
+            break;
+        default:
+            visitCurve(order, 0, 0, 0, 0, tz, range, visit);
+            break;
+    }
+}
@@ -0,0 +1,32 @@
+//
+//  SeedOrder.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef SeedOrder_hpp
+#define SeedOrder_hpp
+
+#include <stdio.h>
+#include <functional>
+
+/// Z curve from the root, the children of a parent are rendered together
+#define SEED_ORDER_MORTON 0
+/// Hilbert curve from the root, consecutive tiles are always neighbours
+#define SEED_ORDER_HILBERT 1
+/// Row by row
+#define SEED_ORDER_ROW 2
+/// Strips of rows, swept column by column, the strip height follows the block cache
+#define SEED_ORDER_BLOCK_ROW 3
+
+using namespace std;
+
+/// The i-th (0 ~ 3) child of a tile in curve order is (2tx + dx, 2ty + dy).
+/// state - Hilbert orientation of the parent (0 at the root), returns the orientation of the child
+int SeedOrderChild(int order, int state, int i, int *dx, int *dy);
+
+/// Visits the tiles of range (minx, miny, maxx, maxy) at level tz in seed order until visit returns false
+/// - Parameter stripRows: tile rows of one SEED_ORDER_BLOCK_ROW strip
+void SeedOrderTiles(int order, int tz, const int *range, int stripRows, function<bool(int tx, int ty)> visit);
+#endif /* SeedOrder_hpp */
@@ -0,0 +1,127 @@
+//
+//  TileCache.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "TileCache.hpp"
+
+TileCache::TileCache(size_t capacity) {
+    _capacity = capacity;
+    _hits = 0;
+    _misses = 0;
+    _evictions = 0;
+    for (Shard &shard : _shards) {
+        shard.bytes = 0;
+    }
+}
+
+TileCache::~TileCache(void) {
+    
+}
+
+TileCache::Shard &TileCache::shardFor(const TileCacheKey &key) {
+    return _shards[(TileCacheKeyHash()(key) >> 7) % TILECACHE_SHARDS];
+}
+
+void TileCache::evict(Shard &shard, size_t capacity) {
+    while (shard.bytes > capacity && !shard.entries.empty()) {
+        Entry &entry = shard.entries.back();
+        shard.bytes -= entry.data->size();
+        shard.index.erase(entry.key);
+        shard.entries.pop_back();
+        _evictions++;
+    }
+}
+
+bool TileCache::get(const TileCacheKey &key, TileData &data) {
+    Shard &shard = shardFor(key);
+    lock_guard<mutex> lock(shard.lock);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        _misses++;
+        return false;
+    }
+    
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    data = it->second->data;
+    _hits++;
+    return true;
+}
+
+bool TileCache::contains(const TileCacheKey &key) {
+    Shard &shard = shardFor(key);
+    lock_guard<mutex> lock(shard.lock);
+    return shard.index.find(key) != shard.index.end();
+}
+
+void TileCache::put(const TileCacheKey &key, TileData data) {
+    if (!data) {
+        return;
+    }
+    
+    if (data->size() > _capacity.load() / TILECACHE_SHARDS) {
+        return;
+    }
+    
+    Shard &shard = shardFor(key);
+    lock_guard<mutex> lock(shard.lock);
+    /// Read again under the lock, a concurrent setCapacity evicts this shard after it stores the new capacity
+    size_t shardCapacity = _capacity.load() / TILECACHE_SHARDS;
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.bytes -= it->second->data->size();
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+    }
+    
+    shard.entries.push_front({key, data});
+    shard.index[key] = shard.entries.begin();
+    shard.bytes += data->size();
+    evict(shard, shardCapacity);
+}
+
+void TileCache::erase(const TileCacheKey &key) {
+    Shard &shard = shardFor(key);
+    lock_guard<mutex> lock(shard.lock);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.bytes -= it->second->data->size();
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+void TileCache::clear(void) {
+    for (Shard &shard : _shards) {
+        lock_guard<mutex> lock(shard.lock);
+        shard.entries.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+void TileCache::setCapacity(size_t capacity) {
+    _capacity.store(capacity);
+    for (Shard &shard : _shards) {
+        lock_guard<mutex> lock(shard.lock);
+        evict(shard, _capacity.load() / TILECACHE_SHARDS);
+    }
+}
+
+TileCacheStats TileCache::stats(void) {
+    TileCacheStats stats;
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.evictions = _evictions;
+    stats.entries = 0;
+    stats.bytes = 0;
+    stats.capacity = _capacity.load();
+    for (Shard &shard : _shards) {
+        lock_guard<mutex> lock(shard.lock);
+        stats.entries += shard.index.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
@@ -0,0 +1,102 @@
+//
+//  TileCache.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef TileCache_hpp
+#define TileCache_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define TILECACHE_SHARDS 16
+
+using namespace std;
+
+/// Tile + the render parameters it was produced with
+struct TileCacheKey {
+    uint64_t tile;
+    uint64_t params;
+    
+    bool operator==(const TileCacheKey &other) const {
+        return tile == other.tile && params == other.params;
+    }
+};
+
+struct TileCacheKeyHash {
+    size_t operator()(const TileCacheKey &key) const {
+        uint64_t h = key.tile * 0x9E3779B97F4A7C15ULL ^ (key.params + 0x632BE59BD9B4E019ULL + (key.tile << 6));
+        return size_t(h ^ (h >> 29));
+    }
+};
+
+struct TileCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t entries;
+    uint64_t bytes;
+    uint64_t capacity;
+};
+
+typedef shared_ptr<const vector<unsigned char>> TileData;
+
+/// Thread-safe LRU cache of encoded tiles, bounded in bytes.
+/// Keys are spread over TILECACHE_SHARDS independently locked shards, each one
+/// owns 1/TILECACHE_SHARDS of the byte budget.
+class TileCache {
+private:
+    struct Entry {
+        TileCacheKey key;
+        TileData data;
+    };
+    
+    struct Shard {
+        mutex lock;
+        /// front - most recently used
+        list<Entry> entries;
+        unordered_map<TileCacheKey, list<Entry>::iterator, TileCacheKeyHash> index;
+        size_t bytes;
+    };
+    
+    Shard _shards[TILECACHE_SHARDS];
+    /// setCapacity may run while other threads put
+    atomic<size_t> _capacity;
+    
+    atomic<uint64_t> _hits;
+    atomic<uint64_t> _misses;
+    atomic<uint64_t> _evictions;
+    
+    Shard &shardFor(const TileCacheKey &key);
+    
+    void evict(Shard &shard, size_t capacity);
+public:
+    /// - Parameter capacity: 最大字节数
+    TileCache(size_t capacity = 64 * 1024 * 1024);
+    ~TileCache(void);
+    
+    bool get(const TileCacheKey &key, TileData &data);
+    
+    /// 不更新LRU顺序和命中计数
+    bool contains(const TileCacheKey &key);
+    
+    /// 大于单个分片容量的Tile不缓存
+    void put(const TileCacheKey &key, TileData data);
+    
+    void erase(const TileCacheKey &key);
+    
+    void clear(void);
+    
+    void setCapacity(size_t capacity);
+    
+    TileCacheStats stats(void);
+};
+#endif /* TileCache_hpp */
@@ -0,0 +1,264 @@
+//
+//  TileComposer.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "TileComposer.hpp"
+
+#include <string.h>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static inline void reducePixel(const unsigned char *p, const unsigned char *q, int bands, int resampling, unsigned char *o) {
+    int alpha = bands - 1;
+    const unsigned char *pixels[4] = {p, p + bands, q, q + bands};
+    if (resampling == TILE_RESAMPLING_NEAREST) {
+        const unsigned char *source = pixels[0];
+        for (int i = 1;i < 4 && source[alpha] == 0;i++) {
+            source = pixels[i];
+        }
+        memcpy(o, source, bands);
+        return;
+    }
+
+    int a0 = p[alpha];
+    int a1 = p[bands + alpha];
+    int a2 = q[alpha];
+    int a3 = q[bands + alpha];
+    int sum = a0 + a1 + a2 + a3;
+    if (sum == 0) {
+        memset(o, 0, bands);
+        return;
+    }
+    for (int c = 0;c < alpha;c++) {
+        o[c] = (unsigned char)((p[c] * a0 + p[bands + c] * a1 + q[c] * a2 + q[bands + c] * a3 + sum / 2) / sum);
+    }
+    o[alpha] = (unsigned char)((sum + 2) >> 2);
+}
+
+void ReduceRow2x2(const unsigned char *row0, const unsigned char *row1, int width, int bands, int resampling, unsigned char *output) {
+    int x = 0;
+    if (bands == 4 && resampling == TILE_RESAMPLING_AVERAGE) {
+#if defined(__SSE2__)
+        /// 4 input pixels -> 2 output pixels, opaque chunks only: (sum + 2) >> 2 equals the alpha weighted average
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+        const __m128i two = _mm_set1_epi16(2);
+        for (;x + 4 <= width;x += 4) {
+            __m128i r0 = _mm_loadu_si128((const __m128i *)(row0 + x * 4));
+            __m128i r1 = _mm_loadu_si128((const __m128i *)(row1 + x * 4));
+            __m128i opaque = _mm_cmpeq_epi32(_mm_and_si128(_mm_and_si128(r0, r1), alphaMask), alphaMask);
+            if (_mm_movemask_epi8(opaque) != 0xffff) {
+                reducePixel(row0 + x * 4, row1 + x * 4, 4, resampling, output + x * 2);
+                reducePixel(row0 + x * 4 + 8, row1 + x * 4 + 8, 4, resampling, output + x * 2 + 4);
+                continue;
+            }
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero));
+            __m128i sum = _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+            _mm_storel_epi64((__m128i *)(output + x * 2), _mm_packus_epi16(sum, sum));
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        /// 16 input pixels -> 8 output pixels, deinterleaved by vld4q
+        for (;x + 16 <= width;x += 16) {
+            uint8x16x4_t r0 = vld4q_u8(row0 + x * 4);
+            uint8x16x4_t r1 = vld4q_u8(row1 + x * 4);
+            if (vminvq_u8(vandq_u8(r0.val[3], r1.val[3])) != 255) {
+                for (int i = 0;i < 16;i += 2) {
+                    reducePixel(row0 + (x + i) * 4, row1 + (x + i) * 4, 4, resampling, output + (x + i) * 2);
+                }
+                continue;
+            }
+            uint8x8x4_t out;
+            for (int c = 0;c < 4;c++) {
+                uint16x8_t lo = vaddl_u8(vget_low_u8(r0.val[c]), vget_low_u8(r1.val[c]));
+                uint16x8_t hi = vaddl_u8(vget_high_u8(r0.val[c]), vget_high_u8(r1.val[c]));
+                out.val[c] = vrshrn_n_u16(vpaddq_u16(lo, hi), 2);
+            }
+            vst4_u8(output + x * 2, out);
+        }
+#endif
+    }
+
+    for (;x + 2 <= width;x += 2) {
+        reducePixel(row0 + x * bands, row1 + x * bands, bands, resampling, output + (x / 2) * bands);
+    }
+}
+
+bool ComposeTile(const TileBuffer *children[4], int resampling, TileBuffer &parent) {
+    const TileBuffer *first = NULL;
+    for (int i = 0;i < 4;i++) {
+        if (children[i] != NULL && first == NULL) {
+            first = children[i];
+        }
+    }
+    if (first == NULL) {
+        return false;
+    }
+
+    int size = first->size;
+    int bands = first->bands;
+    int half = size / 2;
+    size_t rowBytes = size_t(size) * bands;
+    parent.size = size;
+    parent.bands = bands;
+    parent.pixels.assign(rowBytes * size, 0);
+    for (int i = 0;i < 4;i++) {
+        const TileBuffer *child = children[i];
+        if (child == NULL || child->size != size || child->bands != bands) {
+            continue;
+        }
+        /// (i & 1) - right half, (i >> 1) - bottom half
+        unsigned char *quadrant = parent.pixels.data() + size_t((i >> 1) * half) * rowBytes + size_t((i & 1) * half) * bands;
+        for (int y = 0;y < half;y++) {
+            const unsigned char *row0 = child->pixels.data() + size_t(y * 2) * rowBytes;
+            ReduceRow2x2(row0, row0 + rowBytes, size, bands, resampling, quadrant + size_t(y) * rowBytes);
+        }
+    }
+    return true;
+}
+
+TileComposer::TileComposer(GDAL2Mercator *mercator, TilePipeline *pipeline, TileStore *store, TileIndex *index, int minz, int resampling) {
+    _mercator = mercator;
+    _pipeline = pipeline;
+    _store = store;
+    _index = index;
+    _minz = minz;
+    _resampling = resampling;
+    _failed = 0;
+    skipExisting = true;
+}
+
+int TileComposer::childCount(int tx, int ty, int tz) {
+    int range[4];
+    if (!_mercator->tileRange(tz + 1, range)) {
+        return 0;
+    }
+    int count = 0;
+    for (int i = 0;i < 4;i++) {
+        int cx = tx * 2 + (i & 1);
+        int cy = ty * 2 + (i >> 1);
+        if (cx >= range[0] && cx <= range[2] && cy >= range[1] && cy <= range[3]) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void TileComposer::add(int tx, int ty, int tz, shared_ptr<TileBuffer> buffer) {
+    while (tz > _minz) {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        int px = tx >> 1;
+        int py = ty >> 1;
+        int pz = tz - 1;
+        uint64_t key = TileKey(px, py, pz);
+
+        Node node;
+        {
+            lock_guard<mutex> lock(_mutex);
+            auto found = _nodes.find(key);
+            if (found == _nodes.end()) {
+                found = _nodes.emplace(key, Node()).first;
+                found->second.expected = childCount(px, py, pz);
+                found->second.received = 0;
+            }
+            Node &pending = found->second;
+            pending.children[(tx & 1) + (ty & 1) * 2] = buffer;
+            pending.received++;
+            if (pending.received < pending.expected) {
+                return;
+            }
+            node = std::move(pending);
+            _nodes.erase(found);
+        }
+
+        const TileBuffer *children[4];
+        for (int i = 0;i < 4;i++) {
+            children[i] = node.children[i].get();
+        }
+        shared_ptr<TileBuffer> parent = make_shared<TileBuffer>();
+        parent->tx = px;
+        parent->ty = py;
+        parent->tz = pz;
+        if (!ComposeTile(children, _resampling, *parent)) {
+            parent = NULL;
+        }
+
+        TileResult result;
+        result.tx = px;
+        result.ty = py;
+        result.tz = pz;
+        result.status = 0;
+        result.skipped = false;
+        if (parent == NULL) {
+            /// 没有数据的Tile不保存
+            result.skipped = true;
+        } else if (skipExisting && (_index != NULL ? _index->contains(px, py, pz) : _store->containsTile(px, py, pz))) {
+            result.skipped = true;
+        } else {
+            /// Encoded by the pipeline's encoders, written in the writer's batch
+            TileJob job;
+            job.tx = px;
+            job.ty = py;
+            job.tz = pz;
+            job.priority = TILE_PRIORITY_PREFETCH;
+            job.skipExisting = false;
+            job.keepBuffer = true;
+            job.cancelled = cancelled;
+            job.params = 0;
+            job.buffer = parent;
+            job.callback = [this](const TileResult &result) {
+                written(result);
+            };
+            if (_pipeline->submit(job)) {
+                return;
+            }
+            result.status = TILE_STATUS_CANCELLED;
+            result.elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+            if (callback) {
+                callback(result);
+            }
+            return;
+        }
+        result.elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        if (callback) {
+            callback(result);
+        }
+
+        tx = px;
+        ty = py;
+        tz = pz;
+        buffer = parent;
+    }
+}
+
+void TileComposer::written(const TileResult &result) {
+    if (result.status != 0 && result.status != TILE_STATUS_CANCELLED) {
+        _failed++;
+    }
+    if (callback) {
+        callback(result);
+    }
+    /// A cancelled parent leaves its own parent incomplete
+    if (result.status == TILE_STATUS_CANCELLED) {
+        return;
+    }
+    add(result.tx, result.ty, result.tz, result.buffer);
+}
+
+int TileComposer::failed(void) {
+    return _failed;
+}
+
+size_t TileComposer::pending(void) {
+    lock_guard<mutex> lock(_mutex);
+    return _nodes.size();
+}
@@ -0,0 +1,84 @@
+//
+//  TileComposer.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef TileComposer_hpp
+#define TileComposer_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "GDAL2Mercator.hpp"
+#include "TilePipeline.hpp"
+#include "TileStore.hpp"
+
+using namespace std;
+
+/// 2x2 reduction of one row pair into `width / 2` pixels, alpha is the last band.
+/// Average weights the colors by alpha so transparent pixels don't bleed in, nearest takes the first visible pixel.
+/// RGBA rows of opaque pixels go through SSE2 / NEON.
+void ReduceRow2x2(const unsigned char *row0, const unsigned char *row1, int width, int bands, int resampling, unsigned char *output);
+
+/// Builds a parent tile from its children (2x, 2y), (2x + 1, 2y), (2x, 2y + 1), (2x + 1, 2y + 1).
+/// Missing children (NULL) stay transparent. Returns false when all children are missing.
+bool ComposeTile(const TileBuffer *children[4], int resampling, TileBuffer &parent);
+
+/// Bottom-up overview seeding (gdal2tiles' generate_overview_tiles).
+/// Children are kept in memory until all children of their parent have arrived, then the parent is
+/// composed and submitted to the pipeline's encode and write stages. Once written it is handed on to
+/// its own parent. Feed it the base tiles in Morton order to keep only a few partially filled parents alive.
+class TileComposer {
+private:
+    struct Node {
+        shared_ptr<TileBuffer> children[4];
+        int expected;
+        int received;
+    };
+
+    GDAL2Mercator *_mercator;
+    TilePipeline *_pipeline;
+    TileStore *_store;
+    TileIndex *_index;
+    int _minz;
+    int _resampling;
+
+    unordered_map<uint64_t, Node> _nodes;
+    mutex _mutex;
+
+    atomic<int> _failed;
+
+    int childCount(int tx, int ty, int tz);
+
+    /// Completion of a parent submitted to the pipeline
+    void written(const TileResult &result);
+public:
+    /// pipeline writes to store, index may be NULL
+    TileComposer(GDAL2Mercator *mercator, TilePipeline *pipeline, TileStore *store, TileIndex *index, int minz, int resampling);
+
+    /// Tiles already in the store are not written again
+    bool skipExisting;
+
+    /// Token of the submitted parents
+    shared_ptr<atomic<bool>> cancelled;
+
+    /// Called for every parent tile: on the pipeline's writer thread once it is written,
+    /// in the thread which delivered its last child when it is skipped
+    function<void(const TileResult &result)> callback;
+
+    /// A tile is ready. buffer NULL - the tile has no data
+    void add(int tx, int ty, int tz, shared_ptr<TileBuffer> buffer);
+
+    /// Parents which could not be written
+    int failed(void);
+
+    /// Parents waiting for children
+    size_t pending(void);
+};
+#endif /* TileComposer_hpp */
@@ -0,0 +1,245 @@
+//
+//  TileCover.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "TileCover.hpp"
+
+#include "gdal.h"
+#include "ogr_srs_api.h"
+
+#include <ctype.h>
+#include <algorithm>
+
+/// Latitude limit of EPSG:3857
+#define MERCATOR_MAX_LATITUDE 85.0511287798066
+
+static OGRGeometryH rectangle(double minx, double miny, double maxx, double maxy) {
+    OGRGeometryH ring = OGR_G_CreateGeometry(wkbLinearRing);
+    OGR_G_AddPoint_2D(ring, minx, miny);
+    OGR_G_AddPoint_2D(ring, maxx, miny);
+    OGR_G_AddPoint_2D(ring, maxx, maxy);
+    OGR_G_AddPoint_2D(ring, minx, maxy);
+    OGR_G_AddPoint_2D(ring, minx, miny);
+    OGRGeometryH polygon = OGR_G_CreateGeometry(wkbPolygon);
+    OGR_G_AddGeometryDirectly(polygon, ring);
+    return polygon;
+}
+
+static OGRSpatialReferenceH spatialReference(int epsg) {
+    OGRSpatialReferenceH srs = OSRNewSpatialReference(NULL);
+    OSRImportFromEPSG(srs, epsg);
+    OSRSetAxisMappingStrategy(srs, OAMS_TRADITIONAL_GIS_ORDER);
+    return srs;
+}
+
+TileCover::TileCover(int tile_size) {
+    _mercator = new GlobalMercator(tile_size);
+    _geometry = NULL;
+}
+
+TileCover::~TileCover(void) {
+    reset();
+    delete _mercator;
+}
+
+void TileCover::reset(void) {
+    if (_geometry != NULL) {
+        OGR_G_DestroyGeometry(_geometry);
+        _geometry = NULL;
+    }
+}
+
+bool TileCover::isEmpty(void) {
+    return _geometry == NULL;
+}
+
+OGRGeometryH TileCover::geometry(void) {
+    return _geometry;
+}
+
+int TileCover::setGeometry(OGRGeometryH geometry, OGRSpatialReferenceH srs) {
+    /// source srs -> WGS84, clipped to the latitudes of EPSG:3857 -> EPSG:3857
+    OGRSpatialReferenceH wgs84 = spatialReference(4326);
+    OGRSpatialReferenceH webMercator = spatialReference(3857);
+    OGRSpatialReferenceH source = srs != NULL ? OSRClone(srs) : OSRClone(wgs84);
+    OSRSetAxisMappingStrategy(source, OAMS_TRADITIONAL_GIS_ORDER);
+
+    OGRGeometryH area = NULL;
+    OGRCoordinateTransformationH toWGS84 = OCTNewCoordinateTransformation(source, wgs84);
+    OGRCoordinateTransformationH toMercator = OCTNewCoordinateTransformation(wgs84, webMercator);
+    if (toWGS84 != NULL && toMercator != NULL && OGR_G_Transform(geometry, toWGS84) == OGRERR_NONE) {
+        if (!OGR_G_IsValid(geometry)) {
+            OGRGeometryH valid = OGR_G_MakeValid(geometry);
+            if (valid != NULL) {
+                OGR_G_DestroyGeometry(geometry);
+                geometry = valid;
+            }
+        }
+        OGRGeometryH world = rectangle(-180.0, -MERCATOR_MAX_LATITUDE, 180.0, MERCATOR_MAX_LATITUDE);
+        area = OGR_G_Intersection(geometry, world);
+        OGR_G_DestroyGeometry(world);
+        if (area != NULL && (OGR_G_IsEmpty(area) || OGR_G_Transform(area, toMercator) != OGRERR_NONE)) {
+            OGR_G_DestroyGeometry(area);
+            area = NULL;
+        }
+    }
+    OGR_G_DestroyGeometry(geometry);
+    if (toWGS84 != NULL) {
+        OCTDestroyCoordinateTransformation(toWGS84);
+    }
+    if (toMercator != NULL) {
+        OCTDestroyCoordinateTransformation(toMercator);
+    }
+    OSRDestroySpatialReference(source);
+    OSRDestroySpatialReference(webMercator);
+    OSRDestroySpatialReference(wgs84);
+
+    if (area == NULL) {
+        printf("Area of interest is empty or can not be transformed\n");
+        return 1;
+    }
+    /// Overlapping features merged, so a tile inside two of them is still inside
+    OGRGeometryH merged = OGR_G_UnaryUnion(area);
+    if (merged != NULL) {
+        OGR_G_DestroyGeometry(area);
+        area = merged;
+    }
+    reset();
+    _geometry = area;
+    return 0;
+}
+
+int TileCover::load(const char *source, const char *layer, const char *where) {
+    if (source == NULL) {
+        return 1;
+    }
+    const char *text = source;
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    if (*text == '\0') {
+        return 1;
+    }
+
+    /// A bare geometry, GeoJSON Features / FeatureCollections are read by the GeoJSON driver below
+    OGRGeometryH geometry = NULL;
+    if (*text == '{') {
+        geometry = OGR_G_CreateGeometryFromJson(text);
+    } else {
+        char *wkt = (char *)text;
+        if (OGR_G_CreateFromWkt(&wkt, NULL, &geometry) != OGRERR_NONE) {
+            geometry = NULL;
+        }
+    }
+    if (geometry != NULL) {
+        return setGeometry(geometry, NULL);
+    }
+
+    GDALDatasetH hDS = GDALOpenEx(source, GDAL_OF_VECTOR | GDAL_OF_READONLY, NULL, NULL, NULL);
+    if (hDS == NULL) {
+        printf("Open area of interest error: %s\n", *text == '{' ? "GeoJSON" : source);
+        return 4;
+    }
+    OGRLayerH hLayer = layer != NULL ? GDALDatasetGetLayerByName(hDS, layer) : GDALDatasetGetLayer(hDS, 0);
+    if (hLayer == NULL || (where != NULL && OGR_L_SetAttributeFilter(hLayer, where) != OGRERR_NONE)) {
+        GDALClose(hDS);
+        return 1;
+    }
+
+    geometry = OGR_G_CreateGeometry(wkbGeometryCollection);
+    OGR_L_ResetReading(hLayer);
+    OGRFeatureH hFeature;
+    while ((hFeature = OGR_L_GetNextFeature(hLayer)) != NULL) {
+        OGRGeometryH featureGeometry = OGR_F_GetGeometryRef(hFeature);
+        if (featureGeometry != NULL && !OGR_G_IsEmpty(featureGeometry)) {
+            OGR_G_AddGeometry(geometry, featureGeometry);
+        }
+        OGR_F_Destroy(hFeature);
+    }
+    int status = setGeometry(geometry, OGR_L_GetSpatialRef(hLayer));
+    GDALClose(hDS);
+    return status;
+}
+
+int TileCover::classify(OGRGeometryH area, int tx, int ty, int tz, OGRGeometryH *clipped) {
+    *clipped = NULL;
+    if (area == NULL) {
+        return TILE_COVER_INSIDE;
+    }
+
+    double bound[4];
+    /// Google Y to TMS Y
+    _mercator->TileBounds(tx, (1 << tz) - 1 - ty, tz, bound);
+    OGREnvelope envelope;
+    OGR_G_GetEnvelope(area, &envelope);
+    if (envelope.MaxX <= bound[0] || envelope.MinX >= bound[2] || envelope.MaxY <= bound[1] || envelope.MinY >= bound[3]) {
+        return TILE_COVER_OUTSIDE;
+    }
+
+    /// One clip per tile: empty - outside, the whole tile - inside
+    OGRGeometryH tile = rectangle(bound[0], bound[1], bound[2], bound[3]);
+    OGRGeometryH part = OGR_G_Intersection(area, tile);
+    OGR_G_DestroyGeometry(tile);
+    if (part == NULL || OGR_G_IsEmpty(part)) {
+        if (part != NULL) {
+            OGR_G_DestroyGeometry(part);
+        }
+        return TILE_COVER_OUTSIDE;
+    }
+    if (OGR_G_GetDimension(area) == 2) {
+        double tileArea = (bound[2] - bound[0]) * (bound[3] - bound[1]);
+        double partArea = OGR_G_Area(part);
+        if (partArea <= 0.0) {
+            /// Polygons which only touch the tile edge
+            OGR_G_DestroyGeometry(part);
+            return TILE_COVER_OUTSIDE;
+        }
+        if (partArea >= tileArea * (1.0 - 1e-9)) {
+            OGR_G_DestroyGeometry(part);
+            return TILE_COVER_INSIDE;
+        }
+    }
+    *clipped = part;
+    return TILE_COVER_PARTIAL;
+}
+
+bool TileCover::intersects(int tx, int ty, int tz) {
+    OGRGeometryH clipped;
+    int state = classify(_geometry, tx, ty, tz, &clipped);
+    if (clipped != NULL) {
+        OGR_G_DestroyGeometry(clipped);
+    }
+    return state != TILE_COVER_OUTSIDE;
+}
+
+int64_t TileCover::count(OGRGeometryH area, int tx, int ty, int t, int tz, const int *range) {
+    int d = tz - t;
+    int64_t w = min<int64_t>((int64_t(tx) + 1) << d, int64_t(range[2]) + 1) - max<int64_t>(int64_t(tx) << d, range[0]);
+    int64_t h = min<int64_t>((int64_t(ty) + 1) << d, int64_t(range[3]) + 1) - max<int64_t>(int64_t(ty) << d, range[1]);
+    if (w <= 0 || h <= 0) {
+        return 0;
+    }
+
+    OGRGeometryH clipped;
+    int state = classify(area, tx, ty, t, &clipped);
+    if (state != TILE_COVER_PARTIAL) {
+        return state == TILE_COVER_INSIDE ? w * h : 0;
+    }
+    int64_t tiles = 0;
+    if (t == tz) {
+        tiles = 1;
+    } else {
+        for (int i = 0;i < 4;i++) {
+            tiles += count(clipped, tx * 2 + (i & 1), ty * 2 + (i >> 1), t + 1, tz, range);
+        }
+    }
+    OGR_G_DestroyGeometry(clipped);
+    return tiles;
+}
+
+int64_t TileCover::count(int tz, const int *range) {
+    return count(_geometry, 0, 0, 0, tz, range);
+}
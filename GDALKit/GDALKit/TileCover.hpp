@@ -0,0 +1,65 @@
+//
+//  TileCover.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef TileCover_hpp
+#define TileCover_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ogr_api.h"
+#include "GlobalMercator.hpp"
+
+#define TILE_COVER_OUTSIDE 0
+#define TILE_COVER_PARTIAL 1
+#define TILE_COVER_INSIDE 2
+
+using namespace std;
+
+/// Area of interest for seeding / prefetching, kept in EPSG:3857 meters.
+/// The tiles intersecting it are found top down: a tile outside the area drops its subtree,
+/// a tile inside the area keeps its whole subtree without further tests, and a partial tile hands
+/// its clipped part of the area to its children, so the tests get cheaper with every level.
+class TileCover {
+private:
+    GlobalMercator *_mercator;
+    OGRGeometryH _geometry;
+
+    int setGeometry(OGRGeometryH geometry, OGRSpatialReferenceH srs);
+public:
+    TileCover(int tile_size = 256);
+    ~TileCover(void);
+
+    /// Area of interest from WKT or GeoJSON (geometry / Feature / FeatureCollection), in WGS84 lon/lat,
+    /// or from a vector file / OGR connection string (all features of layer, or of the first layer).
+    /// 0 - 成功, 1 - 入参错误, 4 - 文件打开错误
+    /// - Parameters:
+    ///   - where: attribute filter of the layer, can be NULL
+    int load(const char *source, const char *layer = NULL, const char *where = NULL);
+
+    /// Removes the area, every tile is inside
+    void reset(void);
+
+    bool isEmpty(void);
+
+    /// The whole area in EPSG:3857, the parent area of the level 0 tile. NULL - no area
+    OGRGeometryH geometry(void);
+
+    /// Tests tile (Google) against the part of the area in its parent (the whole area or a clipped one).
+    /// clipped - the part of the area inside the tile for TILE_COVER_PARTIAL, destroyed by the caller
+    int classify(OGRGeometryH area, int tx, int ty, int tz, OGRGeometryH *clipped);
+
+    /// Tile (Google) intersects the area
+    bool intersects(int tx, int ty, int tz);
+
+    /// Tiles of zoom level tz within range (minx, miny, maxx, maxy) that intersect the area
+    int64_t count(int tz, const int *range);
+
+    /// Same for the subtree of tile (tx, ty, t), area - the part of the area in its parent
+    int64_t count(OGRGeometryH area, int tx, int ty, int t, int tz, const int *range);
+};
+#endif /* TileCover_hpp */
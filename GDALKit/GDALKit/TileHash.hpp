@@ -0,0 +1,53 @@
+//
+//  TileHash.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef TileHash_hpp
+#define TileHash_hpp
+
+#include <stdint.h>
+#include <string.h>
+
+static inline uint64_t TileHashRotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t TileHashMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/// 64 bit content hash of an encoded tile, 8 bytes per step.
+/// Used to find identical tiles (empty / single color) when deduplicating.
+static inline uint64_t TileHash(const void *data, size_t length) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (length * 0x87c37b91114253d5ULL);
+    while (length >= 8) {
+        uint64_t k;
+        memcpy(&k, p, 8);
+        k *= 0x87c37b91114253d5ULL;
+        k = TileHashRotl(k, 31);
+        k *= 0x4cf5ad432745937fULL;
+        h ^= k;
+        h = TileHashRotl(h, 27) * 5 + 0x52dce729;
+        p += 8;
+        length -= 8;
+    }
+    if (length > 0) {
+        uint64_t k = 0;
+        memcpy(&k, p, length);
+        k *= 0x87c37b91114253d5ULL;
+        k = TileHashRotl(k, 31);
+        k *= 0x4cf5ad432745937fULL;
+        h ^= k;
+    }
+    return TileHashMix(h);
+}
+#endif /* TileHash_hpp */
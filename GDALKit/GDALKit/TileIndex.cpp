@@ -0,0 +1,179 @@
+//
+//  TileIndex.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "TileIndex.hpp"
+
+#include <stdlib.h>
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_vsi.h"
+
+TileIndex::TileIndex(void) {
+    _maxz = -1;
+    _count = 0;
+}
+
+TileIndex::~TileIndex(void) {
+    release();
+}
+
+void TileIndex::release(void) {
+    for (int tz = 0;tz <= _maxz;tz++) {
+        Level &level = _levels[tz];
+        int blockCount = level.blocksX * level.blocksY;
+        for (int i = 0;i < blockCount;i++) {
+            delete[] level.blocks[i].load();
+        }
+        level.blocks.reset();
+    }
+    _maxz = -1;
+    _count = 0;
+}
+
+void TileIndex::reset(int ranges[][4], int maxz) {
+    release();
+    
+    _maxz = min(maxz, MAXZOOMLEVEL - 1);
+    for (int tz = 0;tz <= _maxz;tz++) {
+        Level &level = _levels[tz];
+        level.minx = ranges[tz][0];
+        level.miny = ranges[tz][1];
+        level.maxx = ranges[tz][2];
+        level.maxy = ranges[tz][3];
+        int width = max(0, level.maxx - level.minx + 1);
+        int height = max(0, level.maxy - level.miny + 1);
+        level.blocksX = (width + (1 << TILEINDEX_BLOCK_SHIFT) - 1) >> TILEINDEX_BLOCK_SHIFT;
+        level.blocksY = (height + (1 << TILEINDEX_BLOCK_SHIFT) - 1) >> TILEINDEX_BLOCK_SHIFT;
+        
+        int blockCount = level.blocksX * level.blocksY;
+        level.blocks.reset(new atomic<atomic<uint64_t> *>[blockCount]);
+        for (int i = 0;i < blockCount;i++) {
+            level.blocks[i] = NULL;
+        }
+    }
+}
+
+atomic<uint64_t> *TileIndex::word(int tx, int ty, int tz, bool create, uint64_t *mask) {
+    if (tz < 0 || tz > _maxz) {
+        return NULL;
+    }
+    
+    Level &level = _levels[tz];
+    if (tx < level.minx || tx > level.maxx || ty < level.miny || ty > level.maxy) {
+        return NULL;
+    }
+    
+    int x = tx - level.minx;
+    int y = ty - level.miny;
+    int blockMask = (1 << TILEINDEX_BLOCK_SHIFT) - 1;
+    atomic<atomic<uint64_t> *> &slot = level.blocks[(y >> TILEINDEX_BLOCK_SHIFT) * level.blocksX + (x >> TILEINDEX_BLOCK_SHIFT)];
+    atomic<uint64_t> *block = slot.load(memory_order_acquire);
+    if (block == NULL) {
+        if (!create) {
+            return NULL;
+        }
+        
+        atomic<uint64_t> *newBlock = new atomic<uint64_t>[TILEINDEX_BLOCK_WORDS];
+        for (int i = 0;i < TILEINDEX_BLOCK_WORDS;i++) {
+            newBlock[i] = 0;
+        }
+        /// 另一个线程已经分配了
+        if (slot.compare_exchange_strong(block, newBlock, memory_order_acq_rel)) {
+            block = newBlock;
+        } else {
+            delete[] newBlock;
+        }
+    }
+    
+    int bit = ((y & blockMask) << TILEINDEX_BLOCK_SHIFT) | (x & blockMask);
+    *mask = 1ULL << (bit & 63);
+    return &block[bit >> 6];
+}
+
+bool TileIndex::contains(int tx, int ty, int tz) {
+    uint64_t mask;
+    atomic<uint64_t> *w = word(tx, ty, tz, false, &mask);
+    return w != NULL && (w->load(memory_order_relaxed) & mask) != 0;
+}
+
+bool TileIndex::set(int tx, int ty, int tz) {
+    uint64_t mask;
+    atomic<uint64_t> *w = word(tx, ty, tz, true, &mask);
+    if (w == NULL) {
+        return false;
+    }
+    if ((w->fetch_or(mask, memory_order_relaxed) & mask) == 0) {
+        _count++;
+    }
+    return true;
+}
+
+void TileIndex::unset(int tx, int ty, int tz) {
+    uint64_t mask;
+    atomic<uint64_t> *w = word(tx, ty, tz, false, &mask);
+    if (w != NULL && (w->fetch_and(~mask, memory_order_relaxed) & mask) != 0) {
+        _count--;
+    }
+}
+
+void TileIndex::clear(void) {
+    for (int tz = 0;tz <= _maxz;tz++) {
+        Level &level = _levels[tz];
+        int blockCount = level.blocksX * level.blocksY;
+        for (int i = 0;i < blockCount;i++) {
+            atomic<uint64_t> *block = level.blocks[i].load();
+            if (block == NULL) {
+                continue;
+            }
+            for (int w = 0;w < TILEINDEX_BLOCK_WORDS;w++) {
+                block[w] = 0;
+            }
+        }
+    }
+    _count = 0;
+}
+
+uint64_t TileIndex::rebuild(const char *outputPath) {
+    clear();
+    
+    char **zoomDirs = VSIReadDir(outputPath);
+    for (int i = 0;zoomDirs != NULL && zoomDirs[i] != NULL;i++) {
+        char *end = NULL;
+        long tz = strtol(zoomDirs[i], &end, 10);
+        if (*end != '\0' || tz < 0 || tz > _maxz) {
+            continue;
+        }
+        
+        CPLString zoomDir = CPLFormFilename(outputPath, zoomDirs[i], NULL);
+        char **xDirs = VSIReadDir(zoomDir);
+        for (int j = 0;xDirs != NULL && xDirs[j] != NULL;j++) {
+            long tx = strtol(xDirs[j], &end, 10);
+            if (*end != '\0') {
+                continue;
+            }
+            
+            char **files = VSIReadDir(CPLFormFilename(zoomDir, xDirs[j], NULL));
+            for (int k = 0;files != NULL && files[k] != NULL;k++) {
+                /// 只接受y.png, 跳过临时文件
+                long ty = strtol(files[k], &end, 10);
+                if (end != files[k] && EQUAL(end, ".png")) {
+                    set(int(tx), int(ty), int(tz));
+                }
+            }
+            CSLDestroy(files);
+        }
+        CSLDestroy(xDirs);
+    }
+    CSLDestroy(zoomDirs);
+    
+    return _count;
+}
+
+uint64_t TileIndex::count(void) {
+    return _count;
+}
@@ -0,0 +1,76 @@
+//
+//  TileIndex.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef TileIndex_hpp
+#define TileIndex_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#ifndef MAXZOOMLEVEL
+#define MAXZOOMLEVEL 32
+#endif
+
+/// A block covers 256 x 256 tiles
+#define TILEINDEX_BLOCK_SHIFT 8
+#define TILEINDEX_BLOCK_WORDS ((1 << (TILEINDEX_BLOCK_SHIFT * 2)) / 64)
+
+using namespace std;
+
+/// In-memory set of the rendered tiles, one bitmap per zoom level over the file's tile range.
+/// Bitmaps are split in blocks which are allocated on the first tile written inside them,
+/// so a sparse cache of a large dataset stays small. contains/set are lock free.
+class TileIndex {
+private:
+    struct Level {
+        /// Google XY range
+        int minx;
+        int miny;
+        int maxx;
+        int maxy;
+        int blocksX;
+        int blocksY;
+        unique_ptr<atomic<atomic<uint64_t> *>[]> blocks;
+    };
+    
+    Level _levels[MAXZOOMLEVEL];
+    int _maxz;
+    atomic<uint64_t> _count;
+    
+    atomic<uint64_t> *word(int tx, int ty, int tz, bool create, uint64_t *mask);
+    
+    void release(void);
+public:
+    TileIndex(void);
+    ~TileIndex(void);
+    
+    /// - Parameters:
+    ///   - ranges: Google XY range of each zoom level: minx, miny, maxx, maxy
+    ///   - maxz: 最大的zoomlevel
+    void reset(int ranges[][4], int maxz);
+    
+    bool contains(int tx, int ty, int tz);
+    
+    /// 返回false表示Tile不在范围内
+    bool set(int tx, int ty, int tz);
+    
+    void unset(int tx, int ty, int tz);
+    
+    /// 清空所有Tile, 范围不变
+    void clear(void);
+    
+    /// 扫描outputPath/z/x/y.png, 每个目录读取一次, 不对单个文件stat
+    /// - Returns: 找到的Tile数
+    uint64_t rebuild(const char *outputPath);
+    
+    uint64_t count(void);
+};
+#endif /* TileIndex_hpp */
@@ -0,0 +1,265 @@
+//
+//  TilePipeline.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "TilePipeline.hpp"
+
+TilePipeline::TilePipeline(GDAL2Mercator *mercator, TileStore *store, int readers, int encoders, int writers, size_t queueCapacity)
+: _readQueue(4096, 2), _encodeQueue(queueCapacity), _writeQueue(queueCapacity) {
+    _mercator = mercator;
+    /// A mosaic is read through the mercator, without a dataset per reader
+    _cogFile = mercator->_cogFile == NULL || mercator->isMosaic() ? "" : mercator->_cogFile;
+    _store = store;
+    _stopped = false;
+    _pending = 0;
+    writeBatchSize = 16;
+    cache = NULL;
+    index = NULL;
+    
+    if (encoders <= 0) {
+        encoders = max(1, int(thread::hardware_concurrency()));
+    }
+    for (int i = 0;i < max(1, readers);i++) {
+        _readers.emplace_back(&TilePipeline::readLoop, this);
+    }
+    for (int i = 0;i < encoders;i++) {
+        _encoders.emplace_back(&TilePipeline::encodeLoop, this);
+    }
+    for (int i = 0;i < max(1, writers);i++) {
+        _writers.emplace_back(&TilePipeline::writeLoop, this);
+    }
+}
+
+TilePipeline::~TilePipeline(void) {
+    stop();
+}
+
+bool TilePipeline::isCancelled(const TileJob &job) {
+    return _stopped || (job.cancelled && job.cancelled->load());
+}
+
+TileResult TilePipeline::makeResult(const TileJob &job, int status) {
+    TileResult result;
+    result.tx = job.tx;
+    result.ty = job.ty;
+    result.tz = job.tz;
+    result.status = status;
+    result.elapsed = 0;
+    result.skipped = false;
+    return result;
+}
+
+void TilePipeline::finish(const TileJob &job, TileResult &result) {
+    result.elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - job.begin).count();
+    if (job.callback) {
+        job.callback(result);
+    }
+    
+    if (--_pending == 0) {
+        lock_guard<mutex> lock(_idleMutex);
+        _idle.notify_all();
+    }
+}
+
+void TilePipeline::readLoop(void) {
+    GDALDatasetH hSrcDS = _cogFile.empty() ? NULL : GDALOpen(_cogFile.c_str(), GA_ReadOnly);
+    
+    TileJob job;
+    while (_readQueue.pop(job)) {
+        if (isCancelled(job)) {
+            TileResult result = makeResult(job, TILE_STATUS_CANCELLED);
+            finish(job, result);
+            continue;
+        }
+        
+        /// Beyond TileKey, would be cached / indexed as another tile
+        if (job.tz < 0 || job.tz > TILEKEY_MAXZOOM) {
+            TileResult result = makeResult(job, 1);
+            finish(job, result);
+            continue;
+        }
+        
+        job.params = _mercator->renderFingerprint();
+        if (cache != NULL) {
+            TileData data;
+            if (cache->get({TileKey(job.tx, job.ty, job.tz), job.params}, data)) {
+                TileResult result = makeResult(job, 0);
+                if (_store != NULL) {
+                    result.path = _store->tilePath(job.tx, job.ty, job.tz);
+                }
+                result.bytes = *data;
+                result.skipped = true;
+                finish(job, result);
+                continue;
+            }
+        }
+        
+        if (job.skipExisting && _store != NULL) {
+            bool exists = index != NULL ? index->contains(job.tx, job.ty, job.tz) : _store->containsTile(job.tx, job.ty, job.tz);
+            if (exists) {
+                TileResult result = makeResult(job, 0);
+                result.path = _store->tilePath(job.tx, job.ty, job.tz);
+                result.skipped = true;
+                finish(job, result);
+                continue;
+            }
+        }
+        
+        if (hSrcDS == NULL && !_mercator->isMosaic()) {
+            TileResult result = makeResult(job, 4);
+            finish(job, result);
+            continue;
+        }
+        
+        EncodeItem item;
+        item.job = job;
+        int status = _mercator->readTileData(hSrcDS, job.tx, job.ty, job.tz, item.tile);
+        if (status != 0) {
+            TileResult result = makeResult(job, status);
+            finish(job, result);
+            continue;
+        }
+        
+        if (!_encodeQueue.push(std::move(item))) {
+            TileResult result = makeResult(job, TILE_STATUS_CANCELLED);
+            finish(job, result);
+        }
+    }
+    
+    if (hSrcDS != NULL) {
+        GDALClose(hSrcDS);
+    }
+}
+
+void TilePipeline::encodeLoop(void) {
+    EncodeItem item;
+    while (_encodeQueue.pop(item)) {
+        WriteItem output;
+        output.job = item.job;
+        output.result = makeResult(item.job, TILE_STATUS_CANCELLED);
+        if (!isCancelled(item.job) && item.job.buffer) {
+            output.result.status = _mercator->encodeTile(*item.job.buffer, output.result.bytes);
+            if (item.job.keepBuffer) {
+                output.result.buffer = item.job.buffer;
+            }
+        } else if (!isCancelled(item.job)) {
+            _mercator->transformTile(item.tile);
+            output.result.status = _mercator->encodeTile(item.tile, output.result.bytes);
+            if (item.job.keepBuffer) {
+                output.result.buffer = make_shared<TileBuffer>(std::move(item.tile));
+            }
+        }
+        
+        if (output.result.status != 0) {
+            finish(output.job, output.result);
+            continue;
+        }
+        
+        TileJob job = output.job;
+        if (!_writeQueue.push(std::move(output))) {
+            TileResult result = makeResult(job, TILE_STATUS_CANCELLED);
+            finish(job, result);
+        }
+    }
+}
+
+void TilePipeline::writeLoop(void) {
+    vector<WriteItem> batch;
+    WriteItem item;
+    while (_writeQueue.pop(item)) {
+        /// 把已经在队列中的Tile一起写入
+        batch.clear();
+        batch.push_back(std::move(item));
+        while (int(batch.size()) < writeBatchSize && _writeQueue.tryPop(item)) {
+            batch.push_back(std::move(item));
+        }
+        
+        if (_store != NULL) {
+            _store->beginBatch();
+            for (WriteItem &output : batch) {
+                TileResult &result = output.result;
+                result.status = _store->writeTile(result.tx, result.ty, result.tz, result.bytes);
+            }
+            int status = _store->commitBatch();
+            
+            for (WriteItem &output : batch) {
+                TileResult &result = output.result;
+                if (result.status == 0) {
+                    result.status = status;
+                }
+                if (result.status == 0) {
+                    result.path = _store->tilePath(result.tx, result.ty, result.tz);
+                    if (index != NULL) {
+                        index->set(result.tx, result.ty, result.tz);
+                    }
+                }
+            }
+        }
+        
+        for (WriteItem &output : batch) {
+            if (cache != NULL && output.result.status == 0) {
+                cache->put({TileKey(output.job.tx, output.job.ty, output.job.tz), output.job.params}, make_shared<const vector<unsigned char>>(output.result.bytes));
+            }
+            finish(output.job, output.result);
+        }
+    }
+}
+
+bool TilePipeline::submit(TileJob job) {
+    if (_stopped) {
+        return false;
+    }
+    
+    job.begin = chrono::steady_clock::now();
+    _pending++;
+    if (job.buffer) {
+        job.params = _mercator->renderFingerprint();
+        EncodeItem item;
+        item.job = std::move(job);
+        /// Usually called from a completion callback on the writer thread, waiting for room in
+        /// the encode queue would wait for the writer itself
+        if (!_encodeQueue.pushNow(std::move(item))) {
+            _pending--;
+            return false;
+        }
+        return true;
+    }
+    int priority = job.priority;
+    if (!_readQueue.push(std::move(job), priority)) {
+        _pending--;
+        return false;
+    }
+    return true;
+}
+
+void TilePipeline::waitIdle(void) {
+    unique_lock<mutex> lock(_idleMutex);
+    _idle.wait(lock, [this] { return _pending == 0; });
+}
+
+void TilePipeline::stop(void) {
+    if (_stopped.exchange(true)) {
+        return;
+    }
+    
+    /// 按阶段顺序关闭, 已排队的任务都会被回调
+    _readQueue.close();
+    for (thread &t : _readers) {
+        t.join();
+    }
+    _encodeQueue.close();
+    for (thread &t : _encoders) {
+        t.join();
+    }
+    _writeQueue.close();
+    for (thread &t : _writers) {
+        t.join();
+    }
+}
+
+int TilePipeline::pending(void) {
+    return _pending;
+}
@@ -0,0 +1,128 @@
+//
+//  TilePipeline.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef TilePipeline_hpp
+#define TilePipeline_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "GDAL2Mercator.hpp"
+#include "BoundedQueue.hpp"
+#include "TileCache.hpp"
+#include "TileIndex.hpp"
+#include "TileStore.hpp"
+
+#define TILE_PRIORITY_VISIBLE 0
+#define TILE_PRIORITY_PREFETCH 1
+
+/// readTile的返回值之外: 任务被取消
+#define TILE_STATUS_CANCELLED 5
+
+using namespace std;
+
+struct TileJob {
+    int tx;
+    int ty;
+    int tz;
+    /// TILE_PRIORITY_VISIBLE / TILE_PRIORITY_PREFETCH
+    int priority;
+    /// store中已存在的Tile不再生成
+    bool skipExisting;
+    /// TileResult.buffer中返回颜色处理后的像素
+    bool keepBuffer;
+    /// 置为true后, 还未开始的阶段都会跳过
+    shared_ptr<atomic<bool>> cancelled;
+    /// 在Pipeline的工作线程中回调
+    TileCallback callback;
+    chrono::steady_clock::time_point begin;
+    /// 读取时的renderFingerprint
+    uint64_t params;
+    /// 不为NULL时跳过读取阶段, 直接编码并写入这些已颜色处理的像素, 例如合成的上级Tile
+    shared_ptr<TileBuffer> buffer;
+};
+
+/// Tile rendering split into read → transform/encode → write stages.
+/// Each stage has its own worker threads, stages are connected by bounded queues,
+/// so a slow stage blocks the one before it instead of piling up tiles in memory.
+/// Every reader keeps one GDAL dataset handle open for its whole lifetime.
+class TilePipeline {
+private:
+    struct EncodeItem {
+        TileJob job;
+        TileBuffer tile;
+    };
+    
+    struct WriteItem {
+        TileJob job;
+        TileResult result;
+    };
+    
+    GDAL2Mercator *_mercator;
+    string _cogFile;
+    /// 为NULL时不保存, PNG数据通过TileResult.bytes返回
+    TileStore *_store;
+    
+    BoundedQueue<TileJob> _readQueue;
+    BoundedQueue<EncodeItem> _encodeQueue;
+    BoundedQueue<WriteItem> _writeQueue;
+    
+    vector<thread> _readers;
+    vector<thread> _encoders;
+    vector<thread> _writers;
+    
+    atomic<bool> _stopped;
+    atomic<int> _pending;
+    mutex _idleMutex;
+    condition_variable _idle;
+    
+    bool isCancelled(const TileJob &job);
+    
+    TileResult makeResult(const TileJob &job, int status);
+    
+    void finish(const TileJob &job, TileResult &result);
+    
+    void readLoop(void);
+    
+    void encodeLoop(void);
+    
+    void writeLoop(void);
+public:
+    /// - Parameters:
+    ///   - readers: 读取线程数, COG的读取是I/O密集, 太多会挤掉GDAL的块缓存
+    ///   - encoders: 颜色处理+PNG编码线程数, 0 - CPU核数
+    ///   - writers: 写入线程数
+    ///   - queueCapacity: 阶段之间的队列长度
+    ///   - store: Tile保存的位置, 不会被释放
+    TilePipeline(GDAL2Mercator *mercator, TileStore *store, int readers = 2, int encoders = 0, int writers = 1, size_t queueCapacity = 32);
+    ~TilePipeline(void);
+    
+    /// 每次写入最多合并的Tile数
+    int writeBatchSize;
+    
+    /// 内存缓存, 可为NULL. 命中时不再检查文件和生成
+    TileCache *cache;
+    
+    /// 已生成Tile的索引, 可为NULL(此时检查文件). 写入成功后更新
+    TileIndex *index;
+    
+    /// 加入读取队列, 队列满时阻塞. 返回false表示已停止
+    /// job.buffer不为NULL时加入编码队列, 不阻塞, 可以在回调中调用
+    bool submit(TileJob job);
+    
+    /// 等待所有任务完成
+    void waitIdle(void);
+    
+    /// 还未完成的任务都以TILE_STATUS_CANCELLED结束, 并等待线程退出
+    void stop(void);
+    
+    int pending(void);
+};
+#endif /* TilePipeline_hpp */
@@ -0,0 +1,200 @@
+//
+//  TilePrefetcher.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "TilePrefetcher.hpp"
+
+#include <algorithm>
+
+TilePrefetcher::TilePrefetcher(int tile_size) {
+    _tile_size = tile_size;
+    _sampleCount = 0;
+    _sampleIndex = 0;
+
+    budget = 32;
+    lookahead = 0.5;
+    sampleWindow = 0.3;
+
+    _mercator = new GlobalMercator(_tile_size);
+}
+
+TilePrefetcher::~TilePrefetcher(void) {
+    delete _mercator;
+}
+
+const CameraSample &TilePrefetcher::sampleAt(int age) {
+    return _samples[(_sampleIndex - 1 - age + PREFETCH_SAMPLES * 2) % PREFETCH_SAMPLES];
+}
+
+void TilePrefetcher::velocity(double *vxyz) {
+    vxyz[0] = 0.0;
+    vxyz[1] = 0.0;
+    vxyz[2] = 0.0;
+    if (_sampleCount < 2) {
+        return;
+    }
+
+    /// Oldest sample which is still inside the window
+    const CameraSample &cur = sampleAt(0);
+    int age = 0;
+    for (int i = 1;i < _sampleCount;i++) {
+        if (cur.timestamp - sampleAt(i).timestamp > sampleWindow) {
+            break;
+        }
+        age = i;
+    }
+
+    const CameraSample &old = sampleAt(age);
+    double dt = cur.timestamp - old.timestamp;
+    if (age == 0 || dt < 0.001) {
+        return;
+    }
+
+    vxyz[0] = (cur.cx - old.cx) / dt;
+    vxyz[1] = (cur.cy - old.cy) / dt;
+    vxyz[2] = (cur.zoom - old.zoom) / dt;
+}
+
+void TilePrefetcher::tileRange(double cx, double cy, double hx, double hy, int tz, int *range) {
+    double tminxy[2];
+    double tmaxxy[2];
+    _mercator->MetersToTile(cx - hx, cy - hy, tz, tminxy);
+    _mercator->MetersToTile(cx + hx, cy + hy, tz, tmaxxy);
+
+    int maxTile = (1 << tz) - 1;
+    /// minx, maxx, miny, maxy (Google Y)
+    range[0] = max(0, min(maxTile, int(tminxy[0])));
+    range[1] = max(0, min(maxTile, int(tmaxxy[0])));
+    range[2] = max(0, min(maxTile, maxTile - int(tmaxxy[1])));
+    range[3] = max(0, min(maxTile, maxTile - int(tminxy[1])));
+}
+
+void TilePrefetcher::appendRange(vector<TileXYZ> &tiles, int *range, int tz, int *exclude, double cx, double cy) {
+    double pxy[2];
+    _mercator->MetersToPixels(cx, cy, tz, pxy);
+    double fx = pxy[0] / _tile_size;
+    double fy = double(1 << tz) - pxy[1] / _tile_size;
+    int ox = max(range[0], min(range[1], int(floor(fx))));
+    int oy = max(range[2], min(range[3], int(floor(fy))));
+    int radius = max(max(ox - range[0], range[1] - ox), max(oy - range[2], range[3] - oy));
+
+    /// Rings around the (predicted) viewport center, nearest first, until the budget is reached
+    vector<TileXYZ> ring;
+    for (int r = 0;r <= radius && int(tiles.size()) < budget;r++) {
+        ring.clear();
+        for (int tx = ox - r;tx <= ox + r;tx++) {
+            if (tx < range[0] || tx > range[1]) {
+                continue;
+            }
+            /// Top and bottom rows of the ring, the columns in between only at its left/right edge
+            int step = (tx == ox - r || tx == ox + r) ? 1 : max(1, 2 * r);
+            for (int ty = oy - r;ty <= oy + r;ty += step) {
+                if (ty < range[2] || ty > range[3]) {
+                    continue;
+                }
+                if (exclude != NULL && tx >= exclude[0] && tx <= exclude[1] && ty >= exclude[2] && ty <= exclude[3]) {
+                    continue;
+                }
+                ring.push_back({tx, ty, tz});
+            }
+        }
+        sort(ring.begin(), ring.end(), [fx, fy](const TileXYZ &a, const TileXYZ &b) {
+            double da = (a.x + 0.5 - fx) * (a.x + 0.5 - fx) + (a.y + 0.5 - fy) * (a.y + 0.5 - fy);
+            double db = (b.x + 0.5 - fx) * (b.x + 0.5 - fx) + (b.y + 0.5 - fy) * (b.y + 0.5 - fy);
+            return da < db;
+        });
+        size_t count = min(ring.size(), size_t(budget) - tiles.size());
+        tiles.insert(tiles.end(), ring.begin(), ring.begin() + count);
+    }
+}
+
+void TilePrefetcher::addSample(double lat0, double lon0, double lat1, double lon1, double zoom, double timestamp) {
+    double mxy0[2];
+    double mxy1[2];
+    _mercator->LatLonToMeters(lat0, lon0, mxy0);
+    _mercator->LatLonToMeters(lat1, lon1, mxy1);
+
+    lock_guard<mutex> lock(_mutex);
+    /// A pause between two samples starts a new gesture
+    if (_sampleCount > 0 && timestamp - sampleAt(0).timestamp > sampleWindow) {
+        _sampleCount = 0;
+    }
+
+    CameraSample &sample = _samples[_sampleIndex];
+    sample.cx = (mxy0[0] + mxy1[0]) / 2.0;
+    sample.cy = (mxy0[1] + mxy1[1]) / 2.0;
+    sample.hx = fabs(mxy1[0] - mxy0[0]) / 2.0;
+    sample.hy = fabs(mxy1[1] - mxy0[1]) / 2.0;
+    sample.zoom = zoom;
+    sample.timestamp = timestamp;
+
+    _sampleIndex = (_sampleIndex + 1) % PREFETCH_SAMPLES;
+    _sampleCount = min(_sampleCount + 1, PREFETCH_SAMPLES);
+}
+
+void TilePrefetcher::reset(void) {
+    lock_guard<mutex> lock(_mutex);
+    _sampleCount = 0;
+    _sampleIndex = 0;
+}
+
+int TilePrefetcher::predictTiles(vector<TileXYZ> &tiles) {
+    tiles.clear();
+
+    lock_guard<mutex> lock(_mutex);
+    if (_sampleCount == 0 || budget <= 0) {
+        return 0;
+    }
+
+    const CameraSample &cur = sampleAt(0);
+    double v[3];
+    velocity(v);
+
+    int tz = max(0, min(TILEKEY_MAXZOOM - 1, int(round(cur.zoom))));
+    int visible[4];
+    tileRange(cur.cx, cur.cy, cur.hx, cur.hy, tz, visible);
+
+    /// Extrapolated viewport, a zoom of +1 halves its size. A fling or a fast pinch is limited to
+    /// one zoom level and a few viewports of travel, the prediction is not reliable beyond that
+    double reach = PREFETCH_MAX_TRAVEL * max(cur.hx, cur.hy);
+    double px = cur.cx + max(-reach, min(reach, v[0] * lookahead));
+    double py = cur.cy + max(-reach, min(reach, v[1] * lookahead));
+    double pz = max(cur.zoom - 1.0, min(cur.zoom + 1.0, cur.zoom + v[2] * lookahead));
+    double scale = pow(2.0, cur.zoom - pz);
+    double phx = cur.hx * scale;
+    double phy = cur.hy * scale;
+
+    /// 1. leading edge of the pan at the current zoom
+    if (v[0] != 0.0 || v[1] != 0.0) {
+        int predicted[4];
+        tileRange(px, py, cur.hx, cur.hy, tz, predicted);
+        appendRange(tiles, predicted, tz, visible, px, py);
+    }
+
+    /// 2. the level the camera is zooming to, zoom±1 when it is not zooming
+    int levels[2] = {tz - 1, tz + 1};
+    int levelCount = 2;
+    if (v[2] > 0.0) {
+        levels[0] = tz + 1;
+        levelCount = 1;
+    } else if (v[2] < 0.0) {
+        levelCount = 1;
+    }
+    for (int i = 0;i < levelCount && int(tiles.size()) < budget;i++) {
+        int lz = levels[i];
+        if (lz < 0 || lz > TILEKEY_MAXZOOM) {
+            continue;
+        }
+        int range[4];
+        tileRange(px, py, phx, phy, lz, range);
+        appendRange(tiles, range, lz, NULL, px, py);
+    }
+
+    if (int(tiles.size()) > budget) {
+        tiles.resize(budget);
+    }
+    return int(tiles.size());
+}
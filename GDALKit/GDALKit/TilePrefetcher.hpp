@@ -0,0 +1,79 @@
+//
+//  TilePrefetcher.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef TilePrefetcher_hpp
+#define TilePrefetcher_hpp
+
+#include <stdio.h>
+#include <math.h>
+#include <mutex>
+#include <vector>
+
+#include "GlobalMercator.hpp"
+
+#define PREFETCH_SAMPLES 8
+/// Max predicted pan, in viewport half sizes
+#define PREFETCH_MAX_TRAVEL 4.0
+
+using namespace std;
+
+/// One camera state, viewport center/half size in EPSG:3857 meters
+struct CameraSample {
+    double cx;
+    double cy;
+    double hx;
+    double hy;
+    double zoom;
+    double timestamp;
+};
+
+/// Predicts the tiles the camera is about to show from the recent pan/zoom velocity.
+class TilePrefetcher {
+private:
+    GlobalMercator *_mercator;
+
+    int _tile_size;
+
+    CameraSample _samples[PREFETCH_SAMPLES];
+    int _sampleCount;
+    int _sampleIndex;
+
+    mutex _mutex;
+
+    const CameraSample &sampleAt(int age);
+
+    void velocity(double *vxyz);
+
+    void tileRange(double cx, double cy, double hx, double hy, int tz, int *range);
+
+    /// Tiles of range nearest to (cx, cy) first, until tiles holds `budget` entries
+    void appendRange(vector<TileXYZ> &tiles, int *range, int tz, int *exclude, double cx, double cy);
+public:
+    TilePrefetcher(int tile_size = 256);
+    ~TilePrefetcher(void);
+
+    /// Max tiles returned by one predictTiles call
+    int budget;
+
+    /// How far ahead (seconds) the camera motion is extrapolated
+    double lookahead;
+
+    /// Samples older than this (seconds) are not used for the velocity
+    double sampleWindow;
+
+    /// Add a camera sample, the viewport is given by its southwest / northeast corner
+    void addSample(double lat0, double lon0, double lat1, double lon1, double zoom, double timestamp);
+
+    /// Drop all samples, e.g. when a new file is opened
+    void reset(void);
+
+    /// Tiles (Google XYZ) ahead of the pan and at the level the camera zooms to (zoom±1 when it
+    /// does not zoom), visible tiles are not included.
+    /// Ordered by priority and at most `budget` entries.
+    int predictTiles(vector<TileXYZ> &tiles);
+};
+#endif /* TilePrefetcher_hpp */
@@ -0,0 +1,444 @@
+//
+//  TileStore.cpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#include "TileStore.hpp"
+#include "TileHash.hpp"
+#include "GlobalMercator.hpp"
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_vsi.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+bool TileStore::validate(const TileManifest &manifest) {
+    TileManifest stored;
+    bool found = readManifest(stored);
+    if (found && stored.source == manifest.source && stored.render == manifest.render) {
+        return false;
+    }
+    
+    /// A store without manifest may hold tiles of an unknown file
+    if (found) {
+        printf("Tile store is stale (source %s, render %s), clear it\n",
+               stored.source == manifest.source ? "same" : "changed",
+               stored.render == manifest.render ? "same" : "changed");
+    }
+    clear();
+    writeManifest(manifest);
+    return true;
+}
+
+DirectoryTileStore::DirectoryTileStore(const char *outputPath) : _tempSerial(0) {
+    _outputPath = outputPath;
+    syncPolicy = TILE_SYNC_NONE;
+}
+
+DirectoryTileStore::~DirectoryTileStore(void) {
+    /// Unfinished batches are still written
+    for (pair<const thread::id, TileBatch> &batch : _batches) {
+        storeTiles(batch.second.tiles);
+    }
+}
+
+bool DirectoryTileStore::linkTile(uint64_t key, uint64_t hash, size_t length, const char *tempFile) {
+    TileBlob blob;
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto found = _blobs.find(hash);
+        /// The same content written again to the same tile is not linked: renaming a link over its own file would leave the link behind
+        if (found == _blobs.end() || found->second.length != length || found->second.tile == key) {
+            return false;
+        }
+        blob = found->second;
+    }
+    
+    string source = tilePath(int((blob.tile >> 29) & 0x1fffffff), int(blob.tile & 0x1fffffff), int(blob.tile >> 58));
+    VSIStatBufL sStat;
+    if (VSIStatL(source.c_str(), &sStat) != 0 || size_t(sStat.st_size) != length) {
+        lock_guard<mutex> lock(_mutex);
+        auto found = _blobs.find(hash);
+        if (found != _blobs.end() && found->second.tile == blob.tile) {
+            _blobs.erase(found);
+        }
+        return false;
+    }
+    if (link(source.c_str(), tempFile) != 0) {
+        return false;
+    }
+    
+    /// A writer replacing the blob's tile forgets the blob before it renames, so the link is
+    /// the blob's content as long as the blob is still known
+    lock_guard<mutex> lock(_mutex);
+    auto found = _blobs.find(hash);
+    if (found == _blobs.end() || found->second.tile != blob.tile) {
+        unlink(tempFile);
+        return false;
+    }
+    return true;
+}
+
+int DirectoryTileStore::makeDirectory(int tx, int tz) {
+    uint64_t xKey = (uint64_t(tz) << 32) | uint32_t(tx);
+    uint64_t zoomKey = (uint64_t(tz) << 32) | 0xffffffffULL;
+    bool zoomKnown;
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_directories.count(xKey) != 0) {
+            return 0;
+        }
+        zoomKnown = _directories.count(zoomKey) != 0;
+    }
+    
+    /// Another writer may create them at the same time, EEXIST is fine
+    const char *zoomDir = CPLSPrintf("%s/%d", _outputPath.c_str(), tz);
+    if (!zoomKnown && mkdir(zoomDir, 0777) != 0 && errno != EEXIST) {
+        printf("Create Tile directory error: %s\n", zoomDir);
+        return 2;
+    }
+    const char *txDir = CPLSPrintf("%s/%d/%d", _outputPath.c_str(), tz, tx);
+    if (mkdir(txDir, 0777) != 0 && errno != EEXIST) {
+        printf("Create Tile directory error: %s\n", txDir);
+        return 2;
+    }
+    
+    lock_guard<mutex> lock(_mutex);
+    _directories.insert(zoomKey);
+    _directories.insert(xKey);
+    return 0;
+}
+
+int DirectoryTileStore::writeTempFile(const vector<unsigned char> &data, TileFile &file) {
+    const char *tempFile = file.tempFile.c_str();
+    file.linked = false;
+    /// Left over by a crash, or a link target
+    unlink(tempFile);
+    if (deduplicate) {
+        {
+            lock_guard<mutex> lock(_mutex);
+            auto previous = _tileHashes.find(file.key);
+            if (previous != _tileHashes.end() && previous->second != file.hash) {
+                auto blob = _blobs.find(previous->second);
+                if (blob != _blobs.end() && blob->second.tile == file.key) {
+                    _blobs.erase(blob);
+                }
+            }
+            _tileHashes[file.key] = file.hash;
+        }
+        
+        /// The linked file is already on disk, nothing to fsync
+        if (linkTile(file.key, file.hash, data.size(), tempFile)) {
+            _duplicates++;
+            file.linked = true;
+            return 0;
+        }
+    }
+    
+    int fd = open(tempFile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        return 2;
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += size_t(n);
+    }
+    bool ok = written == data.size() && (syncPolicy != TILE_SYNC_TILE || fsync(fd) == 0);
+    ok = close(fd) == 0 && ok;
+    if (!ok) {
+        printf("Write Tile PNG error\n");
+        unlink(tempFile);
+        return 2;
+    }
+    return 0;
+}
+
+int DirectoryTileStore::prepareTile(int tx, int ty, int tz, const vector<unsigned char> &data, TileFile &file) {
+    if (makeDirectory(tx, tz) != 0) {
+        return 2;
+    }
+    file.pngFile = tilePath(tx, ty, tz);
+    file.tempFile = CPLSPrintf("%s.%d.%" PRIu64 ".tmp", file.pngFile.c_str(), int(getpid()), _tempSerial++);
+    file.key = TileKey(tx, ty, tz);
+    file.hash = deduplicate ? TileHash(data.data(), data.size()) : 0;
+    file.length = data.size();
+    int result = writeTempFile(data, file);
+    if (result != 0 && errno == ENOENT) {
+        /// The directory was removed behind the cache
+        {
+            lock_guard<mutex> lock(_mutex);
+            _directories.erase((uint64_t(tz) << 32) | uint32_t(tx));
+            _directories.erase((uint64_t(tz) << 32) | 0xffffffffULL);
+        }
+        if (makeDirectory(tx, tz) != 0) {
+            return 2;
+        }
+        result = writeTempFile(data, file);
+    }
+    if (result != 0) {
+        printf("Create Tile PNG error\n");
+        return 2;
+    }
+    return 0;
+}
+
+void DirectoryTileStore::syncDirectories(const unordered_set<string> &directories) {
+    for (const string &directory : directories) {
+        int fd = open(directory.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+}
+
+int DirectoryTileStore::storeTiles(const vector<pair<uint64_t, vector<unsigned char>>> &tiles) {
+    int result = 0;
+    vector<TileFile> files;
+    files.reserve(tiles.size());
+    for (const pair<uint64_t, vector<unsigned char>> &tile : tiles) {
+        TileFile file;
+        if (prepareTile(int((tile.first >> 29) & 0x1fffffff), int(tile.first & 0x1fffffff), int(tile.first >> 58), tile.second, file) != 0) {
+            result = 2;
+            continue;
+        }
+        files.push_back(file);
+    }
+    
+    unordered_set<string> directories;
+    for (const TileFile &file : files) {
+        /// All temporary files of the batch are written before the first one is fsynced
+        if (syncPolicy == TILE_SYNC_BATCH && !file.linked) {
+            int fd = open(file.tempFile.c_str(), O_RDONLY);
+            bool ok = fd >= 0 && fsync(fd) == 0;
+            if (fd >= 0) {
+                close(fd);
+            }
+            if (!ok) {
+                printf("Sync Tile PNG error\n");
+                unlink(file.tempFile.c_str());
+                result = 2;
+                continue;
+            }
+        }
+        
+        /// Replaces the directory entry only: files linked to the old tile keep their content
+        if (rename(file.tempFile.c_str(), file.pngFile.c_str()) != 0) {
+            printf("Rename Tile PNG error\n");
+            unlink(file.tempFile.c_str());
+            result = 2;
+            continue;
+        }
+        
+        if (deduplicate && !file.linked) {
+            lock_guard<mutex> lock(_mutex);
+            /// Still the tile's content, not replaced by another writer meanwhile
+            auto hash = _tileHashes.find(file.key);
+            if (hash != _tileHashes.end() && hash->second == file.hash) {
+                _blobs[file.hash] = {file.key, file.length};
+            }
+        }
+        
+        if (syncPolicy == TILE_SYNC_TILE) {
+            syncDirectories({CPLGetPath(file.pngFile.c_str())});
+        } else if (syncPolicy == TILE_SYNC_BATCH) {
+            directories.insert(CPLGetPath(file.pngFile.c_str()));
+        }
+    }
+    syncDirectories(directories);
+    return result;
+}
+
+int DirectoryTileStore::writeTile(int tx, int ty, int tz, const vector<unsigned char> &data) {
+    /// Batched tiles are kept by TileKey
+    if (tz < 0 || tz > TILEKEY_MAXZOOM) {
+        printf("Tile zoom out of range: %d\n", tz);
+        return 2;
+    }
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto batch = _batches.find(this_thread::get_id());
+        if (batch != _batches.end() && !batch->second.committing) {
+            uint64_t key = TileKey(tx, ty, tz);
+            batch->second.tiles.push_back(make_pair(key, data));
+            batch->second.index[key] = batch->second.tiles.size() - 1;
+            return 0;
+        }
+    }
+    vector<pair<uint64_t, vector<unsigned char>>> tiles;
+    tiles.push_back(make_pair(TileKey(tx, ty, tz), data));
+    return storeTiles(tiles);
+}
+
+int DirectoryTileStore::beginBatch(void) {
+    lock_guard<mutex> lock(_mutex);
+    _batches[this_thread::get_id()].depth++;
+    return 0;
+}
+
+int DirectoryTileStore::commitBatch(void) {
+    TileBatch *batch;
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto found = _batches.find(this_thread::get_id());
+        if (found == _batches.end() || --found->second.depth > 0) {
+            return 0;
+        }
+        /// Stays readable until it is on disk. Only this thread writes to it, and the map
+        /// keeps the node in place while other threads add theirs
+        batch = &found->second;
+        batch->committing = true;
+    }
+    
+    int result = storeTiles(batch->tiles);
+    
+    lock_guard<mutex> lock(_mutex);
+    _batches.erase(this_thread::get_id());
+    return result;
+}
+
+bool DirectoryTileStore::readTile(int tx, int ty, int tz, vector<unsigned char> &data) {
+    {
+        /// Written in an open batch, not on disk yet
+        lock_guard<mutex> lock(_mutex);
+        uint64_t key = TileKey(tx, ty, tz);
+        for (const pair<const thread::id, TileBatch> &batch : _batches) {
+            auto found = batch.second.index.find(key);
+            if (found != batch.second.index.end()) {
+                data = batch.second.tiles[found->second].second;
+                return true;
+            }
+        }
+    }
+    
+    VSILFILE *fp = VSIFOpenL(tilePath(tx, ty, tz).c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    
+    VSIFSeekL(fp, 0, SEEK_END);
+    vsi_l_offset length = VSIFTellL(fp);
+    VSIFSeekL(fp, 0, SEEK_SET);
+    data.resize(size_t(length));
+    bool ok = VSIFReadL(data.data(), 1, data.size(), fp) == data.size();
+    VSIFCloseL(fp);
+    return ok;
+}
+
+bool DirectoryTileStore::containsTile(int tx, int ty, int tz) {
+    {
+        lock_guard<mutex> lock(_mutex);
+        uint64_t key = TileKey(tx, ty, tz);
+        for (const pair<const thread::id, TileBatch> &batch : _batches) {
+            if (batch.second.index.count(key) != 0) {
+                return true;
+            }
+        }
+    }
+    VSIStatBufL sStat;
+    return VSIStatL(tilePath(tx, ty, tz).c_str(), &sStat) == 0;
+}
+
+uint64_t DirectoryTileStore::rebuildIndex(TileIndex *index) {
+    return index->rebuild(_outputPath.c_str());
+}
+
+bool DirectoryTileStore::readManifest(TileManifest &manifest) {
+    VSILFILE *fp = VSIFOpenL(CPLSPrintf("%s/manifest.json", _outputPath.c_str()), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    char buffer[512] = {0};
+    VSIFReadL(buffer, 1, sizeof(buffer) - 1, fp);
+    VSIFCloseL(fp);
+    
+    const char *source = strstr(buffer, "\"source\"");
+    const char *render = strstr(buffer, "\"render\"");
+    return source != NULL && render != NULL &&
+           sscanf(source, "\"source\" : \"%" SCNx64 "\"", &manifest.source) == 1 &&
+           sscanf(render, "\"render\" : \"%" SCNx64 "\"", &manifest.render) == 1;
+}
+
+int DirectoryTileStore::writeManifest(const TileManifest &manifest) {
+    VSIMkdir(_outputPath.c_str(), 0777);
+    VSILFILE *fp = VSIFOpenL(CPLSPrintf("%s/manifest.json", _outputPath.c_str()), "wb");
+    if (fp == NULL) {
+        printf("Write tile manifest error\n");
+        return 2;
+    }
+    const char *json = CPLSPrintf("{\n  \"version\" : 1,\n  \"source\" : \"%016" PRIx64 "\",\n  \"render\" : \"%016" PRIx64 "\"\n}\n", manifest.source, manifest.render);
+    size_t length = strlen(json);
+    size_t written = VSIFWriteL(json, 1, length, fp);
+    VSIFCloseL(fp);
+    return written == length ? 0 : 2;
+}
+
+int DirectoryTileStore::clear(void) {
+    lock_guard<mutex> lock(_mutex);
+    _blobs.clear();
+    _tileHashes.clear();
+    _directories.clear();
+    for (pair<const thread::id, TileBatch> &batch : _batches) {
+        /// A committing batch is being written outside the lock
+        if (!batch.second.committing) {
+            batch.second.tiles.clear();
+            batch.second.index.clear();
+        }
+    }
+    
+    /// Only the z/x/y.png tree and the manifest, outputPath may hold other files
+    char **zoomDirs = VSIReadDir(_outputPath.c_str());
+    for (int i = 0;zoomDirs != NULL && zoomDirs[i] != NULL;i++) {
+        char *end = NULL;
+        strtol(zoomDirs[i], &end, 10);
+        if (end == zoomDirs[i] || *end != '\0') {
+            continue;
+        }
+        CPLString zoomDir = CPLFormFilename(_outputPath.c_str(), zoomDirs[i], NULL);
+        char **xDirs = VSIReadDir(zoomDir);
+        for (int j = 0;xDirs != NULL && xDirs[j] != NULL;j++) {
+            strtol(xDirs[j], &end, 10);
+            if (end == xDirs[j] || *end != '\0') {
+                continue;
+            }
+            CPLString xDir = CPLFormFilename(zoomDir, xDirs[j], NULL);
+            char **files = VSIReadDir(xDir);
+            for (int k = 0;files != NULL && files[k] != NULL;k++) {
+                /// y.png and y.png.<pid>.<serial>.tmp
+                strtol(files[k], &end, 10);
+                if (end != files[k] && (EQUAL(end, ".png") || (STARTS_WITH_CI(end, ".png.") && EQUAL(CPLGetExtension(end), "tmp")))) {
+                    VSIUnlink(CPLFormFilename(xDir, files[k], NULL));
+                }
+            }
+            CSLDestroy(files);
+            /// Fails when something else is left in it
+            VSIRmdir(xDir);
+        }
+        CSLDestroy(xDirs);
+        VSIRmdir(zoomDir);
+    }
+    CSLDestroy(zoomDirs);
+    VSIUnlink(CPLSPrintf("%s/manifest.json", _outputPath.c_str()));
+    
+    VSIMkdir(_outputPath.c_str(), 0777);
+    VSIStatBufL sStat;
+    return VSIStatL(_outputPath.c_str(), &sStat) == 0 && VSI_ISDIR(sStat.st_mode) ? 0 : 2;
+}
+
+string DirectoryTileStore::tilePath(int tx, int ty, int tz) {
+    return CPLSPrintf("%s/%d/%d/%d.png", _outputPath.c_str(), tz, tx, ty);
+}
@@ -0,0 +1,198 @@
+//
+//  TileStore.hpp
+//  GDALKit
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#ifndef TileStore_hpp
+#define TileStore_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+
+#include "TileIndex.hpp"
+
+using namespace std;
+
+/// DirectoryTileStore::syncPolicy
+/// No fsync, a crash may lose recent tiles but never leaves a torn one
+#define TILE_SYNC_NONE 0
+/// Tiles of a batch are written to temporary files, fsynced together, then renamed, their directories fsynced once per batch
+#define TILE_SYNC_BATCH 1
+/// Every tile and its directory are fsynced before writeTile / commitBatch returns
+#define TILE_SYNC_TILE 2
+
+/// What the tiles of a store were rendered from
+struct TileManifest {
+    /// GDAL2Mercator::sourceFingerprint
+    uint64_t source;
+    /// GDAL2Mercator::renderFingerprint
+    uint64_t render;
+};
+
+/// Where encoded tiles are persisted. Writes come from a single writer thread
+/// (TilePipeline's write stage), reads may come from any thread.
+class TileStore {
+protected:
+    atomic<uint64_t> _duplicates;
+public:
+    TileStore(void) : _duplicates(0), deduplicate(true) {}
+    virtual ~TileStore(void) {}
+    
+    /// 相同内容(TileHash)的Tile只保存一次, 默认true
+    bool deduplicate;
+    
+    /// 因内容重复而跳过的写入次数
+    uint64_t duplicates(void) {
+        return _duplicates.load();
+    }
+    
+    /// 0 - 成功, 2 - 写入错误
+    virtual int writeTile(int tx, int ty, int tz, const vector<unsigned char> &data) = 0;
+    
+    virtual bool readTile(int tx, int ty, int tz, vector<unsigned char> &data) = 0;
+    
+    virtual bool containsTile(int tx, int ty, int tz) = 0;
+    
+    /// 一批Tile的写入, 在writeTile之前/之后调用
+    virtual int beginBatch(void) {
+        return 0;
+    }
+    
+    virtual int commitBatch(void) {
+        return 0;
+    }
+    
+    /// 所有已保存的Tile写入index
+    virtual uint64_t rebuildIndex(TileIndex *index) = 0;
+    
+    /// 没有manifest时返回false
+    virtual bool readManifest(TileManifest &manifest) = 0;
+    
+    virtual int writeManifest(const TileManifest &manifest) = 0;
+    
+    /// 删除所有Tile
+    virtual int clear(void) = 0;
+    
+    /// manifest与当前文件、渲染参数不一致时删除所有Tile并写入新的manifest
+    /// 返回true表示已清空
+    bool validate(const TileManifest &manifest);
+    
+    /// Tile的文件路径, 不是单个文件时为空
+    virtual string tilePath(int, int, int) {
+        return "";
+    }
+};
+
+/// A stored tile content, identified by its TileHash
+struct TileBlob {
+    uint64_t tile;
+    size_t length;
+};
+
+/// outputPath/z/x/y.png
+/// Duplicate tiles become hard links to the first file with the same content.
+/// A tile is written (or linked) to a temporary file next to it and renamed over y.png, so readers
+/// see the old tile or the new one, never a partial file. Created z and z/x directories are
+/// remembered, each is made once. Between beginBatch and commitBatch of a thread its tiles are
+/// kept in memory and written together when that thread commits.
+/// _mutex guards the bookkeeping only, files are written, fsynced and renamed outside it.
+class DirectoryTileStore : public TileStore {
+private:
+    string _outputPath;
+    
+    /// TileHash -> first tile written with that content, added once the tile is renamed into place
+    unordered_map<uint64_t, TileBlob> _blobs;
+    /// TileKey -> TileHash, to forget a blob whose tile is overwritten
+    unordered_map<uint64_t, uint64_t> _tileHashes;
+    /// z and z/x directories known to exist, tz << 32 | tx (tx -1 for z)
+    unordered_set<uint64_t> _directories;
+    /// A seeding pipeline may write next to the viewport pipeline
+    mutex _mutex;
+    /// Part of the temporary file names, writers never share one
+    atomic<uint64_t> _tempSerial;
+    
+    /// The open batch of one writer thread
+    struct TileBatch {
+        /// Nested beginBatch calls of the thread
+        int depth;
+        /// Being written by commitBatch, tiles no longer change
+        bool committing;
+        /// TileKey and data, in order
+        vector<pair<uint64_t, vector<unsigned char>>> tiles;
+        /// TileKey -> latest entry in tiles
+        unordered_map<uint64_t, size_t> index;
+    };
+    /// Viewport and seeding pipelines batch separately, a commit writes only the committing thread's tiles
+    unordered_map<thread::id, TileBatch> _batches;
+    
+    /// A temporary file of storeTiles, renamed over pngFile
+    struct TileFile {
+        string pngFile;
+        string tempFile;
+        uint64_t key;
+        uint64_t hash;
+        size_t length;
+        /// Hard link to a blob, already on disk
+        bool linked;
+    };
+    
+    /// Links tempFile to the blob with the same content, unless that blob is the tile itself
+    bool linkTile(uint64_t key, uint64_t hash, size_t length, const char *tempFile);
+    
+    /// Creates outputPath/tz/tx unless it is known to exist
+    int makeDirectory(int tx, int tz);
+    
+    /// Writes or links the temporary file of a tile, fsynced when TILE_SYNC_TILE
+    int writeTempFile(const vector<unsigned char> &data, TileFile &file);
+    
+    /// Directory and temporary file of a tile. 0 - 成功, 2 - 写入错误
+    int prepareTile(int tx, int ty, int tz, const vector<unsigned char> &data, TileFile &file);
+    
+    void syncDirectories(const unordered_set<string> &directories);
+    
+    /// Temporary files of all tiles, fsynced (TILE_SYNC_BATCH), renamed, then their directories fsynced once
+    /// 0 - 成功, 2 - 写入错误
+    int storeTiles(const vector<pair<uint64_t, vector<unsigned char>>> &tiles);
+public:
+    DirectoryTileStore(const char *outputPath);
+    ~DirectoryTileStore(void);
+    
+    /// TILE_SYNC_NONE / TILE_SYNC_BATCH / TILE_SYNC_TILE, default TILE_SYNC_NONE
+    int syncPolicy;
+    
+    const string &outputPath(void) {
+        return _outputPath;
+    }
+    
+    int writeTile(int tx, int ty, int tz, const vector<unsigned char> &data) override;
+    
+    bool readTile(int tx, int ty, int tz, vector<unsigned char> &data) override;
+    
+    bool containsTile(int tx, int ty, int tz) override;
+    
+    int beginBatch(void) override;
+    
+    /// Writes the tiles of the batch
+    int commitBatch(void) override;
+    
+    uint64_t rebuildIndex(TileIndex *index) override;
+    
+    /// outputPath/manifest.json
+    bool readManifest(TileManifest &manifest) override;
+    
+    int writeManifest(const TileManifest &manifest) override;
+    
+    /// Deletes z/x/y.png files and the manifest only, other files in outputPath are kept
+    int clear(void) override;
+    
+    string tilePath(int tx, int ty, int tz) override;
+};
+#endif /* TileStore_hpp */
@@ -0,0 +1,269 @@
+//
+//  RemoteCacheTests.mm
+//  GDALKitTests
+//
+//  Created by alimysoyang on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#include "GDAL2Mercator.hpp"
+#include "RemoteCache.hpp"
+
+#include "cpl_vsi.h"
+#include "ogr_srs_api.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Serves one file with HEAD and GET + Range (single and multipart) on 127.0.0.1, one request per connection
+class RangeServer {
+private:
+    int _fd;
+    std::thread _thread;
+    std::vector<unsigned char> _data;
+
+    void serve(int client) {
+        std::string request;
+        char buffer[4096];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                return;
+            }
+            request.append(buffer, size_t(n));
+        }
+        bool head = request.compare(0, 5, "HEAD ") == 0;
+        std::vector<std::pair<size_t, size_t>> ranges;
+        size_t pos = request.find("\r\nRange: bytes=");
+        if (pos == std::string::npos) {
+            pos = request.find("\r\nrange: bytes=");
+        }
+        if (pos != std::string::npos) {
+            const char *p = request.c_str() + pos + 15;
+            while (*p >= '0' && *p <= '9') {
+                char *end = NULL;
+                size_t first = strtoull(p, &end, 10);
+                size_t last = strtoull(end + 1, &end, 10);
+                ranges.push_back(std::make_pair(first, std::min(last, _data.size() - 1)));
+                p = *end == ',' ? end + 1 : end;
+                while (*p == ' ') {
+                    p++;
+                }
+            }
+        }
+        if (!head) {
+            requests++;
+            if (!ranges.empty()) {
+                rangeRequests++;
+            }
+        }
+
+        std::string header;
+        std::string body;
+        if (ranges.empty()) {
+            header = "HTTP/1.1 200 OK\r\nContent-Type: image/tiff\r\n";
+            if (!head) {
+                body.assign((const char *)_data.data(), _data.size());
+            }
+            header += "Content-Length: " + std::to_string(_data.size()) + "\r\n";
+        } else if (ranges.size() == 1) {
+            header = "HTTP/1.1 206 Partial Content\r\nContent-Type: image/tiff\r\n";
+            header += "Content-Range: bytes " + std::to_string(ranges[0].first) + "-" + std::to_string(ranges[0].second) + "/" + std::to_string(_data.size()) + "\r\n";
+            body.assign((const char *)_data.data() + ranges[0].first, ranges[0].second - ranges[0].first + 1);
+            header += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        } else {
+            header = "HTTP/1.1 206 Partial Content\r\nContent-Type: multipart/byteranges; boundary=GDALKIT\r\n";
+            for (const std::pair<size_t, size_t> &range : ranges) {
+                body += "\r\n--GDALKIT\r\nContent-Type: image/tiff\r\n";
+                body += "Content-Range: bytes " + std::to_string(range.first) + "-" + std::to_string(range.second) + "/" + std::to_string(_data.size()) + "\r\n\r\n";
+                body.append((const char *)_data.data() + range.first, range.second - range.first + 1);
+            }
+            body += "\r\n--GDALKIT--\r\n";
+            header += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        }
+        header += "Accept-Ranges: bytes\r\nLast-Modified: Mon, 19 Oct 2026 00:00:00 GMT\r\nConnection: close\r\n\r\n";
+        std::string response = header + body;
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = send(client, response.data() + sent, response.size() - sent, 0);
+            if (n <= 0) {
+                break;
+            }
+            sent += size_t(n);
+        }
+    }
+public:
+    int port;
+    /// GETs / GETs with a Range header
+    std::atomic<int> requests;
+    std::atomic<int> rangeRequests;
+
+    RangeServer(const std::vector<unsigned char> &data) : _data(data), requests(0), rangeRequests(0) {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(_fd, (struct sockaddr *)&addr, sizeof(addr));
+        socklen_t length = sizeof(addr);
+        getsockname(_fd, (struct sockaddr *)&addr, &length);
+        port = ntohs(addr.sin_port);
+        listen(_fd, 16);
+        _thread = std::thread([this]() {
+            while (true) {
+                int client = accept(_fd, NULL, NULL);
+                if (client < 0) {
+                    break;
+                }
+                serve(client);
+                close(client);
+            }
+        });
+    }
+
+    ~RangeServer(void) {
+        shutdown(_fd, SHUT_RDWR);
+        close(_fd);
+        _thread.join();
+    }
+};
+
+@interface RemoteCacheTests : XCTestCase {
+    RangeServer *server;
+    GDAL2Mercator *mercator;
+}
+@property (strong, nonatomic) NSString *directory;
+@property (strong, nonatomic) NSString *localFile;
+@property (strong, nonatomic) NSString *url;
+@property (strong, nonatomic) NSString *cacheFile;
+@end
+
+@implementation RemoteCacheTests
+
+- (void)setUp {
+    NSBundle *bundle = [NSBundle bundleWithPath:[[NSBundle bundleForClass:self.class] pathForResource:@"SRGDAL" ofType:@"bundle"]];
+    self->mercator = new GDAL2Mercator([bundle pathForResource:@"gdal" ofType:nil].UTF8String, [bundle pathForResource:@"proj" ofType:nil].UTF8String);
+    self->mercator->mappedReads = false;
+
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+    [NSFileManager.defaultManager createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+    self.localFile = [self.directory stringByAppendingPathComponent:@"remote.tif"];
+    self.cacheFile = [self.directory stringByAppendingPathComponent:@"remote.cache"];
+
+    /// 2048 x 2048 Byte, 256 x 256 uncompressed blocks: the blocks of a window lie next to each other
+    GDALDatasetH hMemDS = GDALCreate(GDALGetDriverByName("MEM"), "", 2048, 2048, 1, GDT_Byte, NULL);
+    std::vector<unsigned char> pixels(2048 * 2048);
+    for (size_t i = 0;i < pixels.size();i++) {
+        pixels[i] = (unsigned char)((i % 2048) * 7 + (i / 2048) * 13);
+    }
+    GDALRasterIO(GDALGetRasterBand(hMemDS, 1), GF_Write, 0, 0, 2048, 2048, pixels.data(), 2048, 2048, GDT_Byte, 0, 0);
+    double geoTransform[6] = {0.0, 10.0, 0.0, 2048 * 10.0, 0.0, -10.0};
+    GDALSetGeoTransform(hMemDS, geoTransform);
+    OGRSpatialReferenceH hSRS = OSRNewSpatialReference(NULL);
+    OSRImportFromEPSG(hSRS, 3857);
+    GDALSetSpatialRef(hMemDS, hSRS);
+    OSRDestroySpatialReference(hSRS);
+    const char *options[] = {"COMPRESS=NONE", "BLOCKSIZE=256", NULL};
+    GDALDatasetH hCOGDS = GDALCreateCopy(GDALGetDriverByName("COG"), self.localFile.UTF8String, hMemDS, FALSE, (char **)options, NULL, NULL);
+    XCTAssert(hCOGDS != NULL);
+    GDALClose(hCOGDS);
+    GDALClose(hMemDS);
+
+    NSData *data = [NSData dataWithContentsOfFile:self.localFile];
+    std::vector<unsigned char> bytes((const unsigned char *)data.bytes, (const unsigned char *)data.bytes + data.length);
+    self->server = new RangeServer(bytes);
+    self.url = [NSString stringWithFormat:@"http://127.0.0.1:%d/remote.tif", self->server->port];
+
+    XCTAssertEqual(RemoteCache::install(self.cacheFile.UTF8String, 64 * 1024 * 1024), 0);
+    VSICurlClearCache();
+}
+
+- (void)tearDown {
+    VSICurlClearCache();
+    delete self->mercator;
+    delete self->server;
+    [NSFileManager.defaultManager removeItemAtPath:self.directory error:nil];
+}
+
+- (std::vector<unsigned char>)readWindow:(const char *)file x:(int)x y:(int)y size:(int)size {
+    std::vector<unsigned char> pixels(size_t(size) * size);
+    GDALDatasetH hSrcDS = GDALOpen(file, GA_ReadOnly);
+    XCTAssert(hSrcDS != NULL);
+    if (hSrcDS != NULL) {
+        CPLErr eErr = GDALRasterIO(GDALGetRasterBand(hSrcDS, 1), GF_Read, x, y, size, size, pixels.data(), size, size, GDT_Byte, 0, 0);
+        XCTAssertEqual(eErr, CE_None);
+        GDALClose(hSrcDS);
+    }
+    return pixels;
+}
+
+- (void)testRemoteReadMatchesLocal {
+    std::string remote = RemoteCachePath(self.url.UTF8String);
+    XCTAssertEqual(remote.find(REMOTE_CACHE_PREFIX), size_t(0));
+    std::vector<unsigned char> expected = [self readWindow:self.localFile.UTF8String x:300 y:500 size:700];
+    std::vector<unsigned char> actual = [self readWindow:remote.c_str() x:300 y:500 size:700];
+    XCTAssert(expected == actual);
+}
+
+- (void)testRemoteTileMatchesLocal {
+    self->mercator->openCOGFileWithTile(self.localFile.UTF8String);
+    int tz = self->mercator->maxZoom();
+    int range[4];
+    XCTAssert(self->mercator->tileRange(tz, range));
+    TileResult expected = self->mercator->renderTile(range[0], range[1], tz, NULL);
+
+    self->mercator->openCOGFileWithTile(self.url.UTF8String);
+    XCTAssertEqual(self->mercator->maxZoom(), tz);
+    TileResult actual = self->mercator->renderTile(range[0], range[1], tz, NULL);
+    XCTAssertEqual(expected.status, 0);
+    XCTAssertEqual(actual.status, 0);
+    XCTAssert(expected.bytes == actual.bytes);
+}
+
+- (void)testWindowBlocksAreMerged {
+    std::string remote = RemoteCachePath(self.url.UTF8String);
+    GDALDatasetH hSrcDS = GDALOpen(remote.c_str(), GA_ReadOnly);
+    XCTAssert(hSrcDS != NULL);
+    int before = self->server->rangeRequests;
+    /// 4 x 4 blocks
+    std::vector<unsigned char> pixels(1024 * 1024);
+    GDALRasterIO(GDALGetRasterBand(hSrcDS, 1), GF_Read, 0, 1024, 1024, 1024, pixels.data(), 1024, 1024, GDT_Byte, 0, 0);
+    GDALClose(hSrcDS);
+    int requests = self->server->rangeRequests - before;
+    XCTAssertGreaterThan(requests, 0);
+    XCTAssertLessThan(requests, 16);
+}
+
+- (void)testCacheSurvivesRestart {
+    std::string remote = RemoteCachePath(self.url.UTF8String);
+    std::vector<unsigned char> expected = [self readWindow:remote.c_str() x:0 y:0 size:2048];
+    XCTAssertGreaterThan(RemoteCache::shared()->bytes(), 0);
+
+    /// A new process: another cache instance on the same file, nothing in the /vsicurl memory cache
+    XCTAssertEqual(RemoteCache::install(self.cacheFile.UTF8String, 64 * 1024 * 1024), 0);
+    VSICurlClearCache();
+    int before = self->server->rangeRequests;
+    std::vector<unsigned char> actual = [self readWindow:remote.c_str() x:0 y:0 size:2048];
+    XCTAssertEqual(self->server->rangeRequests - before, 0);
+    XCTAssert(expected == actual);
+}
+
+- (void)testEviction {
+    XCTAssertEqual(RemoteCache::install(self.cacheFile.UTF8String, 512 * 1024), 0);
+    std::string remote = RemoteCachePath(self.url.UTF8String);
+    [self readWindow:remote.c_str() x:0 y:0 size:2048];
+    XCTAssertLessThanOrEqual(RemoteCache::shared()->bytes(), 512 * 1024);
+    XCTAssertEqual(RemoteCache::shared()->clear(), 0);
+    XCTAssertEqual(RemoteCache::shared()->bytes(), 0);
+}
+
+@end
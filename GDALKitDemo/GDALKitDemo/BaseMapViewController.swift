@@ -26,6 +26,7 @@ class BaseMapViewController: UIViewController {
     private lazy var gdalManager: GDALKitManager = { [unowned self] in
         let manager: GDALKitManager = GDALKitManager()
         manager.delegate = self
+        manager.prefetchEnabled = true
         return manager
     }()
     
@@ -54,7 +55,6 @@ class BaseMapViewController: UIViewController {
         super.init(nibName: nil, bundle: nil)
         let filePath = "\(NSSearchPathForDirectoriesInDomains(.documentDirectory, .userDomainMask, true)[0])/cog_3857.tif"
         if FileManager.default.fileExists(atPath: filePath) {
-            "\(NSSearchPathForDirectoriesInDomains(.documentDirectory, .userDomainMask, true)[0])/cog_3857".removeFiles()
             gdalManager.cogFile = "\(NSSearchPathForDirectoriesInDomains(.documentDirectory, .userDomainMask, true)[0])/cog_3857.tif"
         }
     }
@@ -78,7 +78,7 @@ class BaseMapViewController: UIViewController {
             guard let self = self else { return }
             if self.gdalManager.cogFile.isEmpty { return }
             let bounds = self.mapView.mapboxMap.coordinateBounds(for: self.view.bounds)
-            self.gdalManager.geoTiles(bounds.southwest, northeast: bounds.northeast, zoomLevel: Int32(round(self.mapView.mapboxMap.cameraState.zoom)))
+            self.gdalManager.updateCamera(bounds.southwest, northeast: bounds.northeast, zoom: self.mapView.mapboxMap.cameraState.zoom)
         }.store(in: &cancelables)
     }
     